@@ -0,0 +1,87 @@
+// Compares one inbox scan pass of the old watcher (directory_iterator +
+// is_regular_file + std::regex_match) with InboxScanner + parseFrameName.
+//
+//   InboxScan_benchmark [files=100000] [passes=5]
+#include "../include/InboxScanner.hpp"
+#include "../include/Utils.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <string>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static size_t regexPass(const fs::path &dir) {
+  static const std::regex re(
+      R"((\d+)_([A-Za-z0-9_]+)_(\d)_(\d+)_([A-Za-z0-9-]+)\.ospeed)");
+  size_t frames = 0;
+  for (auto &entry : fs::directory_iterator(dir)) {
+    if (!entry.is_regular_file())
+      continue;
+    std::smatch m;
+    const std::string filename = entry.path().filename().string();
+    if (std::regex_match(filename, m, re)) {
+      (void)std::stoul(m[3].str());
+      (void)std::stoll(m[4].str());
+      ++frames;
+    }
+  }
+  return frames;
+}
+
+static size_t scannerPass(SPEED::InboxScanner &scanner) {
+  size_t frames = 0;
+  scanner.scan([&](std::string_view name) {
+    if (SPEED::parseFrameName(name).has_value())
+      ++frames;
+  });
+  return frames;
+}
+
+template <typename Fn> static double bestMillis(int passes, Fn &&fn) {
+  double best = 1e300;
+  for (int i = 0; i < passes; ++i) {
+    const auto start = Clock::now();
+    fn();
+    const std::chrono::duration<double, std::milli> took =
+        Clock::now() - start;
+    best = std::min(best, took.count());
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  const size_t files = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+  const int passes = argc > 2 ? std::atoi(argv[2]) : 5;
+
+  const fs::path dir = fs::temp_directory_path() / "speed_inbox_scan_bench";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  const std::string ts = SPEED::Utils::getCurrentTimestamp();
+  for (size_t i = 0; i < files; ++i) {
+    std::ofstream(dir / (ts + "_Bench_Sender_2_" + std::to_string(i) + "_" +
+                         SPEED::Utils::generateUUID() + ".ospeed"));
+  }
+
+  size_t regex_frames = 0, scanner_frames = 0;
+  const double regex_ms =
+      bestMillis(passes, [&] { regex_frames = regexPass(dir); });
+  SPEED::InboxScanner scanner(dir);
+  const double scanner_ms =
+      bestMillis(passes, [&] { scanner_frames = scannerPass(scanner); });
+
+  std::cout << "[INFO] " << files << " files, best of " << passes
+            << " passes\n";
+  std::cout << "[INFO] regex:   " << regex_ms << " ms (" << regex_frames
+            << " frames)\n";
+  std::cout << "[INFO] scanner: " << scanner_ms << " ms (" << scanner_frames
+            << " frames)\n";
+  std::cout << "[INFO] speedup: " << regex_ms / scanner_ms << "x\n";
+
+  fs::remove_all(dir);
+  return regex_frames == scanner_frames ? 0 : 1;
+}
@@ -1,20 +1,76 @@
 #pragma once
+#include "ProcessTable.hpp"
 #include "Utils.hpp"
+#include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 namespace SPEED {
+// One immutable version of the three lists. Readers hold on to it for as
+// long as they need a consistent view; writers publish a new one.
+struct AclSnapshot {
+  std::unordered_set<std::string> global_registry;
+  std::unordered_set<std::string> access_list;
+  std::unordered_set<std::string> connected_list;
+  uint64_t generation = 0;
+};
+
+// The global registry mirrors the *.oregistry files of access_registry. After
+// the initial listing it is kept current from inotify events (or, where
+// inotify is unavailable, by relisting only when the directory mtime moves),
+// so lookups never touch the filesystem. With useProcessTable() membership
+// is read from the shared ProcessTable instead and no directory is watched.
+//
+// Writers serialise on a mutex, edit private working copies and then
+// publish them as a new AclSnapshot, followed by its generation. Each
+// thread keeps the last snapshot it loaded and checks it against that
+// generation, a single atomic load. Only when the generation has moved
+// does it reload the snapshot pointer. That reload is an
+// atomic<shared_ptr>, which libstdc++ does not implement lock-free, so it
+// can briefly wait on a writer's store. Checks between two publishes
+// neither wait nor touch a shared refcount.
 class AccessRegistry {
 public:
+  // How long a failed resolve() is remembered before the registry is
+  // consulted again for that name.
+  static constexpr std::chrono::milliseconds kNegativeTtl{500};
+  // A peer whose pid cannot be probed from here (none recorded, or one from
+  // another pid space) is dead once its heartbeat is older than this.
+  static constexpr std::chrono::seconds kPeerTimeout{10};
+  static constexpr std::chrono::seconds kLivenessInterval{1};
+
   AccessRegistry(const std::filesystem::path &, const std::string &);
+  ~AccessRegistry();
+  AccessRegistry(const AccessRegistry &) = delete;
+  AccessRegistry &operator=(const AccessRegistry &) = delete;
 
   void addProcessToList(const std::string &proc_name);
+  // Relists access_registry and applies the difference.
   void incrementalBuildGlobalRegistry();
+  // Applies pending add/remove events. Cheap enough to call every pass.
+  void refresh();
+  // Switches membership to the shared table at `table_path`, publishing
+  // this process in it. Every process of the session must do the same to
+  // see one another. Returns false, keeping the directory watch, if the
+  // table cannot be used.
+  bool useProcessTable(const std::filesystem::path &table_path,
+                       uint64_t capabilities);
+  // Drops peers whose process has died from the registry. Peers found dead
+  // by their pid are unpublished for everyone else as well; a peer only
+  // judged by its heartbeat keeps its registration, since another pid space
+  // may still see it alive. Checks at most once per kLivenessInterval.
+  // Returns the evicted names.
+  std::vector<std::string> evictDeadPeers();
   void removeAccessFile();
+  // Drops access for every process no longer in the global registry.
   void syncAccessRegistry();
 
   bool removeProcessFromGlobalRegistry(const std::string &proc_name);
@@ -23,25 +79,67 @@ public:
   bool removeProcessFromConnectedList(const std::string &proc_name);
   bool connect_to(const std::string &);
   bool checkGlobalRegistry(const std::string &proc_name) const;
+  // checkGlobalRegistry() that, on a miss, catches up on registry changes
+  // first. Misses are cached for kNegativeTtl, so sending to an absent peer
+  // does not refresh on every call.
+  bool resolve(const std::string &proc_name);
   bool check_connection(const std::string &proc_name) const;
 
+  // Bumped on every change to any of the three lists, so callers can cache
+  // a lookup result until the registry moves.
+  uint64_t getGeneration() const;
   const std::filesystem::path &getAccessRegistryPath() const;
-  const std::unordered_set<std::string> getGlobalRegistry() const;
-  const std::unordered_set<std::string> getAccessList() const;
-  const std::unordered_set<std::string> getConnectedList() const;
+  // The current version of all three lists and its generation.
+  std::shared_ptr<const AclSnapshot> snapshot() const;
+  // Views into the current snapshot; they stay valid while held.
+  using ListView = std::shared_ptr<const std::unordered_set<std::string>>;
+  ListView getGlobalRegistry() const;
+  ListView getAccessList() const;
+  ListView getConnectedList() const;
 
 private:
   void putAccessFile();
   void printRegistry() const;
   void try_connect_all();
+  void rescan_();
+  void beat_();
+  bool isAlive_(const std::string &proc_name, bool &probed);
+  void applyListing_(const std::unordered_set<std::string> &current);
+  void watch_();
+  void unwatch_();
+  bool drainEvents_();
+  void addToGlobalRegistry_(const std::string &proc_name);
+  void eraseFromGlobalRegistry_(const std::string &proc_name);
+  bool connect_(const std::string &proc_name);
+  void publish_();
+  const std::shared_ptr<const AclSnapshot> &current_() const;
+
+  // working copies, only touched under mtx_
   std::unordered_set<std::string> allowedProcesses_;
   std::unordered_set<std::string> global_registry_;
   std::unordered_set<std::string> connected_list_;
+  uint64_t generation_ = 1;
+  std::atomic<std::shared_ptr<const AclSnapshot>> snapshot_;
+  std::atomic<uint64_t> published_{0}; // snapshot_'s generation
+  const uint64_t id_;                  // tells registries apart in caches
   std::filesystem::path ac_path_;
   std::string access_filename_;
   std::string proc_name_;
 
-  mutable std::mutex mtx_; // protects shared state
+  int inotify_fd_ = -1;
+  std::vector<char> event_buf_;
+  // mtime fallback: relist when it moves, or while it is too recent to
+  // trust (an entry added in the same tick would not move it)
+  std::filesystem::file_time_type listed_mtime_{};
+  bool listed_settled_ = false;
+  std::unordered_map<std::string, std::chrono::steady_clock::time_point>
+      misses_;
+  std::chrono::steady_clock::time_point last_beat_{};
+  std::chrono::steady_clock::time_point last_liveness_{};
+  std::unique_ptr<ProcessTable> table_;
+  uint64_t table_generation_ = 0;
+
+  mutable std::mutex mtx_; // serialises writers
 };
 
 } // namespace SPEED
@@ -1,5 +1,6 @@
 #pragma once
 #include "BinaryMessage.hpp"
+#include "MessagePool.hpp"
 #include "Utils.hpp"
 #include <array>
 #include <atomic>
@@ -8,13 +9,49 @@
 #include <fstream>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 namespace SPEED {
 
 class BinaryManager {
 public:
   static bool writeBinary(const Message &, const std::filesystem::path &,
                           std::atomic<long long> &, const std::string &);
+  // Given `rename_ns`, stores when the finished file began to be renamed
+  // into place, in ns since the unix epoch.
+  static bool writeBinary(const Message &, const std::filesystem::path &,
+                          const std::string &, long long, const std::string &,
+                          uint64_t *rename_ns = nullptr);
+  // Serializes the frame once and publishes it into every (reciever, seq)
+  // inbox via hardlinks, copying only when linking is not possible. Returns
+  // the number of inboxes the frame was published to; given `published`,
+  // also marks which targets it reached, in order.
+  static size_t
+  writeShared(const Message &, const std::filesystem::path &,
+              const std::string &,
+              const std::vector<std::pair<std::string, long long>> &,
+              std::vector<bool> *published = nullptr);
+  // Writes the frame to `tmp` and renames it to `final`, so readers never see
+  // a partially written file under the final name.
+  static bool writeAtomic(const Message &, const std::filesystem::path &,
+                          const std::filesystem::path &);
+  // <path>/<reciever>/<sender>: the inbox shard `sender` writes frames into.
+  static std::filesystem::path shardPath(const std::filesystem::path &,
+                                         const std::string &,
+                                         const std::string &);
   static Message readBinary(const std::filesystem::path &);
+  static MessagePool::Lease readBinary(const std::filesystem::path &,
+                                       MessagePool &);
+
+private:
+  static bool writeFrame_(const Message &, const std::filesystem::path &);
+#if defined(__unix__) || defined(__APPLE__)
+  static bool writeFrameFd_(const Message &, const char *);
+#endif
+  static void appendFilename_(std::string &, std::string_view,
+                              std::string_view, Priority, long long,
+                              std::string_view, const char *);
 };
 
 template <typename T> std::vector<unsigned char> to_big_endian(T value) {
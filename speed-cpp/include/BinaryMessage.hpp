@@ -1,40 +1,142 @@
 #pragma once
 #include "Constants.hpp"
 #include "Utils.hpp"
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
 #include <vector>
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
 namespace SPEED {
-enum class MessageType {
+enum class MessageType : uint8_t {
   MSG,
   CON_REQ,
   CON_RES,
   INVOKE_METHOD,
   EXIT_NOTIF,
   PING,
-  PONG
+  PONG,
+  INVOKE_RESULT,
+  PUBLISH,
+  JOB,
+  ACK,
+  CREDIT
 };
+// Delivery lanes, highest first. Every lane of a sender->reciever channel has
+// its own sequence space and the watcher drains higher lanes first, so a
+// backlog of bulk data never holds up control traffic.
+enum class Priority : uint8_t { Control, High, Normal, Low };
+constexpr size_t kPriorityLanes = 4;
+
+// Host <-> big-endian for one fixed-width integer; its own inverse. Compiles
+// to a single bswap on little-endian hosts.
+inline uint16_t byteswap(uint16_t v) {
+#if defined(_MSC_VER)
+  return _byteswap_ushort(v);
+#else
+  return __builtin_bswap16(v);
+#endif
+}
+inline uint32_t byteswap(uint32_t v) {
+#if defined(_MSC_VER)
+  return _byteswap_ulong(v);
+#else
+  return __builtin_bswap32(v);
+#endif
+}
+inline uint64_t byteswap(uint64_t v) {
+#if defined(_MSC_VER)
+  return _byteswap_uint64(v);
+#else
+  return __builtin_bswap64(v);
+#endif
+}
+template <typename T> inline T swap_big_endian(T value) {
+  static_assert(std::is_unsigned_v<T>, "swap_big_endian needs unsigned");
+  if constexpr (sizeof(T) == 1 || std::endian::native == std::endian::big)
+    return value;
+  else
+    return byteswap(value);
+}
+
+// Longest process name that fits in a frame header.
+constexpr size_t kMaxNameLength = 63;
+
+// Bounded process name stored inline in the header. Bytes past size() are
+// always zero, so equal names are also bytewise equal on disk.
+struct PeerName {
+  uint8_t len = 0;
+  char data[kMaxNameLength] = {};
+
+  PeerName() = default;
+  PeerName(std::string_view name) { assign(name); }
+  PeerName &operator=(std::string_view name) {
+    assign(name);
+    return *this;
+  }
+  void assign(std::string_view name) {
+    if (name.size() > kMaxNameLength)
+      throw std::length_error("Process name too long for frame header");
+    std::memcpy(data, name.data(), name.size());
+    std::memset(data + name.size(), 0, kMaxNameLength - name.size());
+    len = static_cast<uint8_t>(name.size());
+  }
+  bool empty() const { return len == 0; }
+  size_t size() const { return len; }
+  std::string_view view() const { return {data, len}; }
+  operator std::string_view() const { return view(); }
+  operator std::string() const { return std::string(view()); }
+  friend bool operator==(const PeerName &a, std::string_view b) {
+    return a.view() == b;
+  }
+  friend std::ostream &operator<<(std::ostream &os, const PeerName &name) {
+    return os << name.view();
+  }
+};
+
+// Fixed-layout frame header. It is trivially copyable and has no padding, so
+// it goes to disk as one block (see Message::encode_header). All of it is
+// sent in the clear and authenticated as associated data of the payload.
 struct MessageHeader {
-  uint8_t version;
-  MessageType type;
-  uint32_t sender_pid;
-  uint64_t timestamp;
-  uint64_t seq_num;
-  std::string sender;
-  std::string reciever;
-  std::array<uint8_t, 24> nonce; // 24 bytes for XChaCha20-Poly1305
+  uint8_t version = 0;
+  MessageType type = MessageType::MSG;
+  uint8_t flags = 0; // FLAG_* bits
+  Priority priority = Priority::Normal;
+  uint32_t sender_pid = 0;
+  uint64_t timestamp = 0;  // ns since the unix epoch
+  uint64_t expires_at = 0; // unix epoch ms, 0 = never
+  uint64_t seq_num = 0;
+  std::array<uint8_t, 24> nonce{}; // 24 bytes for XChaCha20-Poly1305
+  PeerName sender;
+  PeerName reciever;
 };
+static_assert(std::is_trivially_copyable_v<MessageHeader>,
+              "MessageHeader is serialized with memcpy");
+static_assert(offsetof(MessageHeader, sender) == 56 &&
+                  sizeof(MessageHeader) == 56 + 2 * sizeof(PeerName),
+              "MessageHeader must not contain padding");
+constexpr size_t kHeaderWireSize = sizeof(MessageHeader);
+
 struct PMessage {
 public:
   std::string sender_name;
   std::string message;
   uint64_t timestamp;
+  std::string topic; // topic or work queue it arrived through, else empty
   PMessage(const std::string &sender_name, const std::string &message,
-           const uint64_t &timestamp) {
+           const uint64_t &timestamp, const std::string &topic = "") {
     this->sender_name = sender_name;
     this->message = message;
     this->timestamp = timestamp;
+    this->topic = topic;
   }
 };
 
@@ -43,42 +145,52 @@ struct Message {
   std::vector<uint8_t> payload;
   static Message construct_MSG(const std::string &msg) {
     Message message;
+    construct_MSG(message, msg);
+    return message;
+  }
+  // Refills `message` in place, reusing its payload capacity.
+  static void construct_MSG(Message &message, std::string_view msg) {
+    message.header = MessageHeader{};
     message.header.version = SPEED_VERSION;
     message.header.type = MessageType::MSG;
     message.header.sender_pid = Utils::getProcessID();
-    message.header.timestamp = std::stoull(Utils::getCurrentTimestamp());
+    message.header.timestamp = Utils::getEpochNanos();
     message.header.seq_num = -1;
-    message.header.sender = "";
-    message.header.reciever = "";
-    message.payload = std::vector<uint8_t>(msg.begin(), msg.end());
-    return message;
+    message.payload.assign(msg.begin(), msg.end());
   }
-  static Message construct_CON_REQ(const std::string &reciever_name) {
+  // the sender's public key, then its restart epoch (see SeqState)
+  static Message construct_CON_REQ(const std::string &reciever_name,
+                                   std::vector<uint8_t> public_key,
+                                   uint64_t epoch) {
     Message message;
     message.header.version = SPEED_VERSION;
     message.header.type = MessageType::CON_REQ;
     message.header.sender_pid = Utils::getProcessID();
-    message.header.timestamp = std::stoull(Utils::getCurrentTimestamp());
+    message.header.timestamp = Utils::getEpochNanos();
     message.header.seq_num = -1;
     message.header.sender = "";
     message.header.reciever = reciever_name;
+    message.header.priority = Priority::Control;
 
-    const std::string m = "CON_REQ_";
-    message.payload = std::vector<uint8_t>(m.begin(), m.end());
+    message.payload = std::move(public_key);
+    put_u64(message.payload, epoch);
     return message;
   }
-  static Message construct_CON_RES(const std::string &reciever_name) {
+  static Message construct_CON_RES(const std::string &reciever_name,
+                                   std::vector<uint8_t> public_key,
+                                   uint64_t epoch) {
     Message message;
     message.header.version = SPEED_VERSION;
     message.header.type = MessageType::CON_RES;
     message.header.sender_pid = Utils::getProcessID();
-    message.header.timestamp = std::stoull(Utils::getCurrentTimestamp());
+    message.header.timestamp = Utils::getEpochNanos();
     message.header.seq_num = -1;
     message.header.sender = "";
     message.header.reciever = reciever_name;
+    message.header.priority = Priority::Control;
 
-    const std::string m = "CON_RES_";
-    message.payload = std::vector<uint8_t>(m.begin(), m.end());
+    message.payload = std::move(public_key);
+    put_u64(message.payload, epoch);
     return message;
   }
   static Message construct_INVOKE_METHOD(const std::string &method_name,
@@ -87,7 +199,7 @@ struct Message {
     message.header.version = SPEED_VERSION;
     message.header.type = MessageType::INVOKE_METHOD;
     message.header.sender_pid = Utils::getProcessID();
-    message.header.timestamp = std::stoull(Utils::getCurrentTimestamp());
+    message.header.timestamp = Utils::getEpochNanos();
     message.header.seq_num = -1;
     message.header.sender = "";
     message.header.reciever = reciever_name;
@@ -101,10 +213,11 @@ struct Message {
     message.header.version = SPEED_VERSION;
     message.header.type = MessageType::EXIT_NOTIF;
     message.header.sender_pid = Utils::getProcessID();
-    message.header.timestamp = std::stoull(Utils::getCurrentTimestamp());
+    message.header.timestamp = Utils::getEpochNanos();
     message.header.seq_num = -1;
     message.header.sender = "";
     message.header.reciever = reciever_name;
+    message.header.priority = Priority::Control;
 
     const std::string m = "EXIT_NOTIF_";
     message.payload = std::vector<uint8_t>(m.begin(), m.end());
@@ -115,11 +228,12 @@ struct Message {
     Message message;
     message.header.version = SPEED_VERSION;
     message.header.type = MessageType::PING;
-    message.header.sender = Utils::getProcessID();
-    message.header.timestamp = std::stoull(Utils::getCurrentTimestamp());
+    message.header.sender_pid = Utils::getProcessID();
+    message.header.timestamp = Utils::getEpochNanos();
     message.header.seq_num = -1;
     message.header.sender = "";
     message.header.reciever = rec_name;
+    message.header.priority = Priority::Control;
 
     const std::string m = "PING";
     message.payload = std::vector<uint8_t>(m.begin(), m.end());
@@ -131,21 +245,150 @@ struct Message {
     message.header.version = SPEED_VERSION;
     message.header.type = MessageType::PONG;
     message.header.sender_pid = Utils::getProcessID();
-    message.header.timestamp = std::stoull(Utils::getCurrentTimestamp());
+    message.header.timestamp = Utils::getEpochNanos();
     message.header.seq_num = -1;
     message.header.sender = "";
     message.header.reciever = reciever_name;
+    message.header.priority = Priority::Control;
 
     const std::string m = "PONG";
     message.payload = std::vector<uint8_t>(m.begin(), m.end());
     return message;
   }
+  static Message construct_INVOKE_RESULT(const std::string &reciever_name) {
+    Message message;
+    message.header.version = SPEED_VERSION;
+    message.header.type = MessageType::INVOKE_RESULT;
+    message.header.sender_pid = Utils::getProcessID();
+    message.header.timestamp = Utils::getEpochNanos();
+    message.header.seq_num = -1;
+    message.header.sender = "";
+    message.header.reciever = reciever_name;
+    return message;
+  }
+  // payload is "<topic>\0<body>"; topic names never contain NUL
+  static Message construct_PUBLISH(const std::string &topic,
+                                   const std::string &msg) {
+    Message message;
+    message.header.version = SPEED_VERSION;
+    message.header.type = MessageType::PUBLISH;
+    message.header.sender_pid = Utils::getProcessID();
+    message.header.timestamp = Utils::getEpochNanos();
+    message.header.seq_num = -1;
+    message.header.sender = "";
+    message.header.reciever = "";
+
+    message.payload.reserve(topic.size() + 1 + msg.size());
+    message.payload.insert(message.payload.end(), topic.begin(), topic.end());
+    message.payload.push_back('\0');
+    message.payload.insert(message.payload.end(), msg.begin(), msg.end());
+    return message;
+  }
+  static Message construct_JOB(const std::string &msg) {
+    Message message;
+    message.header.version = SPEED_VERSION;
+    message.header.type = MessageType::JOB;
+    message.header.sender_pid = Utils::getProcessID();
+    message.header.timestamp = Utils::getEpochNanos();
+    message.header.seq_num = -1;
+    message.header.sender = "";
+    message.header.reciever = "";
+    message.payload = std::vector<uint8_t>(msg.begin(), msg.end());
+    return message;
+  }
+  // cumulative, one entry per lane: every frame below `next_expected[lane]`
+  // has been consumed
+  static Message
+  construct_ACK(const std::string &reciever_name,
+                const std::array<long long, kPriorityLanes> &next_expected) {
+    Message message;
+    message.header.version = SPEED_VERSION;
+    message.header.type = MessageType::ACK;
+    message.header.sender_pid = Utils::getProcessID();
+    message.header.timestamp = Utils::getEpochNanos();
+    message.header.seq_num = -1;
+    message.header.sender = "";
+    message.header.reciever = reciever_name;
+    message.header.priority = Priority::Control;
+    for (long long seq : next_expected) {
+      put_u64(message.payload, static_cast<uint64_t>(seq));
+    }
+    return message;
+  }
+  // cumulative consumption from this sender plus the current inbox limits
+  static Message construct_CREDIT(const std::string &reciever_name,
+                                  uint64_t consumed_messages,
+                                  uint64_t consumed_bytes,
+                                  uint64_t max_messages, uint64_t max_bytes) {
+    Message message;
+    message.header.version = SPEED_VERSION;
+    message.header.type = MessageType::CREDIT;
+    message.header.sender_pid = Utils::getProcessID();
+    message.header.timestamp = Utils::getEpochNanos();
+    message.header.seq_num = -1;
+    message.header.sender = "";
+    message.header.reciever = reciever_name;
+    message.header.priority = Priority::Control;
+    put_u64(message.payload, consumed_messages);
+    put_u64(message.payload, consumed_bytes);
+    put_u64(message.payload, max_messages);
+    put_u64(message.payload, max_bytes);
+    return message;
+  }
+  // The header as it sits on disk: the struct itself with every integer in
+  // big-endian order.
+  static void encode_header(const MessageHeader &header,
+                            uint8_t (&out)[kHeaderWireSize]) {
+    MessageHeader wire = header;
+    wire.sender_pid = swap_big_endian(wire.sender_pid);
+    wire.timestamp = swap_big_endian(wire.timestamp);
+    wire.expires_at = swap_big_endian(wire.expires_at);
+    wire.seq_num = swap_big_endian(wire.seq_num);
+    std::memcpy(out, &wire, kHeaderWireSize);
+  }
+  static bool decode_header(const uint8_t (&in)[kHeaderWireSize],
+                            MessageHeader &header) {
+    std::memcpy(&header, in, kHeaderWireSize);
+    header.sender_pid = swap_big_endian(header.sender_pid);
+    header.timestamp = swap_big_endian(header.timestamp);
+    header.expires_at = swap_big_endian(header.expires_at);
+    header.seq_num = swap_big_endian(header.seq_num);
+    return header.sender.len <= kMaxNameLength &&
+           header.reciever.len <= kMaxNameLength &&
+           static_cast<size_t>(header.priority) < kPriorityLanes;
+  }
+  static void put_u64(std::vector<uint8_t> &out, uint64_t value) {
+    for (int i = sizeof(uint64_t) - 1; i >= 0; --i) {
+      out.push_back(static_cast<uint8_t>((value >> (8 * i)) & 0xFF));
+    }
+  }
   static PMessage destruct_message(const Message &message) {
-    const std::string m =
-        std::string(message.payload.begin(), message.payload.end());
-    PMessage message_(message.header.sender, m, message.header.timestamp);
+    PMessage message_("", "", 0);
+    destruct_message(message, message_);
     return message_;
   }
+  static PMessage destruct_PUBLISH(const Message &message) {
+    PMessage message_("", "", 0);
+    destruct_PUBLISH(message, message_);
+    return message_;
+  }
+  // In-place forms: `out` keeps its string capacity across messages.
+  static void destruct_message(const Message &message, PMessage &out) {
+    out.sender_name.assign(message.header.sender.view());
+    out.message.assign(message.payload.begin(), message.payload.end());
+    out.timestamp = message.header.timestamp;
+    out.topic.clear();
+  }
+  static void destruct_PUBLISH(const Message &message, PMessage &out) {
+    auto sep = std::find(message.payload.begin(), message.payload.end(), '\0');
+    out.sender_name.assign(message.header.sender.view());
+    out.topic.assign(message.payload.begin(), sep);
+    if (sep == message.payload.end())
+      out.message.clear();
+    else
+      out.message.assign(sep + 1, message.payload.end());
+    out.timestamp = message.header.timestamp;
+  }
   static bool validate_message_sent(const Message &message,
                                     const std::string &self_proc_name,
                                     const std::string &reciever_name) {
@@ -169,7 +412,9 @@ struct Message {
       std::cout << "[ERROR]: Mismatch version\n";
       return false;
     }
-    if (message.header.reciever != self_proc_name) {
+    // an empty reciever marks a multicast frame shared by several inboxes
+    if (!message.header.reciever.empty() &&
+        message.header.reciever != self_proc_name) {
       std::cout << "[ERROR]: Mismatch reciever\n";
       return false;
     }
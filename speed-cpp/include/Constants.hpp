@@ -4,6 +4,15 @@
 #include <string>
 namespace SPEED {
 
-constexpr size_t SPEED_VERSION = 0x01;
+constexpr size_t SPEED_VERSION = 0x05;
+
+// MessageHeader::flags
+constexpr uint8_t FLAG_ACK_REQUESTED = 0x01;
+// payload is sealed with the per-peer session key, not the shared key
+constexpr uint8_t FLAG_SESSION_KEY = 0x02;
+
+// Frames declaring a longer payload are rejected before anything is
+// allocated for them.
+constexpr uint32_t kMaxFramePayload = 256u << 20;
 // Libsodium constants
 } // namespace SPEED
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "BinaryMessage.hpp"
+#include <array>
 #include <cstring>
 #include <iostream>
 #include <sodium.h>
@@ -7,7 +8,44 @@
 namespace SPEED {
 class EncryptionManager {
 public:
+  using SessionKey =
+      std::array<unsigned char, crypto_aead_xchacha20poly1305_ietf_KEYBYTES>;
+
+  using PublicKey = std::array<unsigned char, crypto_kx_PUBLICKEYBYTES>;
+  struct KeyPair {
+    PublicKey public_key{};
+    std::array<unsigned char, crypto_kx_SECRETKEYBYTES> secret_key{};
+  };
+  // One AEAD key per direction of a peer-to-peer channel.
+  struct SessionKeys {
+    SessionKey rx{};
+    SessionKey tx{};
+  };
+
+  // Hashes the configured key material into an AEAD key. Done once per key
+  // rather than once per message.
+  static SessionKey deriveKey(const std::vector<uint64_t> &);
+  // Ephemeral crypto_kx key pair, made once per process lifetime.
+  static KeyPair generateKeyPair();
+  // Session keys for the channel between `self` and the owner of `peer`.
+  // The two ends must take opposite roles (`client`), which gives each
+  // end's tx the other's rx. Returns false on an unusable public key.
+  static bool deriveSessionKeys(const KeyPair &self, const PublicKey &peer,
+                                bool client, SessionKeys &out);
   static void Encrypt(Message &, const std::vector<uint64_t> &);
   static void Decrypt(Message &, const std::vector<uint64_t> &);
+  // In place on msg.payload; neither allocates once the payload has room for
+  // the tag.
+  static void Encrypt(Message &, const SessionKey &);
+  static void Decrypt(Message &, const SessionKey &);
+  // Decrypt() that reports an authentication failure instead of throwing.
+  // libsodium wipes the buffer of a frame that fails, so a caller with a
+  // second key to try must keep a copy of the ciphertext.
+  static bool TryDecrypt(Message &, const SessionKey &);
+  // Size of a payload before Encrypt() added its authentication tag.
+  static size_t plaintextSize(size_t ciphertext_size) {
+    constexpr size_t TAG_BYTES = crypto_aead_xchacha20poly1305_ietf_ABYTES;
+    return ciphertext_size > TAG_BYTES ? ciphertext_size - TAG_BYTES : 0;
+  }
 };
-} // namespace SPEED
\ No newline at end of file
+} // namespace SPEED
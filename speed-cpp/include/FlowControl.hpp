@@ -0,0 +1,67 @@
+#pragma once
+#include "BinaryMessage.hpp"
+#include "PeerTable.hpp"
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <string>
+namespace SPEED {
+
+// What a sender does when a peer has no credit left.
+enum class CreditPolicy { Block, Fail, Buffer };
+
+struct CreditState {
+  uint64_t max_messages = 0; // 0 = unlimited
+  uint64_t max_bytes = 0;    // 0 = unlimited
+  uint64_t in_flight_messages = 0;
+  uint64_t in_flight_bytes = 0;
+  size_t buffered_messages = 0;
+};
+
+// Only user data counts against a reciever's credit; control frames (ACK,
+// CREDIT, PING, ...) must keep flowing even when an inbox is full.
+inline bool isMetered(MessageType type) {
+  return type == MessageType::MSG || type == MessageType::PUBLISH;
+}
+
+// Sender-side view of every peer's credit. Consumption is reported as
+// cumulative totals in CREDIT frames, so a lost or duplicated frame never
+// corrupts the accounting. Not thread-safe; SPEED guards it with
+// write_mutex_.
+class CreditLedger {
+public:
+  bool isKnown(PeerId) const;
+  void setLimits(PeerId, uint64_t, uint64_t);
+  bool canSend(PeerId, uint64_t bytes) const;
+  void onSent(PeerId, uint64_t bytes);
+  void onCredit(PeerId, uint64_t consumed_messages, uint64_t consumed_bytes,
+                uint64_t max_messages, uint64_t max_bytes);
+  // Starts the sent and consumed totals again from zero, as a peer that
+  // lost its state counts its consumption anew.
+  void restart(PeerId);
+  std::deque<Message> &backlog(PeerId);
+  CreditState state(PeerId) const;
+
+  // The reciever advertises its limits in <inbox>/.credit so a sender knows
+  // them before the first CREDIT frame arrives.
+  static bool writeAdvertisement(const std::filesystem::path &, uint64_t,
+                                 uint64_t);
+  static bool readAdvertisement(const std::filesystem::path &, uint64_t &,
+                                uint64_t &);
+
+private:
+  struct PeerCredit {
+    bool known = false; // limits have been looked up
+    uint64_t max_messages = 0;
+    uint64_t max_bytes = 0;
+    uint64_t sent_messages = 0;
+    uint64_t sent_bytes = 0;
+    uint64_t consumed_messages = 0;
+    uint64_t consumed_bytes = 0;
+    std::deque<Message> backlog;
+  };
+
+  PeerMap<PeerCredit> peers_;
+};
+
+} // namespace SPEED
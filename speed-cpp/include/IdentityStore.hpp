@@ -0,0 +1,48 @@
+#pragma once
+#include "EncryptionManager.hpp"
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+namespace SPEED {
+
+// A process's long-term crypto_kx key pair and the public keys its peers
+// presented on first contact, kept in one 0600 file. Keeping the pair lets
+// a restarted process open the frames sealed to its previous instance;
+// pinning the peers' keys stops anyone who only holds the shared key from
+// taking over an established session with a handshake of their own.
+class IdentityStore {
+public:
+  // Loads the identity at `path`, creating it with a new key pair if there
+  // is none. Throws std::runtime_error if the file cannot be read or
+  // written, or holds an incompatible layout.
+  explicit IdentityStore(const std::filesystem::path &path);
+  ~IdentityStore();
+  IdentityStore(const IdentityStore &) = delete;
+  IdentityStore &operator=(const IdentityStore &) = delete;
+
+  const EncryptionManager::KeyPair &keyPair() const { return kx_; }
+
+  // The key pinned for `peer`, if any.
+  bool pinned(std::string_view peer, EncryptionManager::PublicKey &out) const;
+  // Pins (or replaces) the key of `peer` and saves the file. Returns false
+  // if it could not be saved; the pin then lasts until the process exits.
+  bool pin(std::string_view peer, const EncryptionManager::PublicKey &);
+  bool unpin(std::string_view peer);
+  void forEach(const std::function<void(std::string_view,
+                                        const EncryptionManager::PublicKey &)>
+                   &visit) const;
+
+private:
+  void load_();
+  void save_() const; // callers hold mtx_
+
+  std::filesystem::path path_;
+  EncryptionManager::KeyPair kx_;
+  std::map<std::string, EncryptionManager::PublicKey, std::less<>> pinned_;
+  mutable std::mutex mtx_;
+};
+
+} // namespace SPEED
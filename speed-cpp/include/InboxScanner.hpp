@@ -0,0 +1,107 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace SPEED {
+
+// A parsed "<ts>_<sender>_<lane>_<seq>_<uuid>.ospeed" inbox filename. The
+// views point into the name that was parsed.
+struct FrameName {
+  std::string_view sender;
+  size_t lane;
+  long long seq;
+};
+
+// Hand-rolled equivalent of matching
+//   (\d+)_([A-Za-z0-9_]+)_(\d)_(\d+)_([A-Za-z0-9-]+)\.ospeed
+// that never allocates. The sender may itself contain '_', so the fixed
+// fields are split off from the right. Rejects lanes >= kPriorityLanes and
+// seqs that overflow.
+std::optional<FrameName> parseFrameName(std::string_view name);
+
+// Lists the regular files of one directory. On Linux the directory stays
+// open and is read with getdents64 into a reused buffer, so a pass costs no
+// per-entry allocation or stat; elsewhere it falls back to
+// std::filesystem::directory_iterator.
+class InboxScanner {
+public:
+  explicit InboxScanner(const std::filesystem::path &dir);
+  ~InboxScanner();
+  InboxScanner(const InboxScanner &) = delete;
+  InboxScanner &operator=(const InboxScanner &) = delete;
+
+  // Calls `visit` with each filename. The view is only valid during the
+  // call. Returns the number of names visited.
+  size_t scan(const std::function<void(std::string_view)> &visit);
+
+private:
+  bool open_();
+
+  std::filesystem::path dir_;
+  int fd_ = -1;
+  std::vector<char> buf_;
+};
+
+// An inbox split into one subdirectory per sender. A pass only lists the
+// shards whose directory changed since they were last listed, so an idle
+// sender costs one stat instead of a listing of its backlog.
+class ShardedInbox {
+public:
+  // Entries newer than this when listed are listed again on the next pass:
+  // a file added within the same mtime tick would not move the mtime.
+  static constexpr std::chrono::milliseconds kSettleTime{100};
+
+  explicit ShardedInbox(const std::filesystem::path &root);
+
+  // Calls `visit(shard, filename)` for every file of every shard that may
+  // have changed; `visit` returns whether the file is a pending frame.
+  // Returns the number of shards listed.
+  size_t scan(
+      const std::function<bool(std::string_view, std::string_view)> &visit);
+  // scan() with the shards listed concurrently on up to `threads` threads.
+  // `visit` is called from those threads, one shard per thread at a time,
+  // so it must be thread-safe. Meant for indexing a backlog at startup.
+  size_t scanParallel(
+      const std::function<bool(std::string_view, std::string_view)> &visit,
+      size_t threads);
+  // Lists `shard` again on the next pass even if it looks unchanged, e.g.
+  // because some of its frames were left on disk.
+  void touch(std::string_view shard);
+  // Pending frames as of each shard's latest listing.
+  size_t pending() const;
+
+private:
+  struct DirStamp {
+    std::filesystem::file_time_type mtime{};
+    bool settled = false; // mtime was already old when last listed
+  };
+  struct Shard {
+    explicit Shard(const std::filesystem::path &dir, std::string name)
+        : name(std::move(name)), scanner(dir) {}
+    std::string name;
+    InboxScanner scanner;
+    DirStamp stamp;
+    size_t pending = 0;
+    uint64_t inode = 0; // tells a shard apart from one re-created in its place
+  };
+
+  static bool changed_(const std::filesystem::path &, DirStamp &);
+  static uint64_t inode_(const std::filesystem::path &);
+  void refreshShards_();
+  static void list_(
+      Shard &,
+      const std::function<bool(std::string_view, std::string_view)> &visit);
+
+  std::filesystem::path root_;
+  DirStamp root_stamp_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+} // namespace SPEED
@@ -0,0 +1,66 @@
+#pragma once
+#include "BinaryMessage.hpp"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+namespace SPEED {
+
+struct MessagePoolStats {
+  size_t in_use = 0;     // leases currently handed out
+  size_t high_water = 0; // most leases ever out at once
+  size_t cached = 0;     // idle messages kept for reuse
+  uint64_t hits = 0;     // acquires served from the cache
+  uint64_t misses = 0;   // acquires that had to allocate
+};
+
+// Recycles received Messages and their payload buffers. Buffers are kept in
+// power-of-two size classes from 256 B to 1 MiB so a small control frame
+// never pins a large payload buffer; larger payloads are allocated and freed
+// as before. Thread-safe.
+class MessagePool {
+public:
+  static constexpr size_t kMinClassShift = 8;  // 256 B
+  static constexpr size_t kMaxClassShift = 20; // 1 MiB
+  static constexpr size_t kClasses = kMaxClassShift - kMinClassShift + 1;
+  static constexpr size_t kMaxCachedPerClass = 16;
+
+  // Owns a Message until it goes out of scope, then hands it back.
+  class Lease {
+  public:
+    Lease() = default;
+    Lease(Lease &&) noexcept = default;
+    Lease &operator=(Lease &&other) noexcept;
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+    ~Lease();
+
+    Message &operator*() const { return *msg_; }
+    Message *operator->() const { return msg_.get(); }
+
+  private:
+    friend class MessagePool;
+    Lease(MessagePool *pool, std::unique_ptr<Message> msg)
+        : pool_(pool), msg_(std::move(msg)) {}
+
+    MessagePool *pool_ = nullptr;
+    std::unique_ptr<Message> msg_;
+  };
+
+  // A message whose payload can hold at least `payload_bytes` without
+  // reallocating. Its header and payload contents are unspecified.
+  Lease acquire(size_t payload_bytes);
+  MessagePoolStats stats() const;
+
+private:
+  // class index for a payload of `bytes`, kClasses if it is not pooled
+  static size_t classFor(size_t bytes);
+  void release_(std::unique_ptr<Message>);
+
+  std::array<std::vector<std::unique_ptr<Message>>, kClasses> free_;
+  MessagePoolStats stats_;
+  mutable std::mutex mtx_;
+};
+
+} // namespace SPEED
@@ -0,0 +1,111 @@
+#pragma once
+#include "PeerTable.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+namespace SPEED {
+
+struct HistogramSnapshot {
+  uint64_t count = 0;
+  uint64_t sum_ns = 0;
+  uint64_t min_ns = 0;
+  uint64_t max_ns = 0;
+  // bucket upper bounds, within 1/16 of the true value
+  uint64_t p50_ns = 0;
+  uint64_t p90_ns = 0;
+  uint64_t p99_ns = 0;
+  uint64_t p999_ns = 0;
+};
+
+// Log-linear latency histogram in the style of HdrHistogram: every power of
+// two is split into 16 buckets, so any value is placed within 6.25% using
+// a fixed 8 KiB of counters. Recording is a few relaxed atomic adds and
+// never allocates or locks.
+class LatencyHistogram {
+public:
+  static constexpr size_t kSubBits = 4;
+  static constexpr size_t kSubBuckets = size_t{1} << kSubBits;
+  static constexpr size_t kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+  void record(std::chrono::nanoseconds);
+  HistogramSnapshot snapshot() const;
+
+  static size_t bucketOf(uint64_t value);
+  static uint64_t lowerBound(size_t bucket);
+
+private:
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> min_{UINT64_MAX};
+  std::atomic<uint64_t> max_{0};
+};
+
+struct PeerMetrics {
+  std::string peer;
+  uint64_t sent = 0;
+  uint64_t received = 0;
+  uint64_t sent_bytes = 0;
+  uint64_t received_bytes = 0;
+  uint64_t gaps = 0;  // frames that arrived ahead of their turn
+  uint64_t drops = 0; // frames to or from the peer that were not delivered
+};
+
+struct MetricsSnapshot {
+  std::vector<PeerMetrics> peers; // peers with any traffic
+  HistogramSnapshot end_to_end;   // header timestamp to callback
+  HistogramSnapshot encrypt;
+  HistogramSnapshot decrypt;
+  HistogramSnapshot write;
+  HistogramSnapshot scan; // one watcher pass over the inbox
+  uint64_t reorder_depth = 0; // frames held in reorder buffers
+  uint64_t inbox_depth = 0;   // frames on disk not yet consumed
+
+  std::string toJson() const;
+};
+
+// Always-on metrics of one SPEED instance. Counters live in fixed chunks
+// that are never moved, so after a peer's chunk exists every update is a
+// relaxed atomic add with no lock. Thread-safe.
+class Metrics {
+public:
+  enum class Histogram { EndToEnd, Encrypt, Decrypt, Write, Scan, Count };
+  struct Counters {
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> sent_bytes{0};
+    std::atomic<uint64_t> received_bytes{0};
+    std::atomic<uint64_t> gaps{0};
+    std::atomic<uint64_t> drops{0};
+  };
+  static constexpr size_t kChunkPeers = 64;
+  static constexpr size_t kMaxChunks = 1024;
+
+  Metrics() = default;
+  ~Metrics();
+  Metrics(const Metrics &) = delete;
+  Metrics &operator=(const Metrics &) = delete;
+
+  // Counters of `peer`; ids past kChunkPeers * kMaxChunks share a sink.
+  Counters &peer(PeerId peer);
+  void record(Histogram which, std::chrono::nanoseconds elapsed) {
+    histograms_[static_cast<size_t>(which)].record(elapsed);
+  }
+  void setReorderDepth(uint64_t depth) { reorder_depth_.store(depth); }
+  MetricsSnapshot snapshot(const PeerTable &names) const;
+
+private:
+  using Chunk = std::array<Counters, kChunkPeers>;
+  std::array<std::atomic<Chunk *>, kMaxChunks> chunks_{};
+  std::mutex grow_mutex_; // only taken to add a chunk
+  Counters overflow_;
+  std::array<LatencyHistogram, static_cast<size_t>(Histogram::Count)>
+      histograms_;
+  std::atomic<uint64_t> reorder_depth_{0};
+};
+
+} // namespace SPEED
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+namespace SPEED {
+
+// Compact process-local handle for a peer name.
+using PeerId = uint32_t;
+constexpr PeerId kInvalidPeer = std::numeric_limits<PeerId>::max();
+
+// Interns process names into dense PeerIds the first time they are seen, so
+// per-peer state can live in flat arrays instead of string-keyed hash maps.
+// Each name is stored once and ids are never reused or invalidated.
+// Thread-safe.
+class PeerTable {
+public:
+  PeerId intern(std::string_view name);
+  std::optional<PeerId> find(std::string_view name) const;
+  // The reference stays valid for the lifetime of the table.
+  const std::string &name(PeerId id) const;
+  size_t size() const;
+
+private:
+  std::deque<std::string> names_; // indexed by PeerId; deque keeps refs stable
+  std::unordered_map<std::string_view, PeerId> ids_; // views into names_
+  mutable std::shared_mutex mtx_;
+};
+
+// Per-peer state indexed directly by PeerId; grows on first touch. Not
+// thread-safe, callers guard it like the map it replaces.
+template <typename T> class PeerMap {
+public:
+  T &operator[](PeerId id) {
+    if (id >= slots_.size())
+      slots_.resize(static_cast<size_t>(id) + 1);
+    return slots_[id];
+  }
+  const T *find(PeerId id) const {
+    return id < slots_.size() ? &slots_[id] : nullptr;
+  }
+  // ids below size() are valid to index; slots never touched hold T{}
+  PeerId size() const { return static_cast<PeerId>(slots_.size()); }
+
+private:
+  std::vector<T> slots_;
+};
+
+} // namespace SPEED
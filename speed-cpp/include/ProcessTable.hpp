@@ -0,0 +1,110 @@
+#pragma once
+#include "BinaryMessage.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+namespace SPEED {
+
+struct ProcessInfo {
+  std::string name;
+  uint32_t pid = 0;
+  bool local = false; // pid is in this process' pid space, so it can be probed
+  uint64_t capabilities = 0;
+  uint64_t heartbeat_ms = 0; // wall clock, ms since the epoch
+  uint64_t generation = 0;   // the slot's, as read
+};
+
+// One memory-mapped table of fixed slots shared by every process of a speed
+// dir. Slots are claimed and released with CAS on their state word, so
+// joining, leaving and lookups need no locks and no directory I/O. A fresh
+// (all-zero) file is an empty table, so concurrent creators never race on
+// initialisation.
+//
+// Readers copy a slot under its generation counter and retry if a claim or
+// release moved it meanwhile; the table-wide generation moves on every
+// membership change so callers can skip rereading an unchanged table.
+//
+// A slot's state and the pid and pid space (Utils::pidSpace()) of whoever
+// moves it share one word, so a process that dies halfway through a claim
+// or release is on record and its slot can be reclaimed. Pids are only
+// probed by processes of the same pid space; anyone else goes by the
+// heartbeat and the claim stamp.
+class ProcessTable {
+public:
+  static constexpr size_t kSlots = 1024;
+  static constexpr std::chrono::seconds kHeartbeatInterval{1};
+  // A claim still in progress after this long is abandoned, even if its
+  // pid has been reused.
+  static constexpr std::chrono::seconds kClaimTimeout{5};
+  // A slot held under a pid that cannot be probed from here is abandoned
+  // once its heartbeat is this old.
+  static constexpr std::chrono::seconds kHeartbeatTimeout{10};
+
+  // Maps (creating if needed) the table at `path`. Throws
+  // std::runtime_error if the file cannot be mapped or holds an
+  // incompatible layout.
+  explicit ProcessTable(const std::filesystem::path &path);
+  // Unmaps the table; a claimed slot is released first.
+  ~ProcessTable();
+  ProcessTable(const ProcessTable &) = delete;
+  ProcessTable &operator=(const ProcessTable &) = delete;
+
+  // Publishes this process under `name`. A slot still held under the same
+  // name by this process or by a dead one, e.g. a crashed earlier instance,
+  // is taken over; a holder in another pid space counts as dead once its
+  // heartbeat is older than kHeartbeatTimeout. Returns false if a live
+  // process holds the name or the table is full.
+  bool claim(std::string_view name, uint64_t capabilities);
+  void release();
+  // Frees the slot `info` was read from, unless it has been reclaimed or
+  // released since.
+  bool evict(const ProcessInfo &info);
+  // Refreshes the heartbeat of the claimed slot, at most once per
+  // kHeartbeatInterval.
+  void beat();
+
+  uint64_t generation() const;
+  std::optional<ProcessInfo> find(std::string_view name) const;
+  void forEach(const std::function<void(const ProcessInfo &)> &visit) const;
+
+private:
+  struct Slot {
+    uint64_t owner; // pid << 32 | pid space tag << 2 | SlotState, atomic
+    uint64_t generation; // bumped by every claim and release
+    uint64_t capabilities;
+    uint64_t heartbeat_ms;
+    char name[kMaxNameLength + 1];
+    uint64_t claimed_ms; // while Claiming: when it began, 0 until stamped
+    char reserved[24];
+  };
+  struct Header {
+    uint64_t magic;
+    uint64_t generation;
+    char reserved[48];
+  };
+  static_assert(sizeof(Slot) == 128 && sizeof(Header) == 64);
+
+  static size_t home_(std::string_view name);
+  static bool abandoned_(const Slot &, uint64_t owner);
+  bool read_(const Slot &, ProcessInfo &, uint64_t *owner = nullptr) const;
+  bool enter_(Slot &, uint64_t expected);
+  bool leave_(Slot &, uint64_t owner);
+  bool fill_(Slot &, uint64_t expected, std::string_view name,
+             uint64_t capabilities);
+  bool free_(Slot &, uint64_t generation);
+
+  void *map_ = nullptr;
+  size_t map_size_ = 0;
+  Header *header_ = nullptr;
+  Slot *slots_ = nullptr;
+  Slot *own_ = nullptr;
+  uint64_t own_generation_ = 0; // own_'s generation as claimed
+  std::chrono::steady_clock::time_point last_beat_{};
+};
+
+} // namespace SPEED
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+namespace SPEED {
+
+enum class InvokeStatus : uint8_t { OK, NOT_FOUND, FAILED };
+
+struct InvokeCall {
+  std::string method;
+  std::vector<std::string> args;
+};
+
+struct InvokeResult {
+  std::string method;
+  InvokeStatus status;
+  std::string error;
+};
+
+// Wire format for the INVOKE_METHOD / INVOKE_RESULT payloads. Everything is
+// big-endian and length-prefixed, same as the on-disk header fields:
+//   batch:   u32 count, { str method, u32 argc, { str arg }* }*
+//   results: u32 count, { str method, u8 status, str error }*
+class RemoteInvocation {
+public:
+  static std::vector<uint8_t> encodeBatch(const std::vector<InvokeCall> &);
+  static std::vector<InvokeCall> decodeBatch(const std::vector<uint8_t> &);
+  static std::vector<uint8_t>
+  encodeResults(const std::vector<InvokeResult> &);
+  static std::vector<InvokeResult>
+  decodeResults(const std::vector<uint8_t> &);
+};
+
+} // namespace SPEED
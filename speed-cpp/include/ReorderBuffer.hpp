@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace SPEED {
+
+// Frames of one sender lane that arrived ahead of their turn, held in a ring
+// indexed by seq. Everything below next() has been consumed, so it doubles
+// as the dedup watermark: a frame can be recognised as already handled from
+// its seq alone. Memory is bounded by the reorder window, not by the size of
+// the inbox backlog; frames further ahead stay on disk until the window
+// reaches them. Not thread-safe; SPEED guards it with fifo_mutex_.
+class ReorderBuffer {
+public:
+  static constexpr size_t kDefaultWindow = 4096;
+
+  enum class InsertResult {
+    Buffered,    // newly held
+    Duplicate,   // already held
+    Consumed,    // below the watermark
+    OutOfWindow, // too far ahead; retry on a later scan
+  };
+
+  explicit ReorderBuffer(size_t max_window = kDefaultWindow);
+
+  InsertResult insert(long long seq, std::string_view file);
+  // The frame at next(), or nullptr if it has not arrived yet.
+  const std::string *front() const;
+  // Consumes the frame at next() and advances the watermark.
+  void pop();
+  // Moves the watermark of an empty buffer to `next`, e.g. when resuming
+  // from saved state. Ignored once frames are held.
+  void resume(long long next);
+  // Forgets every held frame and moves the watermark to `next`, e.g. when
+  // the sender restarted its seqs. The files stay on disk to be indexed
+  // again.
+  void reset(long long next);
+  long long next() const { return next_; }
+  size_t size() const { return size_; }
+
+private:
+  struct Slot {
+    bool present = false;
+    std::string file; // keeps its capacity when the slot is reused
+  };
+
+  void grow_(size_t min_span);
+
+  std::vector<Slot> slots_; // power-of-two sized, indexed by seq & mask
+  size_t max_window_;
+  long long next_ = 0;
+  size_t size_ = 0;
+};
+
+} // namespace SPEED
@@ -4,33 +4,128 @@
 #include "BinaryMessage.hpp"
 #include "Constants.hpp"
 #include "EncryptionManager.hpp"
+#include "FlowControl.hpp"
+#include "IdentityStore.hpp"
+#include "InboxScanner.hpp"
 #include "KeyManager.hpp"
+#include "MessagePool.hpp"
+#include "Metrics.hpp"
+#include "PeerTable.hpp"
+#include "ReorderBuffer.hpp"
+#include "RemoteInvocation.hpp"
+#include "SeqState.hpp"
+#include "ThreadPool.hpp"
+#include "TopicRegistry.hpp"
+#include "Tracer.hpp"
 #include "Utils.hpp"
+#include "WorkQueue.hpp"
 
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <filesystem>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
-#include <regex>
+#include <shared_mutex>
 #include <sstream>
 #include <thread>
+#include <tuple>
 #include <vector>
 namespace SPEED {
 
 enum class ThreadMode { Single = 0, Multi = 1 };
 
+// What the startup recovery pass found in the inbox.
+struct RecoveryStats {
+  size_t shards = 0;  // sender shards listed
+  size_t frames = 0;  // backlog frames buffered for delivery
+  size_t orphans = 0; // half-written files removed
+  std::chrono::microseconds elapsed{0};
+};
+
+// A received frame that could not be read, opened or handled, and was moved
+// out of the inbox instead.
+struct QuarantinedFrame {
+  std::string sender;
+  std::filesystem::path file; // where it now lives
+  std::string reason;
+};
+
 class SPEED {
 public:
   using RemoteFunction = std::function<void(const std::vector<std::string> &)>;
+  using InvokeResultCallback = std::function<void(
+      const std::string &, const std::vector<InvokeResult> &)>;
+  using JobHandler = std::function<void(const PMessage &)>;
+  using ErrorCallback = std::function<void(const QuarantinedFrame &)>;
 
-  void sendMessage(const std::string &, const std::string &);
+  bool sendMessage(const std::string &, const std::string &,
+                   Priority = Priority::Normal);
+  bool sendMessage(const std::string &, const std::vector<std::string> &,
+                   Priority = Priority::Normal);
+  bool sendMessage(const std::string &msg,
+                   std::initializer_list<std::string> recievers,
+                   Priority priority = Priority::Normal) {
+    return sendMessage(msg, std::vector<std::string>(recievers), priority);
+  }
+  void subscribe(const std::string &);
+  void unsubscribe(const std::string &);
+  bool publish(const std::string &, const std::string &,
+               Priority = Priority::Normal);
+  bool submitJob(const std::string &, const std::string &);
+  void consumeQueue(const std::string &, JobHandler);
+  void stopConsuming(const std::string &);
+  void setAckWindow(size_t,
+                    std::chrono::milliseconds = std::chrono::seconds(30));
+  bool flush(const std::string &,
+             std::chrono::milliseconds = std::chrono::seconds(30));
+  long long getAckedCount(const std::string &);
+  void setInboxLimit(uint64_t, uint64_t = 0);
+  void setCreditPolicy(CreditPolicy,
+                       std::chrono::milliseconds = std::chrono::seconds(30));
+  CreditState getCreditState(const std::string &);
+  size_t getInboxDepth() const;
+  void setMessageTTL(std::chrono::milliseconds);
+  uint64_t getExpiredCount() const;
+  // Frames moved to <speed_dir>/quarantine/<name>/ instead of being
+  // delivered; the callback hears about each one as it happens.
+  uint64_t getQuarantinedCount() const;
+  void setErrorCallback(ErrorCallback);
+  // Receive-side buffer reuse; high_water is the most frames held at once.
+  MessagePoolStats getMessagePoolStats() const;
+  // What start() found in the inbox before the watcher began.
+  RecoveryStats getRecoveryStats() const;
+  // Per-peer counters, latency histograms and queue depths. A non-zero
+  // interval also has the watcher write them to
+  // <speed_dir>/metrics/<name>.json that often.
+  MetricsSnapshot getMetrics() const;
+  void setMetricsDump(std::chrono::seconds);
+  // Records the lifecycle of every `sample_every`th message of each lane,
+  // sent or recieved, keeping the newest `capacity` events; 0 turns it off.
+  // Both ends need the same interval to trace the same messages. May be
+  // called from a callback.
+  void setTracing(uint32_t sample_every,
+                  size_t capacity = Tracer::kDefaultCapacity);
+  // Writes the recorded events as Chrome trace JSON; Tracer::merge() joins
+  // the files of several processes.
+  bool exportTrace(const std::filesystem::path &) const;
+  // Discover peers through the shared mmap'd process table instead of the
+  // access_registry directory; all processes of the session must opt in.
+  bool useProcessTable();
+  // How long the inbox of a dead process is kept before the watcher deletes
+  // it; 0 keeps dead inboxes forever.
+  void setInboxRetention(std::chrono::seconds);
+  // Unpins the public key `name` presented on first contact, so its next
+  // handshake may carry a new one; for a peer that lost its identity.
+  void forgetPeerKey(const std::string &name);
   void kill();
   void stop();
   void resume();
@@ -40,12 +135,18 @@ public:
   void registerMethod(const std::string &name,
                       void (T::*method)(const std::vector<std::string> &),
                       T *instance) {
+    std::unique_lock<std::shared_mutex> lock(rfi_mutex_);
     function_registry_[name] = [instance,
                                 method](const std::vector<std::string> &args) {
       (instance->*method)(args);
     };
   }
   void invokeMethod(const std::string &, const std::vector<std::string> &);
+  void invokeMethod(const std::string &, const std::string &,
+                    const std::vector<std::string> &);
+  void invokeBatch(const std::string &, const std::vector<InvokeCall> &);
+  void setRFIWorkers(size_t);
+  void setInvokeResultCallback(InvokeResultCallback cb);
   bool addProcess(const std::string &);
   void ping(const std::string &);
   void pong(const std::string &);
@@ -54,7 +155,7 @@ public:
   void printGlobalRegistry_() {
     std::cout << "----------Global Registry----------\n";
     auto gr = access_list_->getGlobalRegistry();
-    for (const auto &entry : gr) {
+    for (const auto &entry : *gr) {
       std::cout << entry << "\n";
     }
     std::cout << "----------Global Registry----------\n";
@@ -63,7 +164,7 @@ public:
   void printAccessList_() {
     std::cout << "----------Access List----------\n";
     auto gr = access_list_->getAccessList();
-    for (const auto &entry : gr) {
+    for (const auto &entry : *gr) {
       std::cout << entry << "\n";
     }
     std::cout << "----------Access List----------\n";
@@ -72,7 +173,7 @@ public:
   void printConnectedList_() {
     std::cout << "----------Connected List----------\n";
     auto gr = access_list_->getConnectedList();
-    for (const auto &entry : gr) {
+    for (const auto &entry : *gr) {
       std::cout << entry << "\n";
     }
     std::cout << "----------Connected List----------\n";
@@ -83,57 +184,249 @@ public:
   ~SPEED();
 
 private:
-  struct ParsedFileInfo {
-    std::string proc_name;
-    long long seq;
-    std::filesystem::path path;
-  };
-
   ThreadMode tmode_;
   std::filesystem::path speed_dir_;
   std::filesystem::path self_speed_dir_;
 
   std::string key_;
+  // key_ hashed once into the AEAD key; re-derived by setKeyFile(). It
+  // seals the handshake and every frame that has more than one reader.
+  EncryptionManager::SessionKey session_key_{};
+  // This process's crypto_kx pair, kept with the peers' pinned keys in
+  // <speed_dir>/identities/<name>.id so sessions survive a restart. null
+  // if the file is unusable; kx_ is then made afresh and nothing is pinned.
+  std::unique_ptr<IdentityStore> identity_;
+  EncryptionManager::KeyPair kx_;
   std::string self_proc_name_;
   std::filesystem::path key_path_;
-  std::atomic<long long> seq_number_{0};
+  // Every peer name is interned once; per-peer state below is indexed by id.
+  PeerTable peers_;
+  // one sequence counter per priority lane
+  using LaneSeqs = std::array<long long, kPriorityLanes>;
+  // next outgoing seq per reciever and lane; each lane's FIFO expects 0, 1..
+  PeerMap<LaneSeqs> send_seq_;
+
+  // Crash-safe copy of the seqs above and of the receive watermarks, in
+  // <speed_dir>/seqstate/<name>.seqstate, so a restart resumes every lane
+  // where it stopped. null if the file could not be mapped. Slots are cached
+  // per peer: persisted_tx_ under write_mutex_, persisted_rx_ on the watcher.
+  std::unique_ptr<SeqState> seq_state_;
+  PeerMap<PeerSeqs *> persisted_tx_;
+  PeerMap<PeerSeqs *> persisted_rx_;
+  // This instance's restart epoch, sent in every handshake, and the last
+  // one each peer sent, under write_mutex_. A peer whose epoch changed lost
+  // its seq state, so both ends start their channel again at seq 0. The
+  // epoch is new whenever the state is: on a first start, once the inbox
+  // was collected, and on every start if the file cannot be mapped.
+  uint64_t epoch_ = 0;
+  PeerMap<uint64_t> peer_epoch_;
+
+  // Acknowledged delivery, all guarded by write_mutex_. acked_seq_ holds the
+  // peer's cumulative ACK per lane: every seq below it has been consumed. The
+  // window counts unacknowledged frames across all lanes.
+  size_t ack_window_ = 0; // 0 = acks off
+  std::chrono::milliseconds ack_timeout_{30000};
+  PeerMap<LaneSeqs> acked_seq_;
+  std::condition_variable flow_cv_; // ACK window and credit waits
+  std::vector<PeerId> ack_due_;     // watcher thread only
+
+  // Credit-based flow control. credits_ and the policy are guarded by
+  // write_mutex_; the reciever side lives on the watcher thread.
+  enum class CreditGrant { Granted, Buffered, Denied };
+  struct ConsumedCount {
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+  };
+  CreditLedger credits_;
+  CreditPolicy credit_policy_ = CreditPolicy::Block;
+  std::chrono::milliseconds credit_timeout_{30000};
+  std::atomic<uint64_t> inbox_max_messages_{0};
+  std::atomic<uint64_t> inbox_max_bytes_{0};
+  PeerMap<ConsumedCount> consumed_;
+  std::vector<PeerId> credit_due_;
+  std::atomic<size_t> inbox_depth_{0};
+
+  // Message expiry. The TTL is stamped on outgoing user messages; expired
+  // frames are dropped on arrival without being decrypted.
+  std::atomic<long long> message_ttl_ms_{0}; // 0 = never expire
+  std::atomic<uint64_t> expired_count_{0};
+
+  // Poison frames. error_callback_ is guarded by callback_mutex_.
+  std::atomic<uint64_t> quarantined_count_{0};
+  ErrorCallback error_callback_;
+
+  // Always-on counters and histograms; recording never takes a lock.
+  Metrics metrics_;
+  std::atomic<long long> metrics_dump_s_{0}; // 0 = no file dumps
+  std::chrono::steady_clock::time_point last_metrics_dump_{};
+
+  // Sampled lifecycle tracing. When the watcher found each sampled frame,
+  // by sender, lane and seq, guarded by fifo_mutex_; and the frame being
+  // handled, if sampled, guarded by callback_mutex_. setTracing() may run
+  // in a callback, under fifo_mutex_, so it only bumps trace_epoch_; the
+  // watcher empties trace_found_ once it sees a new one.
+  Tracer tracer_;
+  using TraceFound = std::map<std::tuple<PeerId, size_t, long long>, uint64_t>;
+  TraceFound trace_found_;
+  std::atomic<uint64_t> trace_epoch_{0};
+  uint64_t trace_found_epoch_ = 0;
+  struct TracedFrame {
+    bool active = false;
+    PeerId sender = 0;
+    size_t lane = 0;
+    long long seq = 0;
+  };
+  TracedFrame traced_frame_;
+
+  // AccessRegistry generation at which each peer last passed all reachability
+  // checks; while the registry is unchanged a send skips the lookups.
+  PeerMap<uint64_t> reachable_at_;
+  std::mutex reach_mutex_;
+
+  // Per-peer session keys from the CON_REQ/CON_RES handshake, derived once
+  // per peer key so sends only index them, and again from the pinned keys
+  // on a restart. prev_rx opens frames the peer sealed before it re-keyed.
+  // Guarded by write_mutex_: sends on any thread add slots, so even the
+  // watcher only reads a session through a copy taken under it.
+  struct PeerSession {
+    bool established = false;
+    EncryptionManager::PublicKey peer_key{};
+    EncryptionManager::SessionKeys keys{};
+    bool has_prev_rx = false;
+    EncryptionManager::SessionKey prev_rx{};
+  };
+  PeerMap<PeerSession> sessions_;
+  enum class SessionOpen { Opened, Pending, Unreadable };
+  // When a CON_REQ went out for a frame we could not open yet; watcher only.
+  PeerMap<std::chrono::steady_clock::time_point> handshake_sent_;
+  static constexpr std::chrono::seconds kHandshakeTimeout{5};
+
+  // Peers found dead by the liveness check; sends to them fail until they
+  // reappear in the registry. Guarded by write_mutex_.
+  PeerMap<uint8_t> evicted_;
+  // Inboxes whose owner was last seen dead, and since when; watcher only.
+  std::atomic<long long> inbox_retention_s_{3600};
+  std::unordered_map<std::string, std::chrono::steady_clock::time_point>
+      dead_inboxes_;
 
   std::function<void(const PMessage &)> callback_;
+  // Received frames are read into pooled Messages and handed back once the
+  // callback returns; delivered_ is the PMessage every callback sees, reused
+  // under callback_mutex_ so its strings keep their capacity.
+  MessagePool rx_pool_;
+  PMessage delivered_{"", "", 0};
+  InvokeResultCallback invoke_result_callback_;
   std::unique_ptr<AccessRegistry> access_list_;
+  std::unique_ptr<TopicRegistry> topic_registry_;
+  std::unique_ptr<WorkQueue> work_queue_;
+  std::unique_ptr<ShardedInbox> inbox_;
 
   std::mutex callback_mutex_;
   std::mutex access_list_mutex_;
   std::mutex key_mutex_;
-  std::mutex seen_mutex_;
   std::mutex heap_mutex_;
   std::mutex single_mtx_;
   std::mutex multi_mutex_;
   std::mutex write_mutex_;
-  std::mutex rfi_mutex_;
+  std::shared_mutex rfi_mutex_; // protects function_registry_
+  std::mutex rfi_pool_mutex_;
   std::mutex watcher_mutex_;
   std::mutex fifo_mutex_;
+  std::mutex queue_mutex_; // protects queue_handlers_
 
   std::thread watcher_thread_;
   std::atomic<bool> watcher_running_{false};
   std::atomic<bool> watcher_should_exit_{false};
 
+  size_t rfi_workers_ = std::max(1u, std::thread::hardware_concurrency());
+  std::unique_ptr<ThreadPool> rfi_pool_;
+
+  // Lower lanes hand the watcher back for a rescan after this many frames
+  // per pass, so newly arrived control traffic is not stuck behind a long
+  // backlog. The Control lane is always drained completely.
+  static constexpr size_t kLaneDrainBudget = 1024;
+  static constexpr size_t kJobClaimBatch = 32;
+  static constexpr std::chrono::seconds kReclaimInterval{5};
+  std::chrono::steady_clock::time_point last_reclaim_{};
+  static constexpr std::chrono::seconds kInboxGcInterval{5};
+  std::chrono::steady_clock::time_point last_inbox_gc_{};
+  // A .ispeed file this old belongs to a writer that crashed before
+  // renaming it.
+  static constexpr std::chrono::seconds kOrphanAge{60};
+  RecoveryStats recovery_stats_;
+  bool recovered_ = false;
+
   void watcherSingleThread_(); // blocking call for single-thread mode
   void watcherMultiThread_();  // non-blocking call for multi-thread mode
-  void processFile_(const std::filesystem::path &file_path);
+  bool processFile_(const std::filesystem::path &file_path, PeerId sender,
+                    size_t lane, long long seq);
+  void handleFrame_(Message &, PeerId);
+  void discardFrame_(const Message &, PeerId, const std::filesystem::path &,
+                     size_t, long long, std::string_view reason = {});
+  void quarantine_(const std::filesystem::path &, PeerId, std::string_view);
+  void saveWatermark_(PeerId, size_t, long long);
+  void deliver_();
+  void traceSend_(const Message &, PeerId, long long, uint64_t, uint64_t,
+                  uint64_t, uint64_t);
+  TraceFound &traceFound_();
+  void sampleReorder_();
+  void dumpMetrics_();
+  SessionOpen openSessionFrame_(Message &, PeerId);
+  bool awaitHandshake_(PeerId);
+  void handleHandshake_(const Message &, PeerId);
+  void restartChannelLocked_(PeerId, long long);
+  void settleConsumed_();
+  void replayHandshake_(PeerId, long long, const std::string &);
+  void announceRestart_();
+  void recordConsumed_(PeerId, uint64_t);
+  void retireFile_(const std::filesystem::path &, PeerId, size_t, long long);
+  PeerSeqs *persisted_(PeerMap<PeerSeqs *> &, PeerId);
+  bool restoreSeqs_();
+  void restoreSessions_();
+  void stampExpiry_(Message &) const;
   void runWatcherLoop_(); // Core FIFO logic
+  void recover_();
+  ReorderBuffer::InsertResult indexFrame_(const FrameName &, std::string_view);
+  size_t drainLane_(size_t, size_t);
   void ping_(const std::string &);
   void pong_(const std::string &);
+  bool dispatch_(Message &, PeerId, bool flow_controlled = false);
+  bool dispatchShared_(Message &, const std::vector<std::string> &,
+                       bool flow_controlled = false);
+  bool writeLocked_(Message &, PeerId);
+  bool onWatcher_() const;
+  bool waitForWindow_(std::unique_lock<std::mutex> &, PeerId);
+  CreditGrant acquireCredit_(std::unique_lock<std::mutex> &, PeerId, uint64_t);
+  void handleCredit_(const Message &, PeerId);
+  void sendPendingControl_();
+  void warnIfUnreachable_(const std::string &);
+  bool evictedLocked_(PeerId);
+  void forgetPeer_(const std::string &);
+  void collectDeadInboxes_();
+  void handleInvokeBatch_(const Message &);
+  InvokeResult runRegisteredMethod_(const InvokeCall &);
+  size_t serveQueues_();
+  void processJob_(const std::string &, const std::filesystem::path &,
+                   const JobHandler &);
 
-  std::optional<ParsedFileInfo>
-  extractFileInfoFromFilename_(const std::filesystem::path &path) const;
-
-  using FileCandidate = std::pair<long long, std::filesystem::path>;
-
-  std::unordered_set<std::string> seen_;
   std::unordered_map<std::string, RemoteFunction> function_registry_;
-  std::unordered_map<std::string, long long> next_expected_seq_;
-  std::unordered_map<std::string, std::map<long long, std::filesystem::path>>
-      sender_buffers_;
+  std::unordered_map<std::string, JobHandler> queue_handlers_;
+  // frames waiting for their turn, per sender and lane, by inbox filename;
+  // each buffer's next() is that lane's next expected seq
+  using LaneBuffers = std::array<ReorderBuffer, kPriorityLanes>;
+  PeerMap<LaneBuffers> sender_buffers_;
+  // next() + 1 of each lane when it was last counted as stalled on a gap;
+  // watcher only
+  PeerMap<LaneSeqs> gap_counted_;
+  // Frames a scan found below their lane's watermark, deleted once the
+  // handshakes among them were looked at; guarded by fifo_mutex_.
+  struct ConsumedFrame {
+    PeerId sender;
+    size_t lane;
+    long long seq;
+    std::string name;
+  };
+  std::vector<ConsumedFrame> consumed_found_;
 };
 
 } // namespace SPEED
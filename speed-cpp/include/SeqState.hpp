@@ -0,0 +1,77 @@
+#pragma once
+#include "BinaryMessage.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string_view>
+namespace SPEED {
+
+// Sequence numbers one process must not lose across a restart, per peer.
+struct PeerSeqs {
+  int64_t send[kPriorityLanes]; // next seq to stamp, per lane
+  int64_t recv[kPriorityLanes]; // receive watermark of the peer's lanes
+  uint64_t consumed_messages;   // credit totals reported to the peer
+  uint64_t consumed_bytes;
+  uint64_t epoch; // the peer's restart epoch, 0 until its handshake is seen
+};
+
+// A process's sequence state in a small memory-mapped file of fixed slots,
+// one per peer. Updates are plain stores into the shared mapping: they cost
+// no syscall and are in the page cache the moment they are made, so they
+// survive a crash of the process. Slots are only ever added, and the file
+// belongs to a single process; other processes never map it.
+//
+// The file also holds the process's restart epoch, drawn when the file
+// starts out empty. Peers compare it on every handshake: a new epoch means
+// the process lost its state and restarted its seqs at 0.
+class SeqState {
+public:
+  static constexpr size_t kSlots = 1024;
+
+  // <speed_dir>/seqstate/<proc>.seqstate: outside the inbox, so collecting
+  // the inbox of a dead process does not take its state with it.
+  static std::filesystem::path pathFor(const std::filesystem::path &speed_dir,
+                                       std::string_view proc);
+  // A random, non-zero epoch.
+  static uint64_t newEpoch();
+
+  // Maps (creating if needed) the state file at `path`. Throws
+  // std::runtime_error if the file cannot be mapped or holds an
+  // incompatible layout.
+  explicit SeqState(const std::filesystem::path &path);
+  ~SeqState();
+  SeqState(const SeqState &) = delete;
+  SeqState &operator=(const SeqState &) = delete;
+
+  // The slot of `peer`, added zeroed on first use. The pointer stays valid
+  // for the lifetime of the object; nullptr if the file is full.
+  PeerSeqs *get(std::string_view peer);
+  void forEach(
+      const std::function<void(std::string_view, const PeerSeqs &)> &visit)
+      const;
+  uint64_t epoch() const { return header_->epoch; }
+
+private:
+  struct Slot {
+    char name[kMaxNameLength + 1]; // NUL-terminated
+    PeerSeqs seqs;
+    char reserved[40];
+  };
+  struct Header {
+    uint64_t magic;
+    uint64_t used; // slots [0, used) are taken
+    uint64_t epoch;
+    char reserved[40];
+  };
+  static_assert(sizeof(Slot) == 192 && sizeof(Header) == 64);
+
+  void *map_ = nullptr;
+  size_t map_size_ = 0;
+  Header *header_ = nullptr;
+  Slot *slots_ = nullptr;
+  mutable std::mutex mtx_; // slot lookup and addition
+};
+
+} // namespace SPEED
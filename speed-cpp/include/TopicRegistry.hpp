@@ -0,0 +1,48 @@
+#pragma once
+#include "Utils.hpp"
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+namespace SPEED {
+// Topic membership lives under access_registry/topics/<topic>/<proc>.osub.
+// Subscriber sets are cached per topic and only re-read when the topic
+// directory's mtime moves, so publishing costs one stat rather than a walk
+// of the filesystem.
+class TopicRegistry {
+public:
+  TopicRegistry(const std::filesystem::path &, const std::string &);
+
+  bool subscribe(const std::string &topic);
+  bool unsubscribe(const std::string &topic);
+  void removeAllSubscriptions();
+
+  std::vector<std::string> getSubscribers(const std::string &topic);
+  std::unordered_set<std::string> getSubscriptions() const;
+  // Re-reads every cached topic whose directory changed.
+  void refresh();
+  // The same for one topic, as a publish does before reading its
+  // subscribers.
+  void refresh(const std::string &topic);
+
+  static bool validateTopicName(const std::string &topic);
+
+private:
+  struct TopicCache {
+    std::filesystem::file_time_type mtime{};
+    std::unordered_set<std::string> subscribers;
+  };
+
+  void loadTopic_(const std::string &topic, TopicCache &cache);
+  void refreshTopic_(const std::string &topic, TopicCache &cache);
+
+  std::filesystem::path topics_path_;
+  std::string proc_name_;
+  std::unordered_set<std::string> subscriptions_;
+  std::unordered_map<std::string, TopicCache> cache_;
+
+  mutable std::mutex mtx_;
+};
+} // namespace SPEED
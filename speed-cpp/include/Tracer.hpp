@@ -0,0 +1,79 @@
+#pragma once
+#include "PeerTable.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+namespace SPEED {
+
+// Lifecycle stages of a traced frame. The first four happen on the sending
+// side, the rest on the recieving side.
+enum class TraceStage : uint8_t {
+  Send,    // sendMessage() entry until the frame is in the inbox
+  Encrypt, // sealing the payload
+  Write,   // writing the .ispeed file
+  Rename,  // publishing it as .ospeed
+  Queued,  // discovery by the watcher until the frame's turn comes
+  Read,    // readBinary()
+  Decrypt, // opening the payload
+  Callback // the user callback
+};
+
+struct TraceEvent {
+  uint64_t start_ns = 0; // ns since the unix epoch
+  uint64_t end_ns = 0;
+  long long seq = 0;
+  PeerId peer = 0; // the other end of the frame
+  uint32_t tid = 0;
+  uint8_t lane = 0;
+  TraceStage stage = TraceStage::Send;
+};
+
+// Sampled per-frame tracing into a fixed ring buffer, exported as Chrome
+// trace JSON for chrome://tracing or Perfetto. A frame is traced when its
+// seq is a multiple of the sampling interval, so a sender and a reciever
+// with the same interval pick the same frames without marking them on the
+// wire; a flow arrow links the two sides of each frame. Only sampled frames
+// reach record(), so its lock is off the path of every other frame.
+// Thread-safe.
+class Tracer {
+public:
+  static constexpr size_t kDefaultCapacity = 1 << 16;
+
+  // Traces every `sample_every`th frame of each lane, keeping the newest
+  // `capacity` events; 0 turns tracing off. Clears earlier events.
+  void enable(uint32_t sample_every, size_t capacity = kDefaultCapacity);
+  bool enabled() const {
+    return sample_every_.load(std::memory_order_relaxed) != 0;
+  }
+  bool sampled(long long seq) const {
+    const uint32_t every = sample_every_.load(std::memory_order_relaxed);
+    return every != 0 && seq % every == 0;
+  }
+  void record(TraceStage, PeerId, size_t lane, long long seq,
+              uint64_t start_ns, uint64_t end_ns);
+  // Events oldest first.
+  std::vector<TraceEvent> events() const;
+  // {"traceEvents":[...]} with `self` as the process name. Flow ids are
+  // derived from both ends' names, lane and seq, so they match across
+  // processes.
+  std::string toJson(const PeerTable &names, std::string_view self) const;
+
+  // Writes the events of several exported traces into one file, so both
+  // sides of a conversation show on one timeline.
+  static bool merge(const std::vector<std::filesystem::path> &inputs,
+                    const std::filesystem::path &output);
+
+private:
+  std::atomic<uint32_t> sample_every_{0};
+  mutable std::mutex mtx_;
+  std::vector<TraceEvent> ring_;
+  size_t next_ = 0; // slot the next event goes to
+  bool wrapped_ = false;
+};
+
+} // namespace SPEED
@@ -8,6 +8,7 @@
 #include <sodium.h>
 #include <sstream>
 #include <string>
+#include <string_view>
 #if defined(_WIN32)
 #include <windows.h>
 #elif defined(__unix__) || defined(__APPLE__)
@@ -18,12 +19,49 @@ namespace Utils {
 
 std::filesystem::path getDefaultSPEEDDir();
 std::string getCurrentTimestamp();
+uint64_t getEpochMillis();
+uint64_t getEpochNanos();
 std::string generateUUID();
+// Allocation-free forms of getCurrentTimestamp() and generateUUID() for the
+// send path. Both write exactly the buffer size minus one characters plus a
+// terminating NUL.
+constexpr size_t kTimestampChars = 17; // "YYYYmmddHHMMSSmmm"
+constexpr size_t kUUIDChars = 36;
+void formatTimestamp(char (&out)[kTimestampChars + 1]);
+void formatUUID(char (&out)[kUUIDChars + 1]);
 std::string getTimestampUUID();
 bool createDefaultDir(const std::filesystem::path &);
 bool createAccessRegistryDir(const std::filesystem::path &);
 uint64_t getProcessID();
+bool isProcessAlive(uint64_t);
+// The pid space this process lives in: the boot of its host and, on Linux,
+// its pid namespace. A pid is only meaningful to isProcessAlive() where it
+// was recorded, so pids are written next to this and only probed by
+// processes that share it; anyone else (a container sharing the speed dir,
+// another host) has to go by a heartbeat. Empty if it cannot be told.
+const std::string &pidSpace();
+bool isLocalPidSpace(std::string_view space);
 bool validateKey(const std::string &);
+// process, topic and queue names: [A-Za-z0-9_]+ so they are safe both as
+// path components and inside "<ts>_<name>_<seq>_<uuid>" filenames
+inline bool validateName(const std::string &name) {
+  if (name.empty())
+    return false;
+  for (char c : name) {
+    const bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                    (c >= '0' && c <= '9') || c == '_';
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+// Names of the directories SPEED keeps next to the inboxes in the speed dir,
+// or inside an inbox next to the sender shards; no process may take one.
+bool isReservedName(std::string_view name);
+// `text` with the characters JSON does not allow inside a string escaped.
+// Peer names in the metrics and trace dumps go through it: they are
+// whatever a send was addressed to, not necessarily valid process names.
+std::string jsonEscape(std::string_view text);
 inline bool fileExists(const std::filesystem::path &fpath) {
   try {
     return std::filesystem::exists(fpath) &&
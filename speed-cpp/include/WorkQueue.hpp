@@ -0,0 +1,42 @@
+#pragma once
+#include "BinaryManager.hpp"
+#include "BinaryMessage.hpp"
+#include "Utils.hpp"
+#include <filesystem>
+#include <string>
+#include <vector>
+namespace SPEED {
+// Competing-consumer queues shared by every process in the speed dir.
+//
+//   speed_dir/queues/<queue>/<ts>_<producer>_<uuid>.ojob   pending jobs
+//   speed_dir/<proc>/claimed/<queue>/<same name>           claimed by <proc>
+//   speed_dir/<proc>/claimed/.owner                        pid, pid space
+//
+// A worker claims a job by renaming it into its own claimed/ directory;
+// rename is atomic, so exactly one worker wins. A claim is acknowledged by
+// deleting the file. Claims whose owner pid is gone are renamed back into
+// the queue; that is only decided by processes of the owner's pid space
+// (Utils::pidSpace()).
+class WorkQueue {
+public:
+  WorkQueue(const std::filesystem::path &, const std::string &);
+
+  bool submit(const Message &, const std::string &queue);
+  std::vector<std::filesystem::path> claim(const std::string &queue,
+                                           size_t max_jobs);
+  void complete(const std::filesystem::path &claimed);
+  size_t requeueOwnClaims();
+  size_t reclaimDeadClaims();
+
+  static bool validateQueueName(const std::string &queue);
+
+private:
+  size_t requeueClaimDir_(const std::filesystem::path &claim_dir);
+  void writeOwnerFile_();
+
+  std::filesystem::path speed_dir_;
+  std::filesystem::path queues_path_;
+  std::filesystem::path claim_path_;
+  std::string proc_name_;
+};
+} // namespace SPEED
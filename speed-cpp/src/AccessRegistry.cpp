@@ -1,10 +1,38 @@
 #include "../include/AccessRegistry.hpp"
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
 
 namespace SPEED {
 
+namespace {
+constexpr std::string_view kRegistryExt = ".oregistry";
+// an mtime younger than this when the directory was listed is not trusted
+constexpr std::chrono::milliseconds kMtimeSettle{100};
+// bounds the negative cache when sends target many absent names
+constexpr size_t kMaxCachedMisses = 1024;
+
+uint64_t nextRegistryId() {
+  static std::atomic<uint64_t> next{1};
+  return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+// "<name>.oregistry" -> "<name>", anything else -> empty
+std::string_view registryName(std::string_view file) {
+  if (file.size() <= kRegistryExt.size() ||
+      file.substr(file.size() - kRegistryExt.size()) != kRegistryExt)
+    return {};
+  return file.substr(0, file.size() - kRegistryExt.size());
+}
+} // namespace
+
 AccessRegistry::AccessRegistry(const std::filesystem::path &ac_path,
                                const std::string &proc_name)
-    : ac_path_(ac_path), access_filename_(proc_name) {
+    : id_(nextRegistryId()), ac_path_(ac_path), access_filename_(proc_name) {
   if (!Utils::directoryExists(ac_path)) {
     Utils::createAccessRegistryDir(ac_path);
   }
@@ -12,42 +40,347 @@ AccessRegistry::AccessRegistry(const std::filesystem::path &ac_path,
     removeAccessFile();
   }
   this->proc_name_ = proc_name;
+  snapshot_.store(std::make_shared<const AclSnapshot>());
   putAccessFile();
+  // watch before the first listing so no arrival falls between the two
+  watch_();
   incrementalBuildGlobalRegistry();
   printRegistry();
 }
 
+AccessRegistry::~AccessRegistry() { unwatch_(); }
+
+uint64_t AccessRegistry::getGeneration() const {
+  return published_.load(std::memory_order_acquire);
+}
+
 const std::filesystem::path &AccessRegistry::getAccessRegistryPath() const {
   return ac_path_;
 }
 
 void AccessRegistry::incrementalBuildGlobalRegistry() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  rescan_();
+  publish_();
+}
+
+void AccessRegistry::rescan_() {
+  std::unordered_set<std::string> current;
+  if (table_) {
+    table_generation_ = table_->generation();
+    table_->forEach([&](const ProcessInfo &info) {
+      if (info.name != proc_name_)
+        current.insert(info.name);
+    });
+    applyListing_(current);
+    return;
+  }
+
+  const auto now = std::filesystem::file_time_type::clock::now();
+  std::error_code ec;
+  const auto mtime = std::filesystem::last_write_time(ac_path_, ec);
   try {
-    for (const auto &entry :
-         std::filesystem::recursive_directory_iterator(ac_path_)) {
-      std::string name = entry.path().stem().string();
-      if (name == proc_name_)
-        continue;
-      if (global_registry_.find(name) == global_registry_.end()) {
-        global_registry_.insert(name);
-        std::cout << "[INFO] Added to registry: " << name << "\n";
-      } else {
-        std::cout << "[SKIP] Already present: " << name << "\n";
-      }
+    // only published process entries; skips the topics directory and
+    // half-written .iregistry files
+    for (const auto &entry : std::filesystem::directory_iterator(ac_path_)) {
+      const std::string file = entry.path().filename().string();
+      const std::string_view name = registryName(file);
+      if (!name.empty() && name != proc_name_)
+        current.emplace(name);
     }
   } catch (const std::filesystem::filesystem_error &e) {
     std::cerr << "[ERROR] Filesystem error: " << e.what() << "\n";
+    return;
+  }
+  applyListing_(current);
+  listed_mtime_ = mtime;
+  listed_settled_ = !ec && now - mtime > kMtimeSettle;
+}
+
+void AccessRegistry::applyListing_(
+    const std::unordered_set<std::string> &current) {
+  for (const std::string &name : current)
+    addToGlobalRegistry_(name);
+  for (auto it = global_registry_.begin(); it != global_registry_.end();) {
+    const std::string name = *it++;
+    if (!current.count(name))
+      eraseFromGlobalRegistry_(name);
+  }
+}
+
+bool AccessRegistry::useProcessTable(const std::filesystem::path &table_path,
+                                     uint64_t capabilities) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  try {
+    auto table = std::make_unique<ProcessTable>(table_path);
+    if (!table->claim(proc_name_, capabilities))
+      return false;
+    table_ = std::move(table);
+  } catch (const std::runtime_error &e) {
+    std::cout << "[ERROR]: " << e.what() << "\n";
+    return false;
+  }
+  // membership now comes from the table alone
+  unwatch_();
+  rescan_();
+  publish_();
+  return true;
+}
+
+void AccessRegistry::refresh() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (table_) {
+    table_->beat();
+    if (table_->generation() != table_generation_)
+      rescan_();
+  } else {
+    beat_();
+    if (inotify_fd_ >= 0) {
+      if (!drainEvents_())
+        rescan_(); // events were lost, or the watch went away
+    } else {
+      std::error_code ec;
+      const auto mtime = std::filesystem::last_write_time(ac_path_, ec);
+      if (ec || !listed_settled_ || mtime != listed_mtime_)
+        rescan_();
+    }
+  }
+  publish_();
+}
+
+bool AccessRegistry::resolve(const std::string &proc_name) {
+  if (checkGlobalRegistry(proc_name))
+    return true;
+  const auto now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = misses_.find(proc_name);
+    if (it != misses_.end() && now - it->second < kNegativeTtl)
+      return false;
+  }
+  refresh();
+  if (checkGlobalRegistry(proc_name))
+    return true;
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (misses_.size() >= kMaxCachedMisses)
+    misses_.clear();
+  misses_[proc_name] = now;
+  return false;
+}
+
+void AccessRegistry::watch_() {
+#if defined(__linux__)
+  inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0 ||
+      ::inotify_add_watch(inotify_fd_, ac_path_.c_str(),
+                          IN_CREATE | IN_DELETE | IN_MOVED_TO |
+                              IN_MOVED_FROM | IN_DELETE_SELF |
+                              IN_MOVE_SELF) < 0) {
+    std::cout << "[WARN]: Unable to watch " << ac_path_ << " ("
+              << std::strerror(errno) << "), polling its mtime instead\n";
+    unwatch_();
+    return;
+  }
+  event_buf_.resize(16 * 1024);
+#endif
+}
+
+void AccessRegistry::unwatch_() {
+#if defined(__linux__)
+  if (inotify_fd_ >= 0)
+    ::close(inotify_fd_);
+#endif
+  inotify_fd_ = -1;
+}
+
+// Applies every queued event. Returns false if the caller must relist:
+// the queue overflowed or the watched directory itself went away.
+bool AccessRegistry::drainEvents_() {
+#if defined(__linux__)
+  bool complete = true;
+  for (;;) {
+    const ssize_t n =
+        ::read(inotify_fd_, event_buf_.data(), event_buf_.size());
+    if (n <= 0)
+      break; // EAGAIN once the queue is empty
+    for (ssize_t off = 0; off < n;) {
+      const auto *event =
+          reinterpret_cast<const inotify_event *>(event_buf_.data() + off);
+      off += sizeof(inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        complete = false;
+        continue;
+      }
+      if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+        unwatch_();
+        return false;
+      }
+      if (event->len == 0)
+        continue;
+      const std::string_view name = registryName(event->name);
+      if (name.empty() || name == proc_name_)
+        continue;
+      if (event->mask & (IN_CREATE | IN_MOVED_TO))
+        addToGlobalRegistry_(std::string(name));
+      else
+        eraseFromGlobalRegistry_(std::string(name));
+    }
   }
+  return complete;
+#else
+  return false;
+#endif
+}
+
+// The access file's mtime is this process' heartbeat.
+void AccessRegistry::beat_() {
+  const auto now = std::chrono::steady_clock::now();
+  if (now - last_beat_ < ProcessTable::kHeartbeatInterval)
+    return;
+  last_beat_ = now;
+  std::error_code ec;
+  std::filesystem::last_write_time(
+      ac_path_ / (proc_name_ + ".oregistry"),
+      std::filesystem::file_time_type::clock::now(), ec);
 }
-const std::unordered_set<std::string>
-AccessRegistry::getGlobalRegistry() const {
-  return global_registry_;
+
+std::vector<std::string> AccessRegistry::evictDeadPeers() {
+  std::vector<std::string> dead;
+  std::lock_guard<std::mutex> lock(mtx_);
+  const auto now = std::chrono::steady_clock::now();
+  if (now - last_liveness_ < kLivenessInterval)
+    return dead;
+  last_liveness_ = now;
+
+  std::vector<std::string> probed;
+  for (const std::string &name : global_registry_) {
+    bool by_pid = false;
+    if (isAlive_(name, by_pid))
+      continue;
+    dead.push_back(name);
+    if (by_pid)
+      probed.push_back(name);
+  }
+  // only a peer whose pid was seen gone is unpublished for every other
+  // process as well
+  for (const std::string &name : probed) {
+    if (table_) {
+      if (auto info = table_->find(name))
+        table_->evict(*info);
+    } else {
+      std::error_code ec;
+      std::filesystem::remove(ac_path_ / (name + ".oregistry"), ec);
+    }
+  }
+  for (const std::string &name : dead) {
+    std::cout << "[WARN]: Process " << name << " is dead, evicting it\n";
+    eraseFromGlobalRegistry_(name);
+  }
+  publish_();
+  return dead;
 }
-const std::unordered_set<std::string> AccessRegistry::getAccessList() const {
-  return allowedProcesses_;
+
+// A peer whose pid lives in this process' pid space is alive exactly while
+// that pid is, and `probed` is set; otherwise (no pid, or one from another
+// host or pid namespace) it is judged by its heartbeat.
+bool AccessRegistry::isAlive_(const std::string &proc_name, bool &probed) {
+  using std::chrono::milliseconds;
+  uint64_t pid = 0;
+  bool local = false;
+  milliseconds heartbeat_age{0};
+  if (table_) {
+    const auto info = table_->find(proc_name);
+    if (!info)
+      return true; // already gone; the next rescan drops it
+    pid = info->pid;
+    local = info->local;
+    heartbeat_age = milliseconds(static_cast<long long>(
+        Utils::getEpochMillis() - info->heartbeat_ms));
+  } else {
+    const std::filesystem::path file = ac_path_ / (proc_name + ".oregistry");
+    std::error_code ec;
+    const auto mtime = std::filesystem::last_write_time(file, ec);
+    if (ec)
+      return true; // already gone; the delete event drops it
+    std::ifstream in(file);
+    std::string name;
+    std::getline(in, name);
+    std::string space;
+    in >> pid >> space;
+    local = Utils::isLocalPidSpace(space);
+    heartbeat_age = std::chrono::duration_cast<milliseconds>(
+        std::filesystem::file_time_type::clock::now() - mtime);
+  }
+  probed = pid != 0 && local;
+  if (probed)
+    return Utils::isProcessAlive(pid);
+  return heartbeat_age <= kPeerTimeout;
 }
-const std::unordered_set<std::string> AccessRegistry::getConnectedList() const {
-  return connected_list_;
+
+void AccessRegistry::addToGlobalRegistry_(const std::string &proc_name) {
+  misses_.erase(proc_name);
+  if (global_registry_.insert(proc_name).second) {
+    ++generation_;
+    std::cout << "[INFO] Added to registry: " << proc_name << "\n";
+  }
+}
+
+void AccessRegistry::eraseFromGlobalRegistry_(const std::string &proc_name) {
+  if (global_registry_.erase(proc_name)) {
+    ++generation_;
+    std::cout << "[INFO] Removed from registry: " << proc_name << "\n";
+  }
+}
+
+// Copies the working lists into a new snapshot if anything changed since
+// the last one. Callers hold mtx_.
+void AccessRegistry::publish_() {
+  if (published_.load(std::memory_order_relaxed) == generation_)
+    return;
+  auto next = std::make_shared<AclSnapshot>();
+  next->global_registry = global_registry_;
+  next->access_list = allowedProcesses_;
+  next->connected_list = connected_list_;
+  next->generation = generation_;
+  snapshot_.store(std::move(next));
+  published_.store(generation_, std::memory_order_release);
+}
+
+// The snapshot this thread last loaded from this registry, reloaded once a
+// newer one has been published. One entry per thread: a thread that
+// alternates between registries reloads on every switch, which is slower
+// but still correct. The reference stays valid until the thread's next
+// call.
+const std::shared_ptr<const AclSnapshot> &AccessRegistry::current_() const {
+  struct Cached {
+    uint64_t registry = 0;
+    std::shared_ptr<const AclSnapshot> snap;
+  };
+  thread_local Cached cached;
+  if (cached.registry != id_ || !cached.snap ||
+      cached.snap->generation != published_.load(std::memory_order_acquire)) {
+    cached.snap = snapshot_.load();
+    cached.registry = id_;
+  }
+  return cached.snap;
+}
+
+std::shared_ptr<const AclSnapshot> AccessRegistry::snapshot() const {
+  return current_();
+}
+
+// The aliasing constructor keeps the whole snapshot alive behind each view.
+AccessRegistry::ListView AccessRegistry::getGlobalRegistry() const {
+  const auto &snap = current_();
+  return ListView(snap, &snap->global_registry);
+}
+AccessRegistry::ListView AccessRegistry::getAccessList() const {
+  const auto &snap = current_();
+  return ListView(snap, &snap->access_list);
+}
+AccessRegistry::ListView AccessRegistry::getConnectedList() const {
+  const auto &snap = current_();
+  return ListView(snap, &snap->connected_list);
 }
 void AccessRegistry::printRegistry() const {
   std::cout << "=== Global Registry ===\n";
@@ -63,43 +396,62 @@ void AccessRegistry::putAccessFile() {
   const std::filesystem::path after_path =
       ac_path_ / (proc_name_ + ".oregistry");
   std::ofstream outstream(before_path);
-  outstream << proc_name_ << "\n";
+  outstream << proc_name_ << "\n"
+            << Utils::getProcessID() << "\n"
+            << Utils::pidSpace() << "\n";
   outstream.close();
   std::rename(before_path.c_str(), after_path.c_str());
 }
 bool AccessRegistry::checkGlobalRegistry(const std::string &proc_name) const {
-  return global_registry_.find(proc_name) != global_registry_.end();
+  return current_()->global_registry.count(proc_name) != 0;
 }
 
 bool AccessRegistry::checkAccess(const std::string &proc_name) const {
-  return allowedProcesses_.find(proc_name) != allowedProcesses_.end();
+  return current_()->access_list.count(proc_name) != 0;
 }
 
 void AccessRegistry::addProcessToList(const std::string &proc_name) {
-  // std::cout << "Inside addProcessToList\n";
   std::lock_guard<std::mutex> lock(mtx_);
 
-  if (checkAccess(proc_name)) {
+  if (allowedProcesses_.count(proc_name)) {
     std::cout << "[ERROR]: Process Already Exists in Access Registry\n";
     return;
   }
   // Safe add
   allowedProcesses_.insert(proc_name);
-  connect_to(proc_name);
+  ++generation_;
+  connect_(proc_name);
+  publish_();
 }
 bool AccessRegistry::connect_to(const std::string &proc_name) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  const bool connected = connect_(proc_name);
+  publish_();
+  return connected;
+}
+bool AccessRegistry::connect_(const std::string &proc_name) {
   if (connected_list_.find(proc_name) != connected_list_.end()) {
     return false;
   }
   connected_list_.insert(proc_name);
+  ++generation_;
   return true;
 }
 void AccessRegistry::syncAccessRegistry() {
-  for (const auto &entry : global_registry_) {
-    if (!checkAccess(entry)) {
-      allowedProcesses_.erase(entry);
+  std::lock_guard<std::mutex> lock(mtx_);
+  bool changed = false;
+  for (auto it = allowedProcesses_.begin(); it != allowedProcesses_.end();) {
+    if (global_registry_.count(*it)) {
+      ++it;
+    } else {
+      it = allowedProcesses_.erase(it);
+      changed = true;
     }
   }
+  if (!changed)
+    return;
+  ++generation_;
+  publish_();
 }
 bool AccessRegistry::removeProcessFromGlobalRegistry(
     const std::string &proc_name) {
@@ -107,6 +459,8 @@ bool AccessRegistry::removeProcessFromGlobalRegistry(
   auto it = global_registry_.find(proc_name);
   if (it != global_registry_.end()) {
     global_registry_.erase(it);
+    ++generation_;
+    publish_();
     std::cout << "[INFO]: Process removed from Global Registry\n";
     return true;
   }
@@ -119,6 +473,8 @@ bool AccessRegistry::removeProcessFromAccessList(const std::string &proc_name) {
   auto it = allowedProcesses_.find(proc_name);
   if (it != allowedProcesses_.end()) {
     allowedProcesses_.erase(it);
+    ++generation_;
+    publish_();
     std::cout << "[INFO]: Process removed from Allowed Registry\n";
     return true;
   }
@@ -127,9 +483,12 @@ bool AccessRegistry::removeProcessFromAccessList(const std::string &proc_name) {
 }
 bool AccessRegistry::removeProcessFromConnectedList(
     const std::string &proc_name) {
+  std::lock_guard<std::mutex> lock(mtx_);
   auto it = connected_list_.find(proc_name);
   if (it != connected_list_.end()) {
     connected_list_.erase(it);
+    ++generation_;
+    publish_();
     std::cout << "[INFO]: Process removed from Connected List\n";
     return true;
   }
@@ -140,6 +499,8 @@ void AccessRegistry::removeAccessFile() {
   std::lock_guard<std::mutex> lock(mtx_);
   const std::filesystem::path ac_removal_path_ =
       ac_path_ / (proc_name_ + ".oregistry");
+  if (table_)
+    table_->release();
   if (!Utils::fileExists(ac_removal_path_)) {
     std::cout
         << "[ERROR]: Unable to remove the access file, file doesnt exist\n";
@@ -147,15 +508,13 @@ void AccessRegistry::removeAccessFile() {
   std::filesystem::remove(ac_removal_path_);
 }
 bool AccessRegistry::check_connection(const std::string &proc_name) const {
-  std::lock_guard<std::mutex> lock(mtx_);
-  if (connected_list_.find(proc_name) == connected_list_.end())
-    return false;
-
-  return true;
+  return current_()->connected_list.count(proc_name) != 0;
 }
 void AccessRegistry::try_connect_all() {
+  std::lock_guard<std::mutex> lock(mtx_);
   for (const std::string &proc_name : allowedProcesses_) {
-    connect_to(proc_name);
+    connect_(proc_name);
   }
+  publish_();
 }
 } // namespace SPEED
@@ -1,5 +1,14 @@
 #include "../include/BinaryManager.hpp"
+#include <charconv>
 #include <fstream>
+#include <iostream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 namespace SPEED {
 
@@ -7,33 +16,172 @@ bool BinaryManager::writeBinary(const Message &msg,
                                 const std::filesystem::path &path,
                                 std::atomic<long long> &seq_number,
                                 const std::string &proc_name) {
-  const long long seq = seq_number.load();
+  return writeBinary(msg, path, proc_name, seq_number.load(), proc_name);
+}
+
+bool BinaryManager::writeBinary(const Message &msg,
+                                const std::filesystem::path &path,
+                                const std::string &sender, long long seq,
+                                const std::string &reciever,
+                                uint64_t *rename_ns) {
+  char timestamp[Utils::kTimestampChars + 1];
+  char uuid[Utils::kUUIDChars + 1];
+  Utils::formatTimestamp(timestamp);
+  Utils::formatUUID(uuid);
+  const Priority lane = msg.header.priority;
+
+#if defined(__unix__) || defined(__APPLE__)
+  // Per-thread path buffers keep their capacity between frames, so the
+  // steady-state unicast path performs no heap allocation.
+  thread_local std::string before_path;
+  thread_local std::string after_path;
+  before_path.assign(path.native());
+  before_path += '/';
+  before_path += reciever;
+  before_path += '/';
+  before_path += sender;
+  const size_t shard_len = before_path.size();
+  before_path += '/';
+  after_path = before_path;
+  appendFilename_(before_path, timestamp, sender, lane, seq, uuid, ".ispeed");
+  appendFilename_(after_path, timestamp, sender, lane, seq, uuid, ".ospeed");
+
+  if (!writeFrameFd_(msg, before_path.c_str())) {
+    // first frame to this reciever: create our shard in its inbox, but never
+    // the inbox itself
+    if (errno != ENOENT)
+      return false;
+    before_path[shard_len] = '\0';
+    const bool made =
+        ::mkdir(before_path.c_str(), 0777) == 0 || errno == EEXIST;
+    before_path[shard_len] = '/';
+    if (!made || !writeFrameFd_(msg, before_path.c_str()))
+      return false;
+  }
+  if (rename_ns)
+    *rename_ns = Utils::getEpochNanos();
+  if (std::rename(before_path.c_str(), after_path.c_str()) != 0) {
+    ::unlink(before_path.c_str());
+    return false;
+  }
+#else
+  std::string before_name, after_name;
+  appendFilename_(before_name, timestamp, sender, lane, seq, uuid, ".ispeed");
+  appendFilename_(after_name, timestamp, sender, lane, seq, uuid, ".ospeed");
+  const std::filesystem::path shard = shardPath(path, reciever, sender);
+  std::error_code ec;
+  std::filesystem::create_directory(shard, ec);
+  const std::filesystem::path before_path = shard / before_name;
+  const std::filesystem::path after_path = shard / after_name;
+
+  if (!writeFrame_(msg, before_path))
+    return false;
+  if (rename_ns)
+    *rename_ns = Utils::getEpochNanos();
+  std::filesystem::rename(before_path, after_path, ec);
+  if (ec) {
+    std::filesystem::remove(before_path, ec);
+    return false;
+  }
+#endif
+  return true;
+}
+
+size_t BinaryManager::writeShared(
+    const Message &msg, const std::filesystem::path &path,
+    const std::string &sender,
+    const std::vector<std::pair<std::string, long long>> &targets,
+    std::vector<bool> *published_to) {
+  if (published_to)
+    published_to->assign(targets.size(), false);
+  if (targets.empty())
+    return 0;
+
   const std::string uuid = Utils::generateUUID();
   const std::string timestamp = Utils::getCurrentTimestamp();
-  std::filesystem::path before_path =
-      path / proc_name /
-      (timestamp + "_" + proc_name + "_" + std::to_string(seq_number) + "_" +
-       uuid + ".ispeed");
-  std::filesystem::path after_path =
-      path / proc_name /
-      (timestamp + "_" + proc_name + "_" + std::to_string(seq_number) + "_" +
-       uuid + ".ospeed");
-
-  std::ofstream out(before_path, std::ios::binary);
-  if (!out)
+  const Priority lane = msg.header.priority;
+
+  // Stage under the speed dir itself so the links stay on one filesystem.
+  std::error_code ec;
+  const std::filesystem::path outbox = path / ".outbox";
+  std::filesystem::create_directories(outbox, ec);
+  const std::filesystem::path staged = outbox / (uuid + ".ispeed");
+  if (!writeFrame_(msg, staged))
+    return 0;
+
+  size_t published = 0;
+  std::string name;
+  for (size_t i = 0; i < targets.size(); ++i) {
+    const auto &[reciever, seq] = targets[i];
+    const std::filesystem::path inbox = shardPath(path, reciever, sender);
+    name.clear();
+    appendFilename_(name, timestamp, sender, lane, seq, uuid, ".ospeed");
+    const std::filesystem::path after_path = inbox / name;
+
+    // A hardlink appears atomically under its final name, so no
+    // .ispeed -> .ospeed rename is needed on this path.
+    std::filesystem::create_hard_link(staged, after_path, ec);
+    if (ec == std::errc::no_such_file_or_directory &&
+        std::filesystem::create_directory(inbox, ec))
+      std::filesystem::create_hard_link(staged, after_path, ec);
+    if (!ec) {
+      ++published;
+      if (published_to)
+        (*published_to)[i] = true;
+      continue;
+    }
+
+    // Cross-device or no link support: fall back to a private copy.
+    name.clear();
+    appendFilename_(name, timestamp, sender, lane, seq, uuid, ".ispeed");
+    const std::filesystem::path before_path = inbox / name;
+    std::filesystem::copy_file(
+        staged, before_path, std::filesystem::copy_options::overwrite_existing,
+        ec);
+    if (ec) {
+      std::cerr << "[ERROR]: Unable to publish to " << reciever << ": "
+                << ec.message() << "\n";
+      continue;
+    }
+    std::filesystem::rename(before_path, after_path, ec);
+    if (ec) {
+      std::cerr << "[ERROR]: Unable to publish to " << reciever << ": "
+                << ec.message() << "\n";
+      std::filesystem::remove(before_path, ec);
+      continue;
+    }
+    ++published;
+    if (published_to)
+      (*published_to)[i] = true;
+  }
+
+  std::filesystem::remove(staged, ec);
+  return published;
+}
+
+bool BinaryManager::writeAtomic(const Message &msg,
+                                const std::filesystem::path &tmp,
+                                const std::filesystem::path &final) {
+  if (!writeFrame_(msg, tmp))
+    return false;
+  std::error_code ec;
+  std::filesystem::rename(tmp, final, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
     return false;
+  }
+  return true;
+}
 
-  // Write header fields
-  write_uint(out, msg.header.version);
-  write_uint(out, static_cast<uint8_t>(msg.header.type));
-  write_uint(out, msg.header.sender_pid);
-  write_uint(out, msg.header.timestamp);
-  write_uint(out, msg.header.seq_num);
-  write_string(out, msg.header.sender);
-  write_string(out, msg.header.reciever);
+bool BinaryManager::writeFrame_(const Message &msg,
+                                const std::filesystem::path &path) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out)
+    return false;
 
-  out.write(reinterpret_cast<const char *>(msg.header.nonce.data()),
-            msg.header.nonce.size());
+  uint8_t header[kHeaderWireSize];
+  Message::encode_header(msg.header, header);
+  out.write(reinterpret_cast<const char *>(header), kHeaderWireSize);
 
   // Write payload
   write_uint(out, static_cast<uint32_t>(msg.payload.size()));
@@ -41,8 +189,65 @@ bool BinaryManager::writeBinary(const Message &msg,
             msg.payload.size());
 
   out.close();
-  std::rename(before_path.c_str(), after_path.c_str());
-  return true;
+  return static_cast<bool>(out);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// Same frame as writeFrame_(), written with a single writev() and no stream
+// buffer.
+bool BinaryManager::writeFrameFd_(const Message &msg, const char *path) {
+  const int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd < 0)
+    return false;
+
+  uint8_t header[kHeaderWireSize];
+  Message::encode_header(msg.header, header);
+  uint32_t len = swap_big_endian(static_cast<uint32_t>(msg.payload.size()));
+
+  iovec iov[3];
+  iov[0].iov_base = header;
+  iov[0].iov_len = kHeaderWireSize;
+  iov[1].iov_base = &len;
+  iov[1].iov_len = sizeof(len);
+  iov[2].iov_base = const_cast<uint8_t *>(msg.payload.data());
+  iov[2].iov_len = msg.payload.size();
+  const ssize_t total =
+      static_cast<ssize_t>(kHeaderWireSize + sizeof(len) + msg.payload.size());
+
+  const bool ok = ::writev(fd, iov, 3) == total;
+  return ::close(fd) == 0 && ok;
+}
+#endif
+
+// Each sender writes into its own shard of the reciever's inbox, so the
+// reciever only lists shards that changed.
+std::filesystem::path
+BinaryManager::shardPath(const std::filesystem::path &path,
+                         const std::string &reciever,
+                         const std::string &sender) {
+  return path / reciever / sender;
+}
+
+// "<timestamp>_<sender>_<lane>_<seq>_<uuid><ext>", as parsed by the watcher.
+// The lane is in the name so the watcher can order frames without reading
+// them.
+void BinaryManager::appendFilename_(std::string &out,
+                                    std::string_view timestamp,
+                                    std::string_view sender, Priority lane,
+                                    long long seq, std::string_view uuid,
+                                    const char *ext) {
+  char digits[24];
+  out += timestamp;
+  out += '_';
+  out += sender;
+  out += '_';
+  out += static_cast<char>('0' + static_cast<int>(lane));
+  out += '_';
+  const auto res = std::to_chars(digits, digits + sizeof(digits), seq);
+  out.append(digits, res.ptr);
+  out += '_';
+  out += uuid;
+  out += ext;
 }
 
 Message BinaryManager::readBinary(const std::filesystem::path &path) {
@@ -52,25 +257,80 @@ Message BinaryManager::readBinary(const std::filesystem::path &path) {
 
   Message msg;
 
-  // Read header fields
-  msg.header.version = read_uint<uint8_t>(in);
-  msg.header.type = static_cast<MessageType>(read_uint<uint8_t>(in));
-  msg.header.sender_pid = read_uint<uint32_t>(in);
-  msg.header.timestamp = read_uint<uint64_t>(in);
-  msg.header.seq_num = read_uint<uint64_t>(in);
-  msg.header.sender = read_string(in);
-  msg.header.reciever = read_string(in);
-
-  // Read nonce (24 bytes)
-  in.read(reinterpret_cast<char *>(msg.header.nonce.data()),
-          msg.header.nonce.size());
+  uint8_t header[kHeaderWireSize];
+  in.read(reinterpret_cast<char *>(header), kHeaderWireSize);
+  if (in.gcount() != static_cast<std::streamsize>(kHeaderWireSize) ||
+      !Message::decode_header(header, msg.header))
+    throw std::runtime_error("Malformed frame header");
 
   // Read payload
   uint32_t len = read_uint<uint32_t>(in);
+  if (len > kMaxFramePayload)
+    throw std::runtime_error("Oversized frame payload");
   msg.payload.resize(len);
   in.read(reinterpret_cast<char *>(msg.payload.data()), len);
 
   return msg;
 }
 
+// Same frame as readBinary(), read into a pooled Message sized from the
+// frame's length field.
+MessagePool::Lease BinaryManager::readBinary(const std::filesystem::path &path,
+                                             MessagePool &pool) {
+  uint8_t prefix[kHeaderWireSize + sizeof(uint32_t)];
+#if defined(__unix__) || defined(__APPLE__)
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::runtime_error("Failed to open file");
+  auto read_fully = [fd](void *buf, size_t len) {
+    auto *p = static_cast<uint8_t *>(buf);
+    while (len > 0) {
+      const ssize_t n = ::read(fd, p, len);
+      if (n <= 0)
+        return false;
+      p += n;
+      len -= static_cast<size_t>(n);
+    }
+    return true;
+  };
+#else
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw std::runtime_error("Failed to open file");
+  auto read_fully = [&in](void *buf, size_t len) {
+    in.read(static_cast<char *>(buf), static_cast<std::streamsize>(len));
+    return in.gcount() == static_cast<std::streamsize>(len);
+  };
+#endif
+
+  MessageHeader header;
+  if (!read_fully(prefix, sizeof(prefix)) ||
+      !Message::decode_header(
+          reinterpret_cast<const uint8_t(&)[kHeaderWireSize]>(prefix),
+          header)) {
+#if defined(__unix__) || defined(__APPLE__)
+    ::close(fd);
+#endif
+    throw std::runtime_error("Malformed frame header");
+  }
+  const uint32_t len = from_big_endian<uint32_t>(prefix + kHeaderWireSize);
+  if (len > kMaxFramePayload) {
+#if defined(__unix__) || defined(__APPLE__)
+    ::close(fd);
+#endif
+    throw std::runtime_error("Oversized frame payload");
+  }
+
+  MessagePool::Lease msg = pool.acquire(len);
+  msg->header = header;
+  msg->payload.resize(len);
+  const bool ok = read_fully(msg->payload.data(), len);
+#if defined(__unix__) || defined(__APPLE__)
+  ::close(fd);
+#endif
+  if (!ok)
+    throw std::runtime_error("Truncated frame payload");
+  return msg;
+}
+
 } // namespace SPEED
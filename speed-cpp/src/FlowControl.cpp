@@ -0,0 +1,113 @@
+#include "../include/FlowControl.hpp"
+#include <algorithm>
+#include <fstream>
+
+namespace SPEED {
+
+bool CreditLedger::isKnown(PeerId peer) const {
+  const PeerCredit *pc = peers_.find(peer);
+  return pc != nullptr && pc->known;
+}
+
+void CreditLedger::setLimits(PeerId peer, uint64_t max_messages,
+                             uint64_t max_bytes) {
+  PeerCredit &pc = peers_[peer];
+  pc.known = true;
+  pc.max_messages = max_messages;
+  pc.max_bytes = max_bytes;
+}
+
+bool CreditLedger::canSend(PeerId peer, uint64_t bytes) const {
+  const PeerCredit *found = peers_.find(peer);
+  if (found == nullptr)
+    return true;
+  const PeerCredit &pc = *found;
+  const uint64_t msgs_in_flight = pc.sent_messages - pc.consumed_messages;
+  const uint64_t bytes_in_flight = pc.sent_bytes - pc.consumed_bytes;
+  if (pc.max_messages != 0 && msgs_in_flight >= pc.max_messages)
+    return false;
+  // a single frame larger than the whole byte budget may still go out once
+  // the inbox is empty, otherwise it could never be sent at all
+  if (pc.max_bytes != 0 && bytes_in_flight != 0 &&
+      bytes_in_flight + bytes > pc.max_bytes)
+    return false;
+  return true;
+}
+
+void CreditLedger::onSent(PeerId peer, uint64_t bytes) {
+  PeerCredit &pc = peers_[peer];
+  ++pc.sent_messages;
+  pc.sent_bytes += bytes;
+}
+
+void CreditLedger::onCredit(PeerId peer, uint64_t consumed_messages,
+                            uint64_t consumed_bytes, uint64_t max_messages,
+                            uint64_t max_bytes) {
+  PeerCredit &pc = peers_[peer];
+  pc.known = true;
+  // totals only move forward; never let them pass what we actually sent
+  pc.consumed_messages = std::min(
+      std::max(pc.consumed_messages, consumed_messages), pc.sent_messages);
+  pc.consumed_bytes =
+      std::min(std::max(pc.consumed_bytes, consumed_bytes), pc.sent_bytes);
+  pc.max_messages = max_messages;
+  pc.max_bytes = max_bytes;
+}
+
+void CreditLedger::restart(PeerId peer) {
+  PeerCredit &pc = peers_[peer];
+  pc.sent_messages = 0;
+  pc.sent_bytes = 0;
+  pc.consumed_messages = 0;
+  pc.consumed_bytes = 0;
+}
+
+std::deque<Message> &CreditLedger::backlog(PeerId peer) {
+  return peers_[peer].backlog;
+}
+
+CreditState CreditLedger::state(PeerId peer) const {
+  CreditState st;
+  const PeerCredit *found = peers_.find(peer);
+  if (found == nullptr)
+    return st;
+  const PeerCredit &pc = *found;
+  st.max_messages = pc.max_messages;
+  st.max_bytes = pc.max_bytes;
+  st.in_flight_messages = pc.sent_messages - pc.consumed_messages;
+  st.in_flight_bytes = pc.sent_bytes - pc.consumed_bytes;
+  st.buffered_messages = pc.backlog.size();
+  return st;
+}
+
+bool CreditLedger::writeAdvertisement(const std::filesystem::path &path,
+                                      uint64_t max_messages,
+                                      uint64_t max_bytes) {
+  std::filesystem::path tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream out(tmp);
+    if (!out)
+      return false;
+    out << max_messages << " " << max_bytes << "\n";
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  return !ec;
+}
+
+bool CreditLedger::readAdvertisement(const std::filesystem::path &path,
+                                     uint64_t &max_messages,
+                                     uint64_t &max_bytes) {
+  std::ifstream in(path);
+  if (!in)
+    return false;
+  uint64_t msgs = 0, bytes = 0;
+  if (!(in >> msgs >> bytes))
+    return false;
+  max_messages = msgs;
+  max_bytes = bytes;
+  return true;
+}
+
+} // namespace SPEED
@@ -0,0 +1,169 @@
+#include "../include/IdentityStore.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace SPEED {
+
+namespace {
+constexpr char kIdentityMagic[8] = {'S', 'P', 'E', 'E', 'D', 'I', 'D', '1'};
+constexpr size_t kKeyBytes = crypto_kx_PUBLICKEYBYTES;
+static_assert(crypto_kx_SECRETKEYBYTES == kKeyBytes);
+} // namespace
+
+// Layout: magic, public key, secret key, then one record per pinned peer:
+// a name length byte, the name and its public key.
+IdentityStore::IdentityStore(const std::filesystem::path &path) : path_(path) {
+  std::error_code ec;
+  if (std::filesystem::exists(path_, ec)) {
+    load_();
+    return;
+  }
+  kx_ = EncryptionManager::generateKeyPair();
+  std::lock_guard<std::mutex> lock(mtx_);
+  save_();
+}
+
+IdentityStore::~IdentityStore() {
+  sodium_memzero(kx_.secret_key.data(), kx_.secret_key.size());
+}
+
+void IdentityStore::load_() {
+  std::ifstream in(path_, std::ios::binary);
+  std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)),
+                                  std::istreambuf_iterator<char>());
+  if (!in.good() && !in.eof())
+    throw std::runtime_error("Unable to read identity " + path_.string());
+  const size_t keys_end = sizeof(kIdentityMagic) + 2 * kKeyBytes;
+  if (data.size() < keys_end ||
+      std::memcmp(data.data(), kIdentityMagic, sizeof(kIdentityMagic)) != 0) {
+    sodium_memzero(data.data(), data.size());
+    throw std::runtime_error("Identity has an incompatible layout");
+  }
+  const unsigned char *at = data.data() + sizeof(kIdentityMagic);
+  std::memcpy(kx_.public_key.data(), at, kKeyBytes);
+  std::memcpy(kx_.secret_key.data(), at + kKeyBytes, kKeyBytes);
+  sodium_memzero(data.data(), keys_end);
+
+  size_t pos = keys_end;
+  while (pos < data.size()) {
+    const size_t len = data[pos];
+    if (len == 0 || len > kMaxNameLength ||
+        pos + 1 + len + kKeyBytes > data.size()) {
+      sodium_memzero(kx_.secret_key.data(), kx_.secret_key.size());
+      throw std::runtime_error("Identity has a truncated peer record");
+    }
+    std::string name(reinterpret_cast<const char *>(&data[pos + 1]), len);
+    EncryptionManager::PublicKey &key = pinned_[std::move(name)];
+    std::memcpy(key.data(), &data[pos + 1 + len], kKeyBytes);
+    pos += 1 + len + kKeyBytes;
+  }
+}
+
+// Written to a temporary file and renamed over the old one, so a crash
+// leaves either the old identity or the new one.
+void IdentityStore::save_() const {
+#if defined(__unix__) || defined(__APPLE__)
+  std::vector<unsigned char> data(kIdentityMagic,
+                                  kIdentityMagic + sizeof(kIdentityMagic));
+  data.insert(data.end(), kx_.public_key.begin(), kx_.public_key.end());
+  data.insert(data.end(), kx_.secret_key.begin(), kx_.secret_key.end());
+  for (const auto &[name, key] : pinned_) {
+    data.push_back(static_cast<unsigned char>(name.size()));
+    data.insert(data.end(), name.begin(), name.end());
+    data.insert(data.end(), key.begin(), key.end());
+  }
+  const std::filesystem::path tmp = path_.string() + ".tmp";
+  const int fd =
+      ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  bool ok = fd >= 0;
+  int err = errno;
+  for (size_t done = 0; ok && done < data.size();) {
+    const ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    ok = n > 0;
+    err = errno;
+    done += ok ? static_cast<size_t>(n) : 0;
+  }
+  sodium_memzero(data.data(), data.size());
+  if (ok && ::fsync(fd) != 0) {
+    ok = false;
+    err = errno;
+  }
+  if (fd >= 0)
+    ::close(fd);
+  if (ok && ::rename(tmp.c_str(), path_.c_str()) != 0) {
+    ok = false;
+    err = errno;
+  }
+  if (!ok) {
+    ::unlink(tmp.c_str());
+    throw std::runtime_error("Unable to save identity: " +
+                             std::string(std::strerror(err)));
+  }
+#else
+  throw std::runtime_error("Identity needs a POSIX file system");
+#endif
+}
+
+bool IdentityStore::pinned(std::string_view peer,
+                           EncryptionManager::PublicKey &out) const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  const auto it = pinned_.find(peer);
+  if (it == pinned_.end())
+    return false;
+  out = it->second;
+  return true;
+}
+
+bool IdentityStore::pin(std::string_view peer,
+                        const EncryptionManager::PublicKey &key) {
+  if (peer.empty() || peer.size() > kMaxNameLength)
+    return false;
+  std::lock_guard<std::mutex> lock(mtx_);
+  pinned_[std::string(peer)] = key;
+  try {
+    save_();
+  } catch (const std::runtime_error &e) {
+    std::cout << "[WARN]: " << e.what() << ", the key of " << peer
+              << " stays pinned until exit\n";
+    return false;
+  }
+  return true;
+}
+
+bool IdentityStore::unpin(std::string_view peer) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  const auto it = pinned_.find(peer);
+  if (it == pinned_.end())
+    return false;
+  pinned_.erase(it);
+  try {
+    save_();
+  } catch (const std::runtime_error &e) {
+    std::cout << "[WARN]: " << e.what() << ", " << peer
+              << " is pinned again after a restart\n";
+    return false;
+  }
+  return true;
+}
+
+void IdentityStore::forEach(
+    const std::function<void(std::string_view,
+                             const EncryptionManager::PublicKey &)> &visit)
+    const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (const auto &[name, key] : pinned_)
+    visit(name, key);
+}
+
+} // namespace SPEED
@@ -0,0 +1,307 @@
+#include "../include/InboxScanner.hpp"
+#include "../include/BinaryMessage.hpp"
+#include "../include/Utils.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#if defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace SPEED {
+
+namespace {
+constexpr std::string_view kFrameExt = ".ospeed";
+
+enum CharClass : uint8_t {
+  kDigit = 1,
+  kAlpha = 2,
+  kDash = 4,
+  kUnderscore = 8,
+};
+
+constexpr std::array<uint8_t, 256> makeCharClasses() {
+  std::array<uint8_t, 256> table{};
+  for (int c = '0'; c <= '9'; ++c)
+    table[c] = kDigit;
+  for (int c = 'a'; c <= 'z'; ++c)
+    table[c] = kAlpha;
+  for (int c = 'A'; c <= 'Z'; ++c)
+    table[c] = kAlpha;
+  table['-'] = kDash;
+  table['_'] = kUnderscore;
+  return table;
+}
+constexpr std::array<uint8_t, 256> kCharClasses = makeCharClasses();
+
+// True if every byte of `s` falls in `allowed`. Branch-free per byte so the
+// compiler can vectorize it.
+bool allOf(std::string_view s, uint8_t allowed) {
+  uint8_t bad = 0;
+  for (char c : s)
+    bad |= static_cast<uint8_t>(
+        (kCharClasses[static_cast<unsigned char>(c)] & allowed) == 0);
+  return bad == 0;
+}
+} // namespace
+
+std::optional<FrameName> parseFrameName(std::string_view name) {
+  if (name.size() <= kFrameExt.size() ||
+      name.substr(name.size() - kFrameExt.size()) != kFrameExt)
+    return std::nullopt;
+  std::string_view rest = name.substr(0, name.size() - kFrameExt.size());
+
+  // <uuid>
+  size_t cut = rest.rfind('_');
+  if (cut == std::string_view::npos || cut + 1 == rest.size() ||
+      !allOf(rest.substr(cut + 1), kDigit | kAlpha | kDash))
+    return std::nullopt;
+  rest = rest.substr(0, cut);
+
+  // <seq>
+  cut = rest.rfind('_');
+  if (cut == std::string_view::npos || cut + 1 == rest.size())
+    return std::nullopt;
+  const std::string_view seq = rest.substr(cut + 1);
+  if (!allOf(seq, kDigit))
+    return std::nullopt;
+  rest = rest.substr(0, cut);
+
+  // <lane>: a single digit
+  if (rest.size() < 2 || rest[rest.size() - 2] != '_' ||
+      kCharClasses[static_cast<unsigned char>(rest.back())] != kDigit)
+    return std::nullopt;
+  const size_t lane = static_cast<size_t>(rest.back() - '0');
+  if (lane >= kPriorityLanes)
+    return std::nullopt;
+  rest = rest.substr(0, rest.size() - 2);
+
+  // <ts>_<sender>
+  cut = rest.find('_');
+  if (cut == 0 || cut == std::string_view::npos || cut + 1 == rest.size() ||
+      !allOf(rest.substr(0, cut), kDigit) ||
+      !allOf(rest.substr(cut + 1), kDigit | kAlpha | kUnderscore))
+    return std::nullopt;
+
+  FrameName frame{rest.substr(cut + 1), lane, 0};
+  const auto res =
+      std::from_chars(seq.data(), seq.data() + seq.size(), frame.seq);
+  if (res.ec != std::errc() || res.ptr != seq.data() + seq.size())
+    return std::nullopt;
+  return frame;
+}
+
+InboxScanner::InboxScanner(const std::filesystem::path &dir) : dir_(dir) {}
+
+InboxScanner::~InboxScanner() {
+#if defined(__linux__)
+  if (fd_ >= 0)
+    ::close(fd_);
+#endif
+}
+
+bool InboxScanner::open_() {
+#if defined(__linux__)
+  fd_ = ::open(dir_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd_ < 0)
+    return false;
+  buf_.resize(64 * 1024);
+  return true;
+#else
+  return false;
+#endif
+}
+
+size_t InboxScanner::scan(const std::function<void(std::string_view)> &visit) {
+  size_t visited = 0;
+#if defined(__linux__)
+  // layout the kernel fills in; glibc only declares it with _GNU_SOURCE
+  struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+  };
+
+  if (fd_ < 0 && !open_())
+    return 0;
+  // rewind instead of reopening: the same fd serves every pass
+  if (::lseek(fd_, 0, SEEK_SET) != 0) {
+    ::close(fd_);
+    if (!open_())
+      return 0;
+  }
+  for (;;) {
+    const long n = ::syscall(SYS_getdents64, fd_, buf_.data(), buf_.size());
+    if (n < 0) {
+      std::cerr << "[ERROR]: Unable to read inbox " << dir_ << ": "
+                << std::strerror(errno) << "\n";
+      // the directory may have been replaced; reopen on the next pass
+      ::close(fd_);
+      fd_ = -1;
+      break;
+    }
+    if (n == 0)
+      break;
+    for (long off = 0; off < n;) {
+      const auto *entry =
+          reinterpret_cast<const LinuxDirent64 *>(buf_.data() + off);
+      off += entry->d_reclen;
+      // some filesystems do not report types; the frame parser still
+      // filters those names
+      if (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN)
+        continue;
+      visit(std::string_view(entry->d_name));
+      ++visited;
+    }
+  }
+#else
+  std::error_code ec;
+  std::string name;
+  for (const auto &entry : std::filesystem::directory_iterator(dir_, ec)) {
+    if (!entry.is_regular_file(ec))
+      continue;
+    name = entry.path().filename().string();
+    visit(name);
+    ++visited;
+  }
+#endif
+  return visited;
+}
+
+ShardedInbox::ShardedInbox(const std::filesystem::path &root) : root_(root) {}
+
+bool ShardedInbox::changed_(const std::filesystem::path &dir,
+                            DirStamp &stamp) {
+  const auto now = std::filesystem::file_time_type::clock::now();
+  std::error_code ec;
+  const auto mtime = std::filesystem::last_write_time(dir, ec);
+  if (ec)
+    return true;
+  if (stamp.settled && mtime == stamp.mtime)
+    return false;
+  stamp.mtime = mtime;
+  stamp.settled = now - mtime > kSettleTime;
+  return true;
+}
+
+// 0 where the platform has no inode, or the directory is gone.
+uint64_t ShardedInbox::inode_(const std::filesystem::path &dir) {
+#if defined(__linux__)
+  struct stat st;
+  if (::stat(dir.c_str(), &st) == 0)
+    return static_cast<uint64_t>(st.st_ino);
+#endif
+  return 0;
+}
+
+// Shards come and go with senders, so the shard set is diffed against the
+// inbox root whenever the root itself changes. A shard that is still there
+// keeps its open scanner and its stamp; a new one, or one removed and
+// created again, is opened and listed afresh. Only sender directories are
+// shards, so `claimed` and SPEED's other names are skipped.
+void ShardedInbox::refreshShards_() {
+  std::unordered_map<std::string, std::unique_ptr<Shard>> previous;
+  previous.reserve(shards_.size());
+  for (auto &shard : shards_)
+    previous.emplace(shard->name, std::move(shard));
+  shards_.clear();
+
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(root_, ec)) {
+    if (!entry.is_directory(ec))
+      continue;
+    std::string name = entry.path().filename().string();
+    if (!Utils::validateName(name) || Utils::isReservedName(name))
+      continue;
+    const uint64_t inode = inode_(entry.path());
+    const auto kept = previous.find(name);
+    if (kept != previous.end() && kept->second->inode == inode) {
+      shards_.push_back(std::move(kept->second));
+      continue;
+    }
+    shards_.push_back(std::make_unique<Shard>(entry.path(), std::move(name)));
+    shards_.back()->inode = inode;
+  }
+}
+
+size_t ShardedInbox::scan(
+    const std::function<bool(std::string_view, std::string_view)> &visit) {
+  if (changed_(root_, root_stamp_))
+    refreshShards_();
+
+  size_t listed = 0;
+  for (auto &shard : shards_) {
+    if (!changed_(root_ / shard->name, shard->stamp))
+      continue;
+    list_(*shard, visit);
+    ++listed;
+  }
+  return listed;
+}
+
+size_t ShardedInbox::scanParallel(
+    const std::function<bool(std::string_view, std::string_view)> &visit,
+    size_t threads) {
+  if (changed_(root_, root_stamp_))
+    refreshShards_();
+
+  std::vector<Shard *> changed;
+  for (auto &shard : shards_) {
+    if (changed_(root_ / shard->name, shard->stamp))
+      changed.push_back(shard.get());
+  }
+  // each shard has its own scanner, so shards can be listed side by side
+  std::atomic<size_t> next{0};
+  auto work = [&]() {
+    for (size_t i = next++; i < changed.size(); i = next++)
+      list_(*changed[i], visit);
+  };
+  std::vector<std::thread> workers;
+  const size_t extra = std::min(threads, changed.size());
+  for (size_t t = 1; t < extra; ++t)
+    workers.emplace_back(work);
+  work();
+  for (std::thread &worker : workers)
+    worker.join();
+  return changed.size();
+}
+
+void ShardedInbox::list_(
+    Shard &shard,
+    const std::function<bool(std::string_view, std::string_view)> &visit) {
+  size_t pending = 0;
+  shard.scanner.scan([&](std::string_view file) {
+    if (visit(shard.name, file))
+      ++pending;
+  });
+  shard.pending = pending;
+}
+
+void ShardedInbox::touch(std::string_view shard) {
+  for (auto &s : shards_) {
+    if (s->name == shard)
+      s->stamp.settled = false;
+  }
+}
+
+size_t ShardedInbox::pending() const {
+  size_t total = 0;
+  for (const auto &shard : shards_)
+    total += shard->pending;
+  return total;
+}
+
+} // namespace SPEED
@@ -0,0 +1,80 @@
+#include "../include/MessagePool.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace SPEED {
+
+MessagePool::Lease &MessagePool::Lease::operator=(Lease &&other) noexcept {
+  if (this != &other) {
+    if (pool_ != nullptr && msg_)
+      pool_->release_(std::move(msg_));
+    pool_ = other.pool_;
+    msg_ = std::move(other.msg_);
+    other.pool_ = nullptr;
+  }
+  return *this;
+}
+
+MessagePool::Lease::~Lease() {
+  if (pool_ != nullptr && msg_)
+    pool_->release_(std::move(msg_));
+}
+
+size_t MessagePool::classFor(size_t bytes) {
+  const size_t shift =
+      bytes <= (size_t{1} << kMinClassShift)
+          ? kMinClassShift
+          : static_cast<size_t>(std::bit_width(bytes - 1));
+  return shift > kMaxClassShift ? kClasses : shift - kMinClassShift;
+}
+
+MessagePool::Lease MessagePool::acquire(size_t payload_bytes) {
+  const size_t cls = classFor(payload_bytes);
+  std::unique_ptr<Message> msg;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (cls < kClasses && !free_[cls].empty()) {
+      msg = std::move(free_[cls].back());
+      free_[cls].pop_back();
+      --stats_.cached;
+      ++stats_.hits;
+    } else {
+      ++stats_.misses;
+    }
+    ++stats_.in_use;
+    stats_.high_water = std::max(stats_.high_water, stats_.in_use);
+  }
+  if (!msg) {
+    msg = std::make_unique<Message>();
+    // round up to the class size so the buffer can serve the whole class
+    msg->payload.reserve(cls < kClasses
+                             ? size_t{1} << (cls + kMinClassShift)
+                             : payload_bytes);
+  }
+  return Lease(this, std::move(msg));
+}
+
+// Files the buffer under the largest class it can fully serve, which may
+// differ from the class it was acquired for if the payload grew.
+void MessagePool::release_(std::unique_ptr<Message> msg) {
+  const size_t capacity = msg->payload.capacity();
+  std::lock_guard<std::mutex> lock(mtx_);
+  --stats_.in_use;
+  if (capacity < (size_t{1} << kMinClassShift))
+    return;
+  const size_t shift = static_cast<size_t>(std::bit_width(capacity)) - 1;
+  if (shift > kMaxClassShift)
+    return;
+  auto &bucket = free_[shift - kMinClassShift];
+  if (bucket.size() >= kMaxCachedPerClass)
+    return;
+  bucket.push_back(std::move(msg));
+  ++stats_.cached;
+}
+
+MessagePoolStats MessagePool::stats() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return stats_;
+}
+
+} // namespace SPEED
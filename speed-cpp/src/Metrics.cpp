@@ -0,0 +1,179 @@
+#include "../include/Metrics.hpp"
+#include "../include/Utils.hpp"
+#include <algorithm>
+#include <bit>
+#include <sstream>
+
+namespace SPEED {
+
+namespace {
+// Lowers `target` to `value` if it is smaller; a no-op most of the time.
+void storeMin(std::atomic<uint64_t> &target, uint64_t value) {
+  uint64_t current = target.load(std::memory_order_relaxed);
+  while (value < current &&
+         !target.compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
+  }
+}
+
+void storeMax(std::atomic<uint64_t> &target, uint64_t value) {
+  uint64_t current = target.load(std::memory_order_relaxed);
+  while (value > current &&
+         !target.compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
+  }
+}
+
+void appendHistogram(std::ostringstream &out, const char *name,
+                     const HistogramSnapshot &h) {
+  out << "\"" << name << "\":{\"count\":" << h.count
+      << ",\"sum_ns\":" << h.sum_ns << ",\"min_ns\":" << h.min_ns
+      << ",\"max_ns\":" << h.max_ns << ",\"p50_ns\":" << h.p50_ns
+      << ",\"p90_ns\":" << h.p90_ns << ",\"p99_ns\":" << h.p99_ns
+      << ",\"p999_ns\":" << h.p999_ns << "}";
+}
+} // namespace
+
+// Values below kSubBuckets get a bucket each. Above that, a value's bucket
+// is its power of two and the kSubBits bits below its leading one.
+size_t LatencyHistogram::bucketOf(uint64_t value) {
+  if (value < kSubBuckets)
+    return static_cast<size_t>(value);
+  const size_t exponent = static_cast<size_t>(std::bit_width(value)) - 1;
+  const size_t sub =
+      static_cast<size_t>(value >> (exponent - kSubBits)) & (kSubBuckets - 1);
+  return (exponent - kSubBits + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::lowerBound(size_t bucket) {
+  if (bucket < kSubBuckets)
+    return bucket;
+  const size_t exponent = bucket / kSubBuckets + kSubBits - 1;
+  const uint64_t sub = bucket % kSubBuckets;
+  return (uint64_t{1} << exponent) + (sub << (exponent - kSubBits));
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds elapsed) {
+  const uint64_t ns =
+      elapsed.count() > 0 ? static_cast<uint64_t>(elapsed.count()) : 0;
+  buckets_[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(ns, std::memory_order_relaxed);
+  storeMin(min_, ns);
+  storeMax(max_, ns);
+}
+
+// Concurrent records may land between the loads, so the figures are
+// consistent only to within those records.
+HistogramSnapshot LatencyHistogram::snapshot() const {
+  HistogramSnapshot snap;
+  std::array<uint64_t, kBuckets> counts;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    snap.count += counts[i];
+  }
+  if (snap.count == 0)
+    return snap;
+  snap.sum_ns = sum_.load(std::memory_order_relaxed);
+  snap.min_ns = min_.load(std::memory_order_relaxed);
+  snap.max_ns = max_.load(std::memory_order_relaxed);
+
+  const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  uint64_t *targets[] = {&snap.p50_ns, &snap.p90_ns, &snap.p99_ns,
+                         &snap.p999_ns};
+  size_t q = 0;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets && q < 4; ++i) {
+    seen += counts[i];
+    while (q < 4 && seen > 0 &&
+           static_cast<double>(seen) >= quantiles[q] * snap.count) {
+      const uint64_t upper =
+          i + 1 < kBuckets ? lowerBound(i + 1) - 1 : UINT64_MAX;
+      *targets[q++] = std::min(upper, snap.max_ns);
+    }
+  }
+  return snap;
+}
+
+Metrics::~Metrics() {
+  for (auto &chunk : chunks_)
+    delete chunk.load();
+}
+
+Metrics::Counters &Metrics::peer(PeerId peer) {
+  const size_t index = peer / kChunkPeers;
+  if (index >= kMaxChunks)
+    return overflow_;
+  Chunk *chunk = chunks_[index].load(std::memory_order_acquire);
+  if (chunk == nullptr) {
+    std::lock_guard<std::mutex> lock(grow_mutex_);
+    chunk = chunks_[index].load(std::memory_order_acquire);
+    if (chunk == nullptr) {
+      chunk = new Chunk();
+      chunks_[index].store(chunk, std::memory_order_release);
+    }
+  }
+  return (*chunk)[peer % kChunkPeers];
+}
+
+MetricsSnapshot Metrics::snapshot(const PeerTable &names) const {
+  MetricsSnapshot snap;
+  const size_t peers = names.size();
+  for (size_t id = 0; id < peers; ++id) {
+    const size_t index = id / kChunkPeers;
+    if (index >= kMaxChunks)
+      break;
+    const Chunk *chunk = chunks_[index].load(std::memory_order_acquire);
+    if (chunk == nullptr)
+      continue;
+    const Counters &c = (*chunk)[id % kChunkPeers];
+    PeerMetrics m;
+    m.sent = c.sent.load(std::memory_order_relaxed);
+    m.received = c.received.load(std::memory_order_relaxed);
+    m.sent_bytes = c.sent_bytes.load(std::memory_order_relaxed);
+    m.received_bytes = c.received_bytes.load(std::memory_order_relaxed);
+    m.gaps = c.gaps.load(std::memory_order_relaxed);
+    m.drops = c.drops.load(std::memory_order_relaxed);
+    if (m.sent + m.received + m.gaps + m.drops == 0)
+      continue;
+    m.peer = names.name(static_cast<PeerId>(id));
+    snap.peers.push_back(std::move(m));
+  }
+  auto histogram = [&](Histogram which) {
+    return histograms_[static_cast<size_t>(which)].snapshot();
+  };
+  snap.end_to_end = histogram(Histogram::EndToEnd);
+  snap.encrypt = histogram(Histogram::Encrypt);
+  snap.decrypt = histogram(Histogram::Decrypt);
+  snap.write = histogram(Histogram::Write);
+  snap.scan = histogram(Histogram::Scan);
+  snap.reorder_depth = reorder_depth_.load(std::memory_order_relaxed);
+  return snap;
+}
+
+std::string MetricsSnapshot::toJson() const {
+  std::ostringstream out;
+  out << "{\"peers\":[";
+  for (size_t i = 0; i < peers.size(); ++i) {
+    const PeerMetrics &p = peers[i];
+    out << (i ? "," : "") << "{\"peer\":\"" << Utils::jsonEscape(p.peer)
+        << "\",\"sent\":" << p.sent << ",\"received\":" << p.received
+        << ",\"sent_bytes\":" << p.sent_bytes
+        << ",\"received_bytes\":" << p.received_bytes
+        << ",\"gaps\":" << p.gaps << ",\"drops\":" << p.drops << "}";
+  }
+  out << "],\"histograms\":{";
+  appendHistogram(out, "end_to_end", end_to_end);
+  out << ",";
+  appendHistogram(out, "encrypt", encrypt);
+  out << ",";
+  appendHistogram(out, "decrypt", decrypt);
+  out << ",";
+  appendHistogram(out, "write", write);
+  out << ",";
+  appendHistogram(out, "scan", scan);
+  out << "},\"reorder_depth\":" << reorder_depth
+      << ",\"inbox_depth\":" << inbox_depth << "}";
+  return out.str();
+}
+
+} // namespace SPEED
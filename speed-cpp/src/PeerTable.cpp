@@ -0,0 +1,44 @@
+#include "../include/PeerTable.hpp"
+#include <mutex>
+#include <stdexcept>
+
+namespace SPEED {
+
+PeerId PeerTable::intern(std::string_view name) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    auto it = ids_.find(name);
+    if (it != ids_.end())
+      return it->second;
+  }
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  auto it = ids_.find(name); // another thread may have won the race
+  if (it != ids_.end())
+    return it->second;
+  const PeerId id = static_cast<PeerId>(names_.size());
+  names_.emplace_back(name);
+  ids_.emplace(names_.back(), id);
+  return id;
+}
+
+std::optional<PeerId> PeerTable::find(std::string_view name) const {
+  std::shared_lock<std::shared_mutex> lock(mtx_);
+  auto it = ids_.find(name);
+  if (it == ids_.end())
+    return std::nullopt;
+  return it->second;
+}
+
+const std::string &PeerTable::name(PeerId id) const {
+  std::shared_lock<std::shared_mutex> lock(mtx_);
+  if (id >= names_.size())
+    throw std::out_of_range("Unknown peer id");
+  return names_[id];
+}
+
+size_t PeerTable::size() const {
+  std::shared_lock<std::shared_mutex> lock(mtx_);
+  return names_.size();
+}
+
+} // namespace SPEED
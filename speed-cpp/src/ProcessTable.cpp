@@ -0,0 +1,332 @@
+#include "../include/ProcessTable.hpp"
+#include "../include/Utils.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace SPEED {
+
+namespace {
+constexpr uint64_t kTableMagic = 0x5350454544505432ull; // "SPEEDPT2"
+
+enum SlotState : uint32_t { kFree = 0, kClaiming = 1, kLive = 2 };
+
+// 30 bits of Utils::pidSpace(); 0 if it is unknown, which matches nobody.
+uint32_t selfSpace() {
+  static const uint32_t tag = [] {
+    const std::string &space = Utils::pidSpace();
+    if (space.empty())
+      return 0u;
+    uint64_t h = 1469598103934665603ull;
+    for (char c : space) {
+      h ^= static_cast<unsigned char>(c);
+      h *= 1099511628211ull;
+    }
+    return static_cast<uint32_t>(h % 0x3FFFFFFFull) + 1;
+  }();
+  return tag;
+}
+
+uint32_t selfPid() {
+#if defined(__unix__) || defined(__APPLE__)
+  return static_cast<uint32_t>(::getpid());
+#else
+  return 0;
+#endif
+}
+
+// The owner word of this process in `state`; a Free slot's is 0.
+uint64_t ownerWord(SlotState state) {
+  if (state == kFree)
+    return 0;
+  return static_cast<uint64_t>(selfPid()) << 32 |
+         static_cast<uint64_t>(selfSpace()) << 2 | state;
+}
+uint32_t stateOf(uint64_t owner) { return static_cast<uint32_t>(owner & 3); }
+uint32_t pidOf(uint64_t owner) { return static_cast<uint32_t>(owner >> 32); }
+bool isLocal(uint64_t owner) {
+  const uint32_t space = static_cast<uint32_t>(owner >> 2) & 0x3FFFFFFF;
+  return space != 0 && space == selfSpace();
+}
+
+template <typename T> std::atomic_ref<T> atomic(T &value) {
+  static_assert(std::atomic_ref<T>::is_always_lock_free,
+                "shared-memory atomics must be lock-free");
+  return std::atomic_ref<T>(value);
+}
+
+uint64_t nowMillis() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+// Whether `since_ms` (wall clock) is more than `limit` ago. A stamp from
+// ahead of this clock, e.g. another host's, is not.
+bool olderThan(uint64_t since_ms, std::chrono::seconds limit) {
+  const auto ms = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(limit).count());
+  const uint64_t now = nowMillis();
+  return now > since_ms && now - since_ms > ms;
+}
+
+} // namespace
+
+ProcessTable::ProcessTable(const std::filesystem::path &path) {
+#if defined(__unix__) || defined(__APPLE__)
+  map_size_ = sizeof(Header) + kSlots * sizeof(Slot);
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0)
+    throw std::runtime_error("Unable to open process table: " +
+                             std::string(std::strerror(errno)));
+  // growing a short file zero-fills it, and zero is an empty table; every
+  // creator asks for the same size so racing here is harmless
+  if (::lseek(fd, 0, SEEK_END) < static_cast<off_t>(map_size_) &&
+      ::ftruncate(fd, static_cast<off_t>(map_size_)) != 0) {
+    const int err = errno;
+    ::close(fd);
+    throw std::runtime_error("Unable to size process table: " +
+                             std::string(std::strerror(err)));
+  }
+  map_ = ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    throw std::runtime_error("Unable to map process table: " +
+                             std::string(std::strerror(errno)));
+  }
+  header_ = static_cast<Header *>(map_);
+  slots_ = reinterpret_cast<Slot *>(static_cast<char *>(map_) + sizeof(Header));
+
+  uint64_t magic = 0;
+  if (!atomic(header_->magic).compare_exchange_strong(magic, kTableMagic) &&
+      magic != kTableMagic) {
+    ::munmap(map_, map_size_);
+    map_ = nullptr;
+    throw std::runtime_error("Process table has an incompatible layout");
+  }
+#else
+  (void)path;
+  throw std::runtime_error("Process table needs mmap");
+#endif
+}
+
+ProcessTable::~ProcessTable() {
+  release();
+#if defined(__unix__) || defined(__APPLE__)
+  if (map_)
+    ::munmap(map_, map_size_);
+#endif
+}
+
+// FNV-1a; a name's probe sequence starts at its home slot.
+size_t ProcessTable::home_(std::string_view name) {
+  uint64_t h = 1469598103934665603ull;
+  for (char c : name) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 1099511628211ull;
+  }
+  return static_cast<size_t>(h % kSlots);
+}
+
+// Takes `slot` from the owner word `expected` to Claiming under this pid and
+// stamps the claim, so a claimer that dies from here on can be told apart
+// from a slow one.
+bool ProcessTable::enter_(Slot &slot, uint64_t expected) {
+  if (!atomic(slot.owner).compare_exchange_strong(expected,
+                                                 ownerWord(kClaiming)))
+    return false;
+  atomic(slot.claimed_ms).store(nowMillis());
+  return true;
+}
+
+// Hands a slot this process holds in Claiming on as `owner`. Fails if the
+// claim was abandoned meanwhile and someone else reclaimed the slot.
+bool ProcessTable::leave_(Slot &slot, uint64_t owner) {
+  uint64_t mine = ownerWord(kClaiming);
+  atomic(slot.claimed_ms).store(0);
+  return atomic(slot.owner).compare_exchange_strong(mine, owner);
+}
+
+// A Claiming slot whose claimer died, or that has been Claiming for longer
+// than any claim takes. Only a claimer of this pid space can be probed.
+bool ProcessTable::abandoned_(const Slot &slot, uint64_t owner) {
+  if (stateOf(owner) != kClaiming)
+    return false;
+  if (isLocal(owner) && !Utils::isProcessAlive(pidOf(owner)))
+    return true;
+  const uint64_t since = atomic(const_cast<Slot &>(slot).claimed_ms).load();
+  return since != 0 && olderThan(since, kClaimTimeout);
+}
+
+// Takes `slot` from `expected` to Claiming, writes this process into it and
+// publishes it as Live.
+bool ProcessTable::fill_(Slot &slot, uint64_t expected, std::string_view name,
+                         uint64_t capabilities) {
+  if (!enter_(slot, expected))
+    return false;
+  atomic(slot.generation).fetch_add(1);
+  slot.capabilities = capabilities;
+  std::memset(slot.name, 0, sizeof(slot.name));
+  std::memcpy(slot.name, name.data(), name.size());
+  atomic(slot.heartbeat_ms).store(nowMillis());
+  const uint64_t generation = atomic(slot.generation).fetch_add(1) + 1;
+  if (!leave_(slot, ownerWord(kLive)))
+    return false;
+  atomic(header_->generation).fetch_add(1);
+  own_ = &slot;
+  own_generation_ = generation;
+  last_beat_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+bool ProcessTable::claim(std::string_view name, uint64_t capabilities) {
+  if (name.empty() || name.size() > kMaxNameLength)
+    return false;
+  release();
+  const size_t home = home_(name);
+  ProcessInfo info;
+  uint64_t owner = 0;
+  for (size_t i = 0; i < kSlots; ++i) {
+    Slot &slot = slots_[(home + i) % kSlots];
+    if (!read_(slot, info, &owner) || info.name != name)
+      continue;
+    // only a holder of this pid space can be probed
+    const bool held =
+        info.local ? info.pid != selfPid() && Utils::isProcessAlive(info.pid)
+                   : !olderThan(info.heartbeat_ms, kHeartbeatTimeout);
+    if (held) {
+      std::cout << "[ERROR]: " << name << " is already running as pid "
+                << info.pid << "\n";
+      return false;
+    }
+    if (fill_(slot, owner, name, capabilities))
+      return true;
+  }
+  for (size_t i = 0; i < kSlots; ++i) {
+    Slot &slot = slots_[(home + i) % kSlots];
+    owner = atomic(slot.owner).load();
+    if ((stateOf(owner) == kFree || abandoned_(slot, owner)) &&
+        fill_(slot, owner, name, capabilities))
+      return true;
+  }
+  std::cout << "[ERROR]: Process table is full\n";
+  return false;
+}
+
+void ProcessTable::release() {
+  if (!own_)
+    return;
+  Slot &slot = *own_;
+  own_ = nullptr;
+  // a restarted instance of this name may have taken the slot over; its
+  // claim moved the slot's generation
+  free_(slot, own_generation_);
+}
+
+bool ProcessTable::evict(const ProcessInfo &info) {
+  const size_t home = home_(info.name);
+  ProcessInfo current;
+  for (size_t i = 0; i < kSlots; ++i) {
+    Slot &slot = slots_[(home + i) % kSlots];
+    if (read_(slot, current) && current.name == info.name)
+      return current.generation == info.generation &&
+             free_(slot, info.generation);
+  }
+  return false;
+}
+
+// Frees `slot` if it is still Live at `generation`.
+bool ProcessTable::free_(Slot &slot, uint64_t generation) {
+  const uint64_t owner = atomic(slot.owner).load();
+  if (stateOf(owner) != kLive ||
+      atomic(slot.generation).load() != generation || !enter_(slot, owner))
+    return false;
+  if (atomic(slot.generation).load() != generation) {
+    leave_(slot, owner); // lost the race, hand it back
+    return false;
+  }
+  atomic(slot.generation).fetch_add(1);
+  if (!leave_(slot, ownerWord(kFree)))
+    return false;
+  atomic(header_->generation).fetch_add(1);
+  return true;
+}
+
+void ProcessTable::beat() {
+  if (!own_)
+    return;
+  const auto now = std::chrono::steady_clock::now();
+  if (now - last_beat_ < kHeartbeatInterval)
+    return;
+  last_beat_ = now;
+  if (atomic(own_->generation).load() != own_generation_) {
+    own_ = nullptr; // taken over
+    return;
+  }
+  atomic(own_->heartbeat_ms).store(nowMillis());
+}
+
+uint64_t ProcessTable::generation() const {
+  return atomic(header_->generation).load();
+}
+
+// Copies a Live slot into `info`. The copy is only trusted if the slot's
+// generation did not move while it was taken.
+bool ProcessTable::read_(const Slot &slot, ProcessInfo &info,
+                         uint64_t *owner_out) const {
+  Slot &s = const_cast<Slot &>(slot);
+  for (int attempt = 0; attempt < 4; ++attempt) {
+    const uint64_t before = atomic(s.generation).load();
+    const uint64_t owner = atomic(s.owner).load();
+    if (stateOf(owner) != kLive)
+      return false;
+    char name[sizeof(s.name)];
+    std::memcpy(name, s.name, sizeof(name));
+    name[sizeof(name) - 1] = '\0';
+    const uint64_t capabilities = s.capabilities;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (atomic(s.generation).load() != before ||
+        atomic(s.owner).load() != owner)
+      continue;
+    info.name.assign(name);
+    info.pid = pidOf(owner);
+    info.local = isLocal(owner);
+    info.capabilities = capabilities;
+    info.heartbeat_ms = atomic(s.heartbeat_ms).load();
+    info.generation = before;
+    if (owner_out)
+      *owner_out = owner;
+    return true;
+  }
+  return false;
+}
+
+std::optional<ProcessInfo> ProcessTable::find(std::string_view name) const {
+  const size_t home = home_(name);
+  ProcessInfo info;
+  for (size_t i = 0; i < kSlots; ++i) {
+    if (read_(slots_[(home + i) % kSlots], info) && info.name == name)
+      return info;
+  }
+  return std::nullopt;
+}
+
+void ProcessTable::forEach(
+    const std::function<void(const ProcessInfo &)> &visit) const {
+  ProcessInfo info;
+  for (size_t i = 0; i < kSlots; ++i) {
+    if (read_(slots_[i], info))
+      visit(info);
+  }
+}
+
+} // namespace SPEED
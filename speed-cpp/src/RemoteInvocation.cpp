@@ -0,0 +1,129 @@
+#include "../include/RemoteInvocation.hpp"
+#include "../include/BinaryManager.hpp"
+#include <stdexcept>
+
+namespace SPEED {
+
+namespace {
+
+template <typename T>
+void append_uint(std::vector<uint8_t> &out, T value) {
+  const auto bytes = to_big_endian(value);
+  out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+void append_string(std::vector<uint8_t> &out, const std::string &s) {
+  append_uint(out, static_cast<uint32_t>(s.size()));
+  out.insert(out.end(), s.begin(), s.end());
+}
+
+// Bounds-checked reader over a decrypted payload. The payload comes from
+// another process so every length is validated before it is trusted.
+class PayloadReader {
+public:
+  explicit PayloadReader(const std::vector<uint8_t> &buf) : buf_(buf) {}
+
+  template <typename T> T readUint() {
+    need(sizeof(T));
+    T v = from_big_endian<T>(buf_.data() + pos_);
+    pos_ += sizeof(T);
+    return v;
+  }
+
+  std::string readString() {
+    const uint32_t len = readUint<uint32_t>();
+    need(len);
+    std::string s(reinterpret_cast<const char *>(buf_.data() + pos_), len);
+    pos_ += len;
+    return s;
+  }
+
+  // Every encoded element takes at least `min_size` bytes, so a count larger
+  // than remaining / min_size is malformed and must not drive a reserve().
+  void checkCount(uint32_t count, size_t min_size) const {
+    if (count > (buf_.size() - pos_) / min_size)
+      throw std::runtime_error("RFI payload count exceeds payload size");
+  }
+
+private:
+  void need(size_t n) const {
+    if (buf_.size() - pos_ < n)
+      throw std::runtime_error("RFI payload truncated");
+  }
+
+  const std::vector<uint8_t> &buf_;
+  size_t pos_ = 0;
+};
+
+} // namespace
+
+std::vector<uint8_t>
+RemoteInvocation::encodeBatch(const std::vector<InvokeCall> &calls) {
+  std::vector<uint8_t> out;
+  append_uint(out, static_cast<uint32_t>(calls.size()));
+  for (const InvokeCall &call : calls) {
+    append_string(out, call.method);
+    append_uint(out, static_cast<uint32_t>(call.args.size()));
+    for (const std::string &arg : call.args) {
+      append_string(out, arg);
+    }
+  }
+  return out;
+}
+
+std::vector<InvokeCall>
+RemoteInvocation::decodeBatch(const std::vector<uint8_t> &payload) {
+  PayloadReader in(payload);
+  const uint32_t count = in.readUint<uint32_t>();
+  in.checkCount(count, 2 * sizeof(uint32_t));
+
+  std::vector<InvokeCall> calls;
+  calls.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    InvokeCall call;
+    call.method = in.readString();
+    const uint32_t argc = in.readUint<uint32_t>();
+    in.checkCount(argc, sizeof(uint32_t));
+    call.args.reserve(argc);
+    for (uint32_t a = 0; a < argc; ++a) {
+      call.args.push_back(in.readString());
+    }
+    calls.push_back(std::move(call));
+  }
+  return calls;
+}
+
+std::vector<uint8_t>
+RemoteInvocation::encodeResults(const std::vector<InvokeResult> &results) {
+  std::vector<uint8_t> out;
+  append_uint(out, static_cast<uint32_t>(results.size()));
+  for (const InvokeResult &res : results) {
+    append_string(out, res.method);
+    append_uint(out, static_cast<uint8_t>(res.status));
+    append_string(out, res.error);
+  }
+  return out;
+}
+
+std::vector<InvokeResult>
+RemoteInvocation::decodeResults(const std::vector<uint8_t> &payload) {
+  PayloadReader in(payload);
+  const uint32_t count = in.readUint<uint32_t>();
+  in.checkCount(count, 2 * sizeof(uint32_t) + sizeof(uint8_t));
+
+  std::vector<InvokeResult> results;
+  results.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    InvokeResult res;
+    res.method = in.readString();
+    const uint8_t status = in.readUint<uint8_t>();
+    if (status > static_cast<uint8_t>(InvokeStatus::FAILED))
+      throw std::runtime_error("RFI result has unknown status");
+    res.status = static_cast<InvokeStatus>(status);
+    res.error = in.readString();
+    results.push_back(std::move(res));
+  }
+  return results;
+}
+
+} // namespace SPEED
@@ -0,0 +1,80 @@
+#include "../include/ReorderBuffer.hpp"
+#include <bit>
+#include <utility>
+
+namespace SPEED {
+
+namespace {
+constexpr size_t kInitialSlots = 16;
+}
+
+ReorderBuffer::ReorderBuffer(size_t max_window)
+    : max_window_(std::bit_ceil(max_window < 1 ? size_t{1} : max_window)) {}
+
+ReorderBuffer::InsertResult ReorderBuffer::insert(long long seq,
+                                                  std::string_view file) {
+  if (seq < next_)
+    return InsertResult::Consumed;
+  const size_t offset = static_cast<size_t>(seq - next_);
+  if (offset >= max_window_)
+    return InsertResult::OutOfWindow;
+  if (offset >= slots_.size())
+    grow_(offset + 1);
+
+  Slot &slot = slots_[static_cast<size_t>(seq) & (slots_.size() - 1)];
+  if (slot.present)
+    return InsertResult::Duplicate;
+  slot.present = true;
+  slot.file.assign(file);
+  ++size_;
+  return InsertResult::Buffered;
+}
+
+const std::string *ReorderBuffer::front() const {
+  if (size_ == 0)
+    return nullptr;
+  const Slot &slot = slots_[static_cast<size_t>(next_) & (slots_.size() - 1)];
+  return slot.present ? &slot.file : nullptr;
+}
+
+void ReorderBuffer::pop() {
+  if (size_ != 0) {
+    Slot &slot = slots_[static_cast<size_t>(next_) & (slots_.size() - 1)];
+    if (slot.present) {
+      slot.present = false;
+      --size_;
+    }
+  }
+  ++next_;
+}
+
+void ReorderBuffer::resume(long long next) {
+  if (size_ == 0)
+    next_ = next;
+}
+
+void ReorderBuffer::reset(long long next) {
+  for (Slot &slot : slots_)
+    slot.present = false;
+  size_ = 0;
+  next_ = next;
+}
+
+// Doubles the ring until it spans `min_span` seqs from next_, moving each
+// held frame to its slot under the new mask.
+void ReorderBuffer::grow_(size_t min_span) {
+  size_t capacity = slots_.empty() ? kInitialSlots : slots_.size();
+  while (capacity < min_span)
+    capacity *= 2;
+  std::vector<Slot> grown(capacity);
+  const size_t old_size = slots_.size();
+  for (size_t i = 0; i < old_size; ++i) {
+    const size_t seq = static_cast<size_t>(next_) + i;
+    Slot &from = slots_[seq & (old_size - 1)];
+    if (from.present)
+      grown[seq & (capacity - 1)] = std::move(from);
+  }
+  slots_ = std::move(grown);
+}
+
+} // namespace SPEED
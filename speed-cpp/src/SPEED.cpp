@@ -1,18 +1,34 @@
 #include "SPEED.hpp"
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <regex>
 #include <sstream>
 #include <thread>
 #include <vector>
 
 namespace SPEED {
 
+// The instance whose watcher runs on this thread, or waits for it as RFI
+// pool workers do. A send made there must not wait for ACKs or credit: the
+// watcher is what would process them.
+static thread_local const SPEED *t_watcher_of = nullptr;
+
 SPEED::SPEED(const std::string &proc_name, const ThreadMode &tmode,
              const std::filesystem::path &speed_dir) {
+  // names travel inline in the fixed-size frame header
+  if (proc_name.size() > kMaxNameLength) {
+    std::cout << "[ERROR]: Process name longer than " << kMaxNameLength
+              << " bytes\n";
+    throw std::runtime_error("Process name too long\n");
+  }
+  // the name is also the inbox's directory in the speed dir
+  if (!Utils::validateName(proc_name) || Utils::isReservedName(proc_name)) {
+    std::cout << "[ERROR]: Invalid process name: " << proc_name << "\n";
+    throw std::runtime_error("Invalid process name\n");
+  }
   self_proc_name_ = proc_name;
   tmode_ = tmode;
   speed_dir_ = speed_dir;
@@ -22,7 +38,8 @@ SPEED::SPEED(const std::string &proc_name, const ThreadMode &tmode,
     Utils::createDefaultDir(speed_dir_);
   }
 
-  if (!Utils::directoryExists(self_speed_dir_)) {
+  const bool had_inbox = Utils::directoryExists(self_speed_dir_);
+  if (!had_inbox) {
     Utils::createDefaultDir(self_speed_dir_);
   }
 
@@ -32,12 +49,138 @@ SPEED::SPEED(const std::string &proc_name, const ThreadMode &tmode,
   // std::cout << "[INFO Speed Dir: " << speed_dir_ << "\n";
   access_list_ = std::make_unique<AccessRegistry>(
       speed_dir_ / "access_registry", proc_name);
+  topic_registry_ = std::make_unique<TopicRegistry>(
+      speed_dir_ / "access_registry" / "topics", proc_name);
+  work_queue_ = std::make_unique<WorkQueue>(speed_dir_, proc_name);
+  inbox_ = std::make_unique<ShardedInbox>(self_speed_dir_);
+  work_queue_->requeueOwnClaims();
+  const std::filesystem::path seq_path =
+      SeqState::pathFor(speed_dir_, proc_name);
+  {
+    std::error_code ec;
+    std::filesystem::create_directories(seq_path.parent_path(), ec);
+    if (!had_inbox) {
+      // its watermarks describe an inbox that was collected with the
+      // frames in it; a new epoch tells the peers to start again
+      std::filesystem::remove(seq_path, ec);
+    } else if (!std::filesystem::exists(seq_path, ec)) {
+      // kept inside the inbox before it moved out
+      std::filesystem::rename(self_speed_dir_ / ".seqstate", seq_path, ec);
+    }
+  }
+  bool fresh = true;
+  try {
+    seq_state_ = std::make_unique<SeqState>(seq_path);
+    epoch_ = seq_state_->epoch();
+    fresh = !restoreSeqs_();
+  } catch (const std::runtime_error &e) {
+    std::cout << "[WARN]: " << e.what() << ", sequence numbers restart at 0\n";
+    epoch_ = SeqState::newEpoch();
+  }
+  session_key_ = EncryptionManager::deriveKey({});
+  // outside the inbox, so the identity outlives the GC of a dead inbox
+  const std::filesystem::path identities = speed_dir_ / "identities";
+  std::error_code ec;
+  std::filesystem::create_directories(identities, ec);
+  std::filesystem::permissions(identities, std::filesystem::perms::owner_all,
+                               ec);
+  try {
+    identity_ =
+        std::make_unique<IdentityStore>(identities / (proc_name + ".id"));
+    kx_ = identity_->keyPair();
+    restoreSessions_();
+  } catch (const std::runtime_error &e) {
+    std::cout << "[WARN]: " << e.what()
+              << ", sessions do not survive a restart and peer keys are not "
+                 "pinned\n";
+    kx_ = EncryptionManager::generateKeyPair();
+  }
+  if (fresh)
+    announceRestart_();
 }
 
 SPEED::SPEED(const std::string &proc_name, const ThreadMode &tmode)
     : SPEED(proc_name, tmode, Utils::getDefaultSPEEDDir()) {}
 
-SPEED::~SPEED() { kill(); }
+// Picks up where the previous instance of this process stopped. Frames it
+// sent count as acknowledged: their ACKs went to the old instance. Returns
+// false if there was no state to pick up.
+bool SPEED::restoreSeqs_() {
+  bool restored = false;
+  seq_state_->forEach([&](std::string_view name, const PeerSeqs &saved) {
+    const PeerId peer = peers_.intern(name);
+    for (size_t lane = 0; lane < kPriorityLanes; ++lane) {
+      send_seq_[peer][lane] = saved.send[lane];
+      acked_seq_[peer][lane] = saved.send[lane];
+      sender_buffers_[peer][lane].resume(saved.recv[lane]);
+    }
+    consumed_[peer] = {saved.consumed_messages, saved.consumed_bytes};
+    peer_epoch_[peer] = saved.epoch;
+    restored = true;
+  });
+  return restored;
+}
+
+// Re-derives the session of every pinned peer. A peer that restarted in
+// the meantime kept its key pair, so both ends arrive at the same keys
+// without a handshake.
+void SPEED::restoreSessions_() {
+  identity_->forEach(
+      [&](std::string_view name, const EncryptionManager::PublicKey &key) {
+        const PeerId peer = peers_.intern(name);
+        PeerSession &session = sessions_[peer];
+        if (!EncryptionManager::deriveSessionKeys(
+                kx_, key, self_proc_name_ < name, session.keys))
+          return;
+        session.peer_key = key;
+        session.established = true;
+      });
+}
+
+// The state slot of `peer`, looked up once and cached in `cache`.
+PeerSeqs *SPEED::persisted_(PeerMap<PeerSeqs *> &cache, PeerId peer) {
+  if (!seq_state_)
+    return nullptr;
+  PeerSeqs *&slot = cache[peer];
+  if (slot == nullptr)
+    slot = seq_state_->get(peers_.name(peer));
+  return slot;
+}
+
+// Asks every running peer this process has a pinned key for to restart its
+// channel with us: we have no seq state to continue it from. Sent before
+// the constructor returns, so it is on disk ahead of any user frame.
+void SPEED::announceRestart_() {
+  if (!identity_)
+    return;
+  std::vector<std::string> pinned;
+  identity_->forEach(
+      [&](std::string_view name, const EncryptionManager::PublicKey &) {
+        pinned.emplace_back(name);
+      });
+  for (const std::string &name : pinned) {
+    if (!access_list_->checkGlobalRegistry(name))
+      continue;
+    Message req = Message::construct_CON_REQ(
+        name,
+        std::vector<uint8_t>(kx_.public_key.begin(), kx_.public_key.end()),
+        epoch_);
+    dispatch_(req, peers_.intern(name));
+  }
+}
+
+SPEED::~SPEED() {
+  {
+    // queued RFI calls still answer through this instance
+    std::lock_guard<std::mutex> lock(rfi_pool_mutex_);
+    rfi_pool_.reset();
+  }
+  kill();
+  sodium_memzero(kx_.secret_key.data(), kx_.secret_key.size());
+  for (PeerId peer = 0; peer < sessions_.size(); ++peer) {
+    sodium_memzero(&sessions_[peer], sizeof(PeerSession));
+  }
+}
 
 bool SPEED::setKeyFile(const std::filesystem::path &key_path) {
   if (!Utils::fileExists(key_path))
@@ -50,6 +193,8 @@ bool SPEED::setKeyFile(const std::filesystem::path &key_path) {
   }
   // std::cout << "[INFO]: Retrieved Key: " << key_ << "\n";
   key_path_ = key_path;
+  session_key_ = EncryptionManager::deriveKey(
+      std::vector<uint64_t>(key_.begin(), key_.end()));
   return true;
 }
 
@@ -59,6 +204,11 @@ void SPEED::setCallback(std::function<void(const PMessage &)> cb) {
 }
 
 bool SPEED::addProcess(const std::string &proc_name) {
+  if (!Utils::validateName(proc_name) || Utils::isReservedName(proc_name) ||
+      proc_name.size() > kMaxNameLength) {
+    std::cout << "[ERROR]: Invalid process name: " << proc_name << "\n";
+    return false;
+  }
   std::lock_guard<std::mutex> lock(access_list_mutex_);
 
   if (access_list_) {
@@ -68,6 +218,12 @@ bool SPEED::addProcess(const std::string &proc_name) {
     }
   }
 
+  // offer our public key; the peer's CON_RES completes the session
+  Message req = Message::construct_CON_REQ(
+      proc_name,
+      std::vector<uint8_t>(kx_.public_key.begin(), kx_.public_key.end()),
+      epoch_);
+  dispatch_(req, peers_.intern(proc_name));
   return true;
 }
 
@@ -78,6 +234,7 @@ void SPEED::start() {
     return;
 
   watcher_running_.store(true);
+  recover_();
 
   if (tmode_ == ThreadMode::Single) {
     // In single-thread mode, run watcher in main loop (blocking for
@@ -102,66 +259,1081 @@ void SPEED::kill() {
   watcher_should_exit_.store(true);
   watcher_running_.store(false);
   access_list_->removeAccessFile();
-  const std::unordered_set<std::string> acl = access_list_->getAccessList();
-  std::vector<uint64_t> k(key_.begin(), key_.end());
-  for (const std::string &entry : acl) {
+  topic_registry_->removeAllSubscriptions();
+  const AccessRegistry::ListView acl = access_list_->getAccessList();
+  for (const std::string &entry : *acl) {
     std::cout << "[DEBUG]: Broadcasting exit notif to: " << entry << "\n\n";
     Message exit_message = Message::construct_EXIT_NOTIF(entry);
-    exit_message.header.seq_num = seq_number_;
-    exit_message.header.sender = self_proc_name_;
-    EncryptionManager::Encrypt(exit_message, k);
-    BinaryManager::writeBinary(exit_message, speed_dir_, seq_number_, entry);
+    dispatch_(exit_message, peers_.intern(entry));
+  }
+}
+
+bool SPEED::sendMessage(const std::string &msg,
+                        const std::string &reciever_name, Priority priority) {
+  warnIfUnreachable_(reciever_name);
+  // reused by every send on this thread; Encrypt() grows the payload in place
+  // and the next construct_MSG() shrinks it again, so after the first few
+  // sends nothing on this path allocates
+  thread_local Message message;
+  Message::construct_MSG(message, msg);
+  message.header.priority = priority;
+  stampExpiry_(message);
+  message.header.sender = self_proc_name_;
+  message.header.reciever = reciever_name;
+  if (!Message::validate_message_sent(message, self_proc_name_,
+                                      reciever_name)) {
+    std::cout << "[ERROR] Message validation failed! Before." << "\n";
+    Message::print_message(message);
+  }
+  return dispatch_(message, peers_.intern(reciever_name), true);
+}
+
+// Multicast: the frame is encrypted and serialized once with an empty
+// reciever field, then hardlinked into every inbox under that reciever's own
+// sequence number.
+bool SPEED::sendMessage(const std::string &msg,
+                        const std::vector<std::string> &recievers,
+                        Priority priority) {
+  if (recievers.empty())
+    return true;
+  if (recievers.size() == 1)
+    return sendMessage(msg, recievers.front(), priority);
+  for (const std::string &reciever_name : recievers) {
+    warnIfUnreachable_(reciever_name);
+  }
+  Message message = Message::construct_MSG(msg);
+  message.header.priority = priority;
+  stampExpiry_(message);
+  return dispatchShared_(message, recievers, true);
+}
+
+void SPEED::subscribe(const std::string &topic) {
+  topic_registry_->subscribe(topic);
+}
+
+void SPEED::unsubscribe(const std::string &topic) {
+  topic_registry_->unsubscribe(topic);
+}
+
+bool SPEED::publish(const std::string &topic, const std::string &msg,
+                    Priority priority) {
+  if (!TopicRegistry::validateTopicName(topic)) {
+    std::cout << "[ERROR]: Invalid topic name: " << topic << "\n";
+    return false;
+  }
+  // the watcher refreshes too, but a process may publish without start()
+  topic_registry_->refresh(topic);
+  const std::vector<std::string> subscribers =
+      topic_registry_->getSubscribers(topic);
+  if (subscribers.empty())
+    return true;
+  Message message = Message::construct_PUBLISH(topic, msg);
+  message.header.priority = priority;
+  stampExpiry_(message);
+  return dispatchShared_(message, subscribers, true);
+}
+
+bool SPEED::submitJob(const std::string &queue, const std::string &msg) {
+  Message message = Message::construct_JOB(msg);
+  message.header.sender = self_proc_name_;
+  EncryptionManager::Encrypt(message, session_key_);
+  return work_queue_->submit(message, queue);
+}
+
+void SPEED::consumeQueue(const std::string &queue, JobHandler handler) {
+  if (!WorkQueue::validateQueueName(queue)) {
+    std::cout << "[ERROR]: Invalid queue name: " << queue << "\n";
+    return;
+  }
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  queue_handlers_[queue] = std::move(handler);
+}
+
+void SPEED::stopConsuming(const std::string &queue) {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  queue_handlers_.erase(queue);
+}
+
+// Claims and runs a bounded batch from every consumed queue. Returns the
+// number of jobs handled so the watcher can skip its sleep while busy.
+size_t SPEED::serveQueues_() {
+  std::unordered_map<std::string, JobHandler> handlers;
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (queue_handlers_.empty())
+      return 0;
+    handlers = queue_handlers_;
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  if (now - last_reclaim_ >= kReclaimInterval) {
+    work_queue_->reclaimDeadClaims();
+    last_reclaim_ = now;
+  }
+
+  size_t handled = 0;
+  for (const auto &[queue, handler] : handlers) {
+    for (const auto &job : work_queue_->claim(queue, kJobClaimBatch)) {
+      processJob_(queue, job, handler);
+      ++handled;
+    }
+  }
+  return handled;
+}
+
+void SPEED::processJob_(const std::string &queue,
+                        const std::filesystem::path &job,
+                        const JobHandler &handler) {
+  try {
+    MessagePool::Lease lease = BinaryManager::readBinary(job, rx_pool_);
+    Message &msg = *lease;
+    EncryptionManager::Decrypt(msg, session_key_);
+    if (msg.header.type != MessageType::JOB ||
+        !Message::validate_message_recieved(msg, self_proc_name_)) {
+      std::cout << "[ERROR]: Invalid job in queue " << queue
+                << "! Dropping.\n";
+    } else {
+      PMessage mm = Message::destruct_message(msg);
+      mm.topic = queue;
+      handler(mm);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "[ERROR]: Job in queue " << queue << " failed: " << e.what()
+              << "\n";
+  }
+  work_queue_->complete(job);
+}
+
+// Encrypts once and publishes a single on-disk frame into every inbox, each
+// under that reciever's own sequence number. Recievers that are out of
+// credit under CreditPolicy::Buffer get a plaintext copy queued instead.
+bool SPEED::dispatchShared_(Message &message,
+                            const std::vector<std::string> &recievers,
+                            bool flow_controlled) {
+  std::unique_lock<std::mutex> lock(write_mutex_);
+  message.header.sender = self_proc_name_;
+  message.header.reciever = "";
+  const uint64_t bytes = message.payload.size();
+
+  bool all_accepted = true;
+  auto drop = [&](PeerId peer) {
+    metrics_.peer(peer).drops.fetch_add(1, std::memory_order_relaxed);
+    all_accepted = false;
+  };
+  std::vector<PeerId> ready;
+  ready.reserve(recievers.size());
+  for (const std::string &reciever_name : recievers) {
+    const PeerId peer = peers_.intern(reciever_name);
+    if (evictedLocked_(peer)) {
+      drop(peer);
+      continue;
+    }
+    if (flow_controlled && ack_window_ > 0 && !waitForWindow_(lock, peer)) {
+      drop(peer);
+      continue;
+    }
+    const CreditGrant grant =
+        flow_controlled && isMetered(message.header.type)
+            ? acquireCredit_(lock, peer, bytes)
+            : CreditGrant::Granted;
+    if (evicted_[peer]) {
+      drop(peer);
+    } else if (grant == CreditGrant::Granted) {
+      ready.push_back(peer);
+    } else if (grant == CreditGrant::Buffered) {
+      credits_.backlog(peer).push_back(message);
+    } else {
+      drop(peer);
+    }
+  }
+  if (ready.empty())
+    return all_accepted;
+
+  if (ack_window_ > 0)
+    message.header.flags |= FLAG_ACK_REQUESTED;
+  const bool tracing = tracer_.enabled() && isMetered(message.header.type);
+  const uint64_t encrypt_ns = tracing ? Utils::getEpochNanos() : 0;
+  const auto encrypt_start = std::chrono::steady_clock::now();
+  EncryptionManager::Encrypt(message, session_key_);
+  const auto write_start = std::chrono::steady_clock::now();
+  const uint64_t write_ns = tracing ? Utils::getEpochNanos() : 0;
+  metrics_.record(Metrics::Histogram::Encrypt, write_start - encrypt_start);
 
-    seq_number_.fetch_add(1, std::memory_order_relaxed);
+  const size_t lane = static_cast<size_t>(message.header.priority);
+  std::vector<std::pair<std::string, long long>> targets;
+  targets.reserve(ready.size());
+  for (PeerId peer : ready) {
+    targets.emplace_back(peers_.name(peer), send_seq_[peer][lane]);
   }
+  std::vector<bool> published;
+  BinaryManager::writeShared(message, speed_dir_, self_proc_name_, targets,
+                             &published);
+  metrics_.record(Metrics::Histogram::Write,
+                  std::chrono::steady_clock::now() - write_start);
+  const uint64_t done_ns = tracing ? Utils::getEpochNanos() : 0;
+  for (size_t i = 0; i < ready.size(); ++i) {
+    const PeerId peer = ready[i];
+    // a seq only counts once its frame is in the inbox; skipping it would
+    // leave a gap the reciever's lane waits on forever
+    if (!published[i]) {
+      drop(peer);
+      continue;
+    }
+    const long long next = ++send_seq_[peer][lane];
+    if (PeerSeqs *saved = persisted_(persisted_tx_, peer))
+      saved->send[lane] = next;
+    if (tracing && tracer_.sampled(targets[i].second))
+      traceSend_(message, peer, targets[i].second, encrypt_ns, write_ns, 0,
+                 done_ns);
+    if (isMetered(message.header.type))
+      credits_.onSent(peer, bytes);
+    Metrics::Counters &counters = metrics_.peer(peer);
+    counters.sent.fetch_add(1, std::memory_order_relaxed);
+    counters.sent_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+  return all_accepted;
 }
 
-void SPEED::sendMessage(const std::string &msg,
-                        const std::string &reciever_name) {
-  if (!access_list_->checkGlobalRegistry(reciever_name)) {
+void SPEED::warnIfUnreachable_(const std::string &reciever_name) {
+  const PeerId peer = peers_.intern(reciever_name);
+  // one snapshot for all three checks, so they agree with its generation
+  const auto acl = access_list_->snapshot();
+  {
+    std::lock_guard<std::mutex> lock(reach_mutex_);
+    if (reachable_at_[peer] == acl->generation)
+      return;
+  }
+  bool reachable = true;
+  if (!acl->global_registry.count(reciever_name) &&
+      !access_list_->resolve(reciever_name)) {
     std::cout << "[WARN] Process: " << reciever_name
               << " not in global registry list" << "\n";
-    access_list_->incrementalBuildGlobalRegistry();
+    reachable = false;
   }
-  if (!access_list_->checkAccess(reciever_name)) {
+  if (!acl->access_list.count(reciever_name)) {
     std::cout << "[WARN] Process: " << reciever_name << " not in access list"
               << "\n";
+    reachable = false;
   }
-  if (!access_list_->check_connection(reciever_name)) {
+  if (!acl->connected_list.count(reciever_name)) {
     std::cout << "[WARN] Process: " << reciever_name
               << " not in connection list" << "\n";
+    reachable = false;
   }
-  Message message = Message::construct_MSG(msg);
-  message.header.seq_num = seq_number_;
-  message.header.sender = self_proc_name_;
-  message.header.reciever = reciever_name;
-  std::vector<uint64_t> k(key_.begin(), key_.end());
-  if (!Message::validate_message_sent(message, self_proc_name_,
-                                      reciever_name)) {
-    std::cout << "[ERROR] Message validation failed! Before." << "\n";
-    Message::print_message(message);
+  if (reachable) {
+    std::lock_guard<std::mutex> lock(reach_mutex_);
+    reachable_at_[peer] = acl->generation;
   }
-  EncryptionManager::Encrypt(message, k);
-  BinaryManager::writeBinary(message, speed_dir_, seq_number_, reciever_name);
+}
+
+// True if `peer` was found dead and has not come back since. Callers hold
+// write_mutex_.
+bool SPEED::evictedLocked_(PeerId peer) {
+  if (!evicted_[peer])
+    return false;
+  const std::string &name = peers_.name(peer);
+  if (access_list_->checkGlobalRegistry(name)) {
+    evicted_[peer] = 0; // restarted
+    return false;
+  }
+  std::cout << "[WARN] Process: " << name << " is dead, message dropped\n";
+  return true;
+}
 
-  seq_number_.fetch_add(1, std::memory_order_relaxed);
+// Stops sending to a dead peer. Senders blocked on its ACK window or credit
+// are released and fail; its buffered messages are dropped. The channel's
+// seqs are kept, as a peer restarted with its state continues them; they
+// start again once its inbox is collected.
+void SPEED::forgetPeer_(const std::string &name) {
+  const PeerId peer = peers_.intern(name);
+  {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    evicted_[peer] = 1;
+    credits_.backlog(peer).clear();
+  }
+  flow_cv_.notify_all();
 }
 
-void SPEED::processFile_(const std::filesystem::path &file_path) {
+// Deletes the inboxes of processes that have been dead for longer than the
+// retention period, and restarts our channel with each of them. An inbox
+// is recognised by the owner file its work queue claim directory carries,
+// so queues/ and access_registry/ are never touched. Owners from another
+// pid space cannot be seen dead from here, so their inboxes are left alone.
+void SPEED::collectDeadInboxes_() {
+  const auto now = std::chrono::steady_clock::now();
+  const std::chrono::seconds retention(inbox_retention_s_.load());
+  if (retention.count() == 0 || now - last_inbox_gc_ < kInboxGcInterval)
+    return;
+  last_inbox_gc_ = now;
+
   std::error_code ec;
+  std::unordered_map<std::string, std::chrono::steady_clock::time_point> dead;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(speed_dir_, ec)) {
+    const std::string name = entry.path().filename().string();
+    if (name == self_proc_name_ || !entry.is_directory(ec) ||
+        access_list_->checkGlobalRegistry(name))
+      continue;
+    std::ifstream owner(entry.path() / "claimed" / ".owner");
+    uint64_t pid = 0;
+    std::string space;
+    if (!(owner >> pid >> space) || !Utils::isLocalPidSpace(space) ||
+        Utils::isProcessAlive(pid))
+      continue;
+    auto it = dead_inboxes_.find(name);
+    const auto since = it == dead_inboxes_.end() ? now : it->second;
+    if (now - since < retention) {
+      dead.emplace(name, since);
+      continue;
+    }
+    owner.close();
+    std::error_code rec;
+    std::filesystem::remove_all(entry.path(), rec);
+    if (rec) {
+      std::cout << "[WARN]: Unable to remove the inbox of dead process "
+                << name << ": " << rec.message() << "\n";
+      dead.emplace(name, since);
+    } else {
+      std::cout << "[INFO]: Removed the inbox of dead process " << name
+                << "\n";
+      // the frames sent to it went with the inbox, and it comes back with
+      // a new epoch; the channel starts again as if it had never been used
+      const PeerId peer = peers_.intern(name);
+      std::lock_guard<std::mutex> fifo_lock(fifo_mutex_);
+      std::lock_guard<std::mutex> lock(write_mutex_);
+      restartChannelLocked_(peer, 0);
+      peer_epoch_[peer] = 0;
+    }
+  }
+  // owners that came back, or inboxes already gone, are forgotten
+  dead_inboxes_ = std::move(dead);
+}
+
+// Applies flow control for user sends, then hands off to writeLocked_().
+// Frames sent from the watcher (PONG, ACK, CREDIT, RFI results) bypass the
+// ACK window and credit checks; if the watcher could block here it would
+// never process the ACK/CREDIT frames that unblock it.
+bool SPEED::dispatch_(Message &message, PeerId peer, bool flow_controlled) {
+  std::unique_lock<std::mutex> lock(write_mutex_);
+  auto drop = [&]() {
+    metrics_.peer(peer).drops.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  };
+  if (evictedLocked_(peer))
+    return drop();
+  if (flow_controlled) {
+    if (ack_window_ > 0 && !waitForWindow_(lock, peer))
+      return drop();
+    if (isMetered(message.header.type)) {
+      switch (acquireCredit_(lock, peer, message.payload.size())) {
+      case CreditGrant::Granted:
+        break;
+      case CreditGrant::Buffered:
+        credits_.backlog(peer).push_back(message);
+        return true;
+      case CreditGrant::Denied:
+        return drop();
+      }
+    }
+    if (evicted_[peer]) // died while we waited
+      return drop();
+  }
+  return writeLocked_(message, peer) || drop();
+}
+
+// Stamps the next sequence number of the frame's lane, encrypts and writes it.
+// Callers hold write_mutex_, so the header seq and the filename seq always
+// agree even when the watcher and user threads send concurrently. Returns
+// false if the frame could not be written; its seq is then used again by the
+// next frame, so the reciever's lane has no gap to wait on.
+bool SPEED::writeLocked_(Message &message, PeerId peer) {
+  const MessageType type = message.header.type;
+  if (ack_window_ > 0 && type != MessageType::ACK &&
+      type != MessageType::CREDIT)
+    message.header.flags |= FLAG_ACK_REQUESTED;
+  const uint64_t bytes = message.payload.size();
+  const size_t lane = static_cast<size_t>(message.header.priority);
+  long long &seq = send_seq_[peer][lane];
+  message.header.seq_num = seq;
+  message.header.sender = self_proc_name_;
+  // the handshake itself is sealed with the shared key, which is what
+  // authenticates the public keys it carries
+  const PeerSession &session = sessions_[peer];
+  const bool traced = isMetered(type) && tracer_.sampled(seq);
+  const uint64_t encrypt_ns = traced ? Utils::getEpochNanos() : 0;
+  const auto encrypt_start = std::chrono::steady_clock::now();
+  if (session.established && type != MessageType::CON_REQ &&
+      type != MessageType::CON_RES) {
+    message.header.flags |= FLAG_SESSION_KEY;
+    EncryptionManager::Encrypt(message, session.keys.tx);
+  } else {
+    EncryptionManager::Encrypt(message, session_key_);
+  }
+  const auto write_start = std::chrono::steady_clock::now();
+  const uint64_t write_ns = traced ? Utils::getEpochNanos() : 0;
+  uint64_t rename_ns = 0;
+  const bool written = BinaryManager::writeBinary(
+      message, speed_dir_, self_proc_name_, seq, peers_.name(peer),
+      traced ? &rename_ns : nullptr);
+  metrics_.record(Metrics::Histogram::Write,
+                  std::chrono::steady_clock::now() - write_start);
+  metrics_.record(Metrics::Histogram::Encrypt, write_start - encrypt_start);
+  if (!written) {
+    std::cout << "[ERROR]: Unable to write to the inbox of "
+              << peers_.name(peer) << "\n";
+    return false;
+  }
+  if (traced)
+    traceSend_(message, peer, seq, encrypt_ns, write_ns, rename_ns,
+               Utils::getEpochNanos());
+  ++seq;
+  // saved after the write: a crash in between reuses the seq, which the
+  // reciever drops as a duplicate, where saving first would leave a gap
+  // its FIFO waits on forever
+  if (PeerSeqs *saved = persisted_(persisted_tx_, peer))
+    saved->send[lane] = seq;
+  if (isMetered(type))
+    credits_.onSent(peer, bytes);
+  Metrics::Counters &counters = metrics_.peer(peer);
+  counters.sent.fetch_add(1, std::memory_order_relaxed);
+  counters.sent_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  return true;
+}
+
+bool SPEED::onWatcher_() const { return t_watcher_of == this; }
+
+// Returns false if the send has to fail: the window is full and the caller
+// is the watcher (a callback), which cannot wait for the ACKs it would
+// itself process. Other callers send past the window after ack_timeout_.
+bool SPEED::waitForWindow_(std::unique_lock<std::mutex> &lock, PeerId peer) {
+  auto open = [&]() {
+    if (evicted_[peer])
+      return true;
+    const LaneSeqs &sent = send_seq_[peer];
+    const LaneSeqs &acked = acked_seq_[peer];
+    long long unacked = 0;
+    for (size_t lane = 0; lane < kPriorityLanes; ++lane) {
+      unacked += sent[lane] - acked[lane];
+    }
+    return unacked < static_cast<long long>(ack_window_);
+  };
+  if (onWatcher_()) {
+    if (open())
+      return true;
+    std::cout << "[WARN] Process: " << peers_.name(peer)
+              << " has a full ACK window, message from the watcher thread "
+                 "rejected\n";
+    return false;
+  }
+  if (!flow_cv_.wait_for(lock, ack_timeout_, open)) {
+    std::cout << "[WARN] Process: " << peers_.name(peer)
+              << " has not acknowledged for " << ack_timeout_.count()
+              << "ms, sending past the window\n";
+  }
+  return true;
+}
+
+SPEED::CreditGrant SPEED::acquireCredit_(std::unique_lock<std::mutex> &lock,
+                                         PeerId peer, uint64_t bytes) {
+  const std::string &reciever_name = peers_.name(peer);
+  if (!credits_.isKnown(peer)) {
+    // first send to this peer: pick up its advertised limits, if any
+    uint64_t max_messages = 0, max_bytes = 0;
+    CreditLedger::readAdvertisement(speed_dir_ / reciever_name / ".credit",
+                                    max_messages, max_bytes);
+    credits_.setLimits(peer, max_messages, max_bytes);
+  }
+  // anything already queued goes first so per-peer order holds
+  auto ready = [&]() {
+    return evicted_[peer] ||
+           (credits_.backlog(peer).empty() && credits_.canSend(peer, bytes));
+  };
+  if (ready())
+    return CreditGrant::Granted;
+
+  switch (credit_policy_) {
+  case CreditPolicy::Buffer:
+    return CreditGrant::Buffered;
+  case CreditPolicy::Block:
+    if (onWatcher_())
+      break; // the CREDIT frames it waits for are the watcher's to process
+    if (flow_cv_.wait_for(lock, credit_timeout_, ready))
+      return CreditGrant::Granted;
+    std::cout << "[WARN] Process: " << reciever_name
+              << " granted no credit for " << credit_timeout_.count()
+              << "ms, dropping message\n";
+    return CreditGrant::Denied;
+  case CreditPolicy::Fail:
+    break;
+  }
+  std::cout << "[WARN] Process: " << reciever_name
+            << " is out of credit, message rejected\n";
+  return CreditGrant::Denied;
+}
+
+void SPEED::setAckWindow(size_t window, std::chrono::milliseconds timeout) {
+  {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    ack_window_ = window;
+    ack_timeout_ = timeout;
+  }
+  // a larger (or disabled) window may release blocked senders
+  flow_cv_.notify_all();
+}
+
+bool SPEED::flush(const std::string &reciever_name,
+                  std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(write_mutex_);
+  if (ack_window_ == 0) {
+    std::cout << "[WARN]: flush() needs acknowledged delivery, see "
+                 "setAckWindow()\n";
+    return false;
+  }
+  const PeerId peer = peers_.intern(reciever_name);
+  // from a callback only a check: the watcher is what would settle it
+  if (onWatcher_())
+    timeout = std::chrono::milliseconds(0);
+  const bool settled = flow_cv_.wait_for(lock, timeout, [&]() {
+    if (evicted_[peer])
+      return true;
+    const LaneSeqs &sent = send_seq_[peer];
+    const LaneSeqs &acked = acked_seq_[peer];
+    for (size_t lane = 0; lane < kPriorityLanes; ++lane) {
+      if (acked[lane] < sent[lane])
+        return false;
+    }
+    return true;
+  });
+  return settled && !evicted_[peer];
+}
+
+long long SPEED::getAckedCount(const std::string &reciever_name) {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  long long total = 0;
+  for (long long acked : acked_seq_[peers_.intern(reciever_name)]) {
+    total += acked;
+  }
+  return total;
+}
+
+// Advertises how much this process is willing to hold in its inbox per
+// sender. 0 means unlimited for either dimension.
+void SPEED::setInboxLimit(uint64_t max_messages, uint64_t max_bytes) {
+  inbox_max_messages_.store(max_messages);
+  inbox_max_bytes_.store(max_bytes);
+  if (!CreditLedger::writeAdvertisement(self_speed_dir_ / ".credit",
+                                        max_messages, max_bytes)) {
+    std::cout << "[ERROR]: Unable to advertise inbox limit\n";
+  }
+}
+
+void SPEED::setCreditPolicy(CreditPolicy policy,
+                            std::chrono::milliseconds timeout) {
+  {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    credit_policy_ = policy;
+    credit_timeout_ = timeout;
+  }
+  flow_cv_.notify_all();
+}
+
+CreditState SPEED::getCreditState(const std::string &reciever_name) {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  return credits_.state(peers_.intern(reciever_name));
+}
+
+size_t SPEED::getInboxDepth() const { return inbox_depth_.load(); }
+
+// Applies to messages sent and published from now on; 0 turns expiry off.
+void SPEED::setMessageTTL(std::chrono::milliseconds ttl) {
+  message_ttl_ms_.store(std::max<long long>(0, ttl.count()));
+}
+
+uint64_t SPEED::getExpiredCount() const { return expired_count_.load(); }
+
+uint64_t SPEED::getQuarantinedCount() const {
+  return quarantined_count_.load();
+}
+
+void SPEED::setErrorCallback(ErrorCallback cb) {
   std::lock_guard<std::mutex> lock(callback_mutex_);
-  Message msg = BinaryManager::readBinary(file_path);
-  std::vector<uint64_t> k(key_.begin(), key_.end());
-  EncryptionManager::Decrypt(msg, k);
-  if (!Message::validate_message_recieved(msg, self_proc_name_)) {
-    std::cout << "[ERROR]: Invalid Message recieved! Not Processing.\n";
-    Message::print_message(msg);
+  error_callback_ = std::move(cb);
+}
+
+RecoveryStats SPEED::getRecoveryStats() const { return recovery_stats_; }
+
+MetricsSnapshot SPEED::getMetrics() const {
+  MetricsSnapshot snap = metrics_.snapshot(peers_);
+  snap.inbox_depth = inbox_depth_.load();
+  return snap;
+}
+
+void SPEED::setMetricsDump(std::chrono::seconds interval) {
+  metrics_dump_s_.store(std::max<long long>(0, interval.count()));
+}
+
+void SPEED::setTracing(uint32_t sample_every, size_t capacity) {
+  tracer_.enable(sample_every, capacity);
+  trace_epoch_.fetch_add(1, std::memory_order_release);
+}
+
+// trace_found_, emptied first if tracing was set up again since the watcher
+// last used it. Caller holds fifo_mutex_.
+SPEED::TraceFound &SPEED::traceFound_() {
+  const uint64_t epoch = trace_epoch_.load(std::memory_order_acquire);
+  if (epoch != trace_found_epoch_) {
+    trace_found_.clear();
+    trace_found_epoch_ = epoch;
+  }
+  return trace_found_;
+}
+
+bool SPEED::exportTrace(const std::filesystem::path &path) const {
+  std::ofstream out(path, std::ios::trunc);
+  out << tracer_.toJson(peers_, self_proc_name_) << "\n";
+  if (!out) {
+    std::cout << "[ERROR]: Unable to write trace to " << path << "\n";
+    return false;
+  }
+  return true;
+}
+
+MessagePoolStats SPEED::getMessagePoolStats() const {
+  return rx_pool_.stats();
+}
+
+void SPEED::setInboxRetention(std::chrono::seconds retention) {
+  inbox_retention_s_.store(std::max<long long>(0, retention.count()));
+}
+
+// The session stays, so the peer's next key is taken as a re-key and its
+// frames sealed under the old one still open.
+void SPEED::forgetPeerKey(const std::string &name) {
+  if (identity_ && identity_->unpin(name))
+    std::cout << "[INFO]: Forgot the pinned key of " << name << "\n";
+}
+
+// The slot's capability word carries the wire version, so peers can tell an
+// incompatible build apart before sending to it.
+bool SPEED::useProcessTable() {
+  return access_list_->useProcessTable(speed_dir_ / ".process_table",
+                                       SPEED_VERSION);
+}
+
+void SPEED::stampExpiry_(Message &message) const {
+  const long long ttl = message_ttl_ms_.load();
+  message.header.expires_at =
+      ttl > 0 ? Utils::getEpochMillis() + static_cast<uint64_t>(ttl) : 0;
+}
+
+// Sender side of a CREDIT frame: book the reciever's progress, then push out
+// whatever was buffered and now fits.
+void SPEED::handleCredit_(const Message &msg, PeerId peer) {
+  if (msg.payload.size() != 4 * sizeof(uint64_t))
+    return;
+  const uint8_t *p = msg.payload.data();
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  credits_.onCredit(peer, from_big_endian<uint64_t>(p),
+                    from_big_endian<uint64_t>(p + 8),
+                    from_big_endian<uint64_t>(p + 16),
+                    from_big_endian<uint64_t>(p + 24));
+  auto &backlog = credits_.backlog(peer);
+  while (!backlog.empty() &&
+         credits_.canSend(peer, backlog.front().payload.size())) {
+    Message next = std::move(backlog.front());
+    backlog.pop_front();
+    if (!writeLocked_(next, peer))
+      metrics_.peer(peer).drops.fetch_add(1, std::memory_order_relaxed);
+  }
+  flow_cv_.notify_all();
+}
+
+// One cumulative ACK and one CREDIT per sender per watcher pass, however
+// many of its frames were consumed in that pass.
+void SPEED::sendPendingControl_() {
+  for (PeerId sender : ack_due_) {
+    LaneSeqs next_expected{};
+    {
+      std::lock_guard<std::mutex> fifo_lock(fifo_mutex_);
+      const LaneBuffers &buffers = sender_buffers_[sender];
+      for (size_t lane = 0; lane < kPriorityLanes; ++lane) {
+        next_expected[lane] = buffers[lane].next();
+      }
+    }
+    Message ack = Message::construct_ACK(peers_.name(sender), next_expected);
+    dispatch_(ack, sender);
+  }
+  ack_due_.clear();
+
+  const uint64_t max_messages = inbox_max_messages_.load();
+  const uint64_t max_bytes = inbox_max_bytes_.load();
+  for (PeerId sender : credit_due_) {
+    const ConsumedCount &c = consumed_[sender];
+    Message credit = Message::construct_CREDIT(
+        peers_.name(sender), c.messages, c.bytes, max_messages, max_bytes);
+    dispatch_(credit, sender);
+  }
+  credit_due_.clear();
+}
+
+// Counts a metered frame from `sender` as consumed for credit purposes.
+// Small sets of peers owed a control frame this pass; linear search beats
+// hashing at this size.
+static void markDue(std::vector<PeerId> &due, PeerId peer) {
+  if (std::find(due.begin(), due.end(), peer) == due.end())
+    due.push_back(peer);
+}
+
+void SPEED::recordConsumed_(PeerId sender, uint64_t bytes) {
+  ConsumedCount &c = consumed_[sender];
+  ++c.messages;
+  c.bytes += bytes;
+  if (inbox_max_messages_.load() != 0 || inbox_max_bytes_.load() != 0)
+    markDue(credit_due_, sender);
+}
+
+// Saves the lane's new watermark, then deletes the frame. In that order, a
+// crash in between leaves a consumed file behind, which the next scan
+// deletes, rather than a missing seq. `seq` is the one in the frame's name;
+// the header of a shared frame carries none.
+void SPEED::retireFile_(const std::filesystem::path &file_path, PeerId sender,
+                        size_t lane, long long seq) {
+  saveWatermark_(sender, lane, seq);
+  std::error_code ec;
+  std::filesystem::remove(file_path, ec);
+}
+
+// Records that `seq` of `sender`'s `lane` has been consumed.
+void SPEED::saveWatermark_(PeerId sender, size_t lane, long long seq) {
+  if (PeerSeqs *saved = persisted_(persisted_rx_, sender)) {
+    saved->recv[lane] = seq + 1;
+    saved->consumed_messages = consumed_[sender].messages;
+    saved->consumed_bytes = consumed_[sender].bytes;
+  }
+}
+
+// Consumes a frame without delivering it. The seq still advances and the
+// sender still gets its ACK and credit back. Given a `reason`, the file is
+// quarantined rather than deleted.
+void SPEED::discardFrame_(const Message &msg, PeerId sender,
+                          const std::filesystem::path &file_path, size_t lane,
+                          long long seq, std::string_view reason) {
+  if (msg.header.flags & FLAG_ACK_REQUESTED)
+    markDue(ack_due_, sender);
+  if (isMetered(msg.header.type))
+    recordConsumed_(sender,
+                    EncryptionManager::plaintextSize(msg.payload.size()));
+  if (reason.empty()) {
+    metrics_.peer(sender).drops.fetch_add(1, std::memory_order_relaxed);
+    retireFile_(file_path, sender, lane, seq);
+  } else {
+    quarantine_(file_path, sender, reason);
+  }
+}
+
+// Moves a frame that cannot be delivered out of the inbox, next to a
+// <file>.reason record, so its lane moves on. The frame's lane and seq come
+// from its name: its header may be what is broken. Caller holds
+// callback_mutex_.
+void SPEED::quarantine_(const std::filesystem::path &file_path, PeerId sender,
+                        std::string_view reason) {
+  const std::string name = file_path.filename().string();
+  if (const std::optional<FrameName> frame = parseFrameName(name))
+    saveWatermark_(sender, frame->lane, frame->seq);
+
+  const std::filesystem::path dir = speed_dir_ / "quarantine" / self_proc_name_;
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  std::filesystem::rename(file_path, dir / name, ec);
+  if (ec) {
+    // it must leave the inbox either way, or it blocks its lane again
+    std::filesystem::remove(file_path, ec);
+  } else {
+    std::ofstream record(dir / (name + ".reason"));
+    record << "sender: " << peers_.name(sender) << "\nreason: " << reason
+           << "\nquarantined_at_ms: " << Utils::getEpochMillis() << "\n";
+  }
+  quarantined_count_.fetch_add(1);
+  metrics_.peer(sender).drops.fetch_add(1, std::memory_order_relaxed);
+  std::cout << "[ERROR]: Quarantined " << name << " from "
+            << peers_.name(sender) << ": " << reason << "\n";
+  if (error_callback_)
+    error_callback_({peers_.name(sender), dir / name, std::string(reason)});
+}
+
+// Asks `peer` for a handshake, once per kHandshakeTimeout. Returns false
+// once the request has gone unanswered for that long.
+bool SPEED::awaitHandshake_(PeerId peer) {
+  const auto now = std::chrono::steady_clock::now();
+  auto &sent = handshake_sent_[peer];
+  if (sent == std::chrono::steady_clock::time_point{}) {
+    sent = now;
+    Message req = Message::construct_CON_REQ(
+        peers_.name(peer),
+        std::vector<uint8_t>(kx_.public_key.begin(), kx_.public_key.end()),
+        epoch_);
+    dispatch_(req, peer);
+    return true;
+  }
+  if (now - sent < kHandshakeTimeout)
+    return true;
+  sent = {};
+  return false;
+}
+
+// Opens a frame sealed with the session key of `sender`. A frame that
+// overtook the CON_RES establishing its session waits for it. Senders grow
+// sessions_ under write_mutex_, so the session is copied out under it.
+SPEED::SessionOpen SPEED::openSessionFrame_(Message &msg, PeerId sender) {
+  PeerSession session;
+  {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    session = sessions_[sender];
+  }
+  SessionOpen opened = SessionOpen::Unreadable;
+  if (!session.established) {
+    opened = awaitHandshake_(sender) ? SessionOpen::Pending
+                                     : SessionOpen::Unreadable;
+  } else if (!session.has_prev_rx) {
+    if (EncryptionManager::TryDecrypt(msg, session.keys.rx))
+      opened = SessionOpen::Opened;
+  } else {
+    // only until the peer's first frame under its new keys; a failed
+    // attempt wipes the payload
+    const std::vector<uint8_t> sealed = msg.payload;
+    if (EncryptionManager::TryDecrypt(msg, session.keys.rx)) {
+      opened = SessionOpen::Opened;
+      std::lock_guard<std::mutex> lock(write_mutex_);
+      PeerSession &current = sessions_[sender];
+      if (current.keys.rx == session.keys.rx) // not re-keyed meanwhile
+        current.has_prev_rx = false;
+    } else {
+      msg.payload = sealed;
+      if (EncryptionManager::TryDecrypt(msg, session.prev_rx))
+        opened = SessionOpen::Opened;
+    }
+  }
+  sodium_memzero(&session, sizeof(session));
+  return opened;
+}
+
+// CON_REQ and CON_RES both carry the sender's public key and restart
+// epoch. The first key a peer presents is pinned; a handshake with any
+// other key is refused unanswered, since anyone with the shared key can
+// send one. Keys are derived once per peer key, and the old rx key is kept
+// for frames the peer sealed before a re-key. A new epoch restarts the
+// channel before the CON_RES goes out, so the reply is its first frame.
+// Caller holds fifo_mutex_.
+void SPEED::handleHandshake_(const Message &msg, PeerId peer) {
+  if (msg.payload.size() != crypto_kx_PUBLICKEYBYTES + sizeof(uint64_t)) {
+    std::cout << "[WARN]: Malformed handshake from " << msg.header.sender
+              << "\n";
+    return;
+  }
+  EncryptionManager::PublicKey peer_key;
+  std::copy_n(msg.payload.begin(), crypto_kx_PUBLICKEYBYTES, peer_key.begin());
+  const uint64_t epoch = from_big_endian<uint64_t>(msg.payload.data() +
+                                                   crypto_kx_PUBLICKEYBYTES);
+
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  const std::string &name = peers_.name(peer);
+  EncryptionManager::PublicKey pinned_key;
+  const bool pinned = identity_ && identity_->pinned(name, pinned_key);
+  if (pinned && pinned_key != peer_key) {
+    std::cout << "[WARN]: Refused a handshake from " << name
+              << ": its public key is not the pinned one\n";
     return;
   }
+  PeerSession &session = sessions_[peer];
+  if (!session.established || session.peer_key != peer_key) {
+    EncryptionManager::SessionKeys keys;
+    // the smaller name takes the client role, so both ends agree on it
+    if (!EncryptionManager::deriveSessionKeys(
+            kx_, peer_key, self_proc_name_ < name, keys)) {
+      std::cout << "[WARN]: Rejected the public key of " << msg.header.sender
+                << "\n";
+      return;
+    }
+    session.has_prev_rx = session.established;
+    session.prev_rx = session.keys.rx;
+    session.keys = keys;
+    session.peer_key = peer_key;
+    session.established = true;
+    handshake_sent_[peer] = {};
+    std::cout << "[INFO]: Session established with " << msg.header.sender
+              << "\n";
+  }
+  if (identity_ && !pinned)
+    identity_->pin(name, peer_key);
+  uint64_t &known = peer_epoch_[peer];
+  if (epoch != 0 && epoch != known) {
+    if (known != 0) {
+      std::cout << "[INFO]: " << name
+                << " lost its sequence state, its channel starts again at "
+                   "seq 0\n";
+      restartChannelLocked_(peer, msg.header.seq_num);
+    }
+    known = epoch;
+    if (PeerSeqs *saved = persisted_(persisted_tx_, peer))
+      saved->epoch = epoch;
+  }
+  // answered under the same lock, so the CON_RES is on disk before any
+  // frame sealed with the new keys
+  if (msg.header.type == MessageType::CON_REQ && !evictedLocked_(peer)) {
+    Message res = Message::construct_CON_RES(
+        name,
+        std::vector<uint8_t>(kx_.public_key.begin(), kx_.public_key.end()),
+        epoch_);
+    writeLocked_(res, peer);
+  }
+}
+
+// Starts the channel with `peer` again from seq 0 in both directions, for
+// a peer that lost its state; its Control lane resumes at `control_next`.
+// Frames already buffered are dropped from the buffers, and indexed again
+// from disk under the new watermarks. Frames we sent it before count as
+// acknowledged. Caller holds fifo_mutex_ and write_mutex_.
+void SPEED::restartChannelLocked_(PeerId peer, long long control_next) {
+  constexpr size_t kControl = static_cast<size_t>(Priority::Control);
+  LaneBuffers &buffers = sender_buffers_[peer];
+  for (size_t lane = 0; lane < kPriorityLanes; ++lane) {
+    send_seq_[peer][lane] = 0;
+    acked_seq_[peer][lane] = 0;
+    buffers[lane].reset(lane == kControl ? control_next : 0);
+    gap_counted_[peer][lane] = 0;
+  }
+  consumed_[peer] = {};
+  credits_.restart(peer);
+  if (PeerSeqs *saved = persisted_(persisted_tx_, peer)) {
+    *saved = PeerSeqs{};
+    saved->recv[kControl] = control_next;
+  }
+  inbox_->touch(peers_.name(peer));
+  flow_cv_.notify_all();
+}
+
+// `sender`, `lane` and `seq` come from the filename; the header copy of the
+// sender is encrypted until the frame is decrypted and must then agree with
+// it. Multicast and PUBLISH frames are shared by every reciever, so only the
+// filename carries this reciever's seq. Returns false if the frame has to
+// stay in the inbox until a later pass.
+bool SPEED::processFile_(const std::filesystem::path &file_path, PeerId sender,
+                         size_t lane, long long seq) {
+  std::lock_guard<std::mutex> lock(callback_mutex_);
+  const uint64_t read_ns = tracer_.enabled() ? Utils::getEpochNanos() : 0;
+  MessagePool::Lease lease;
+  try {
+    lease = BinaryManager::readBinary(file_path, rx_pool_);
+  } catch (const std::exception &e) {
+    quarantine_(file_path, sender, e.what());
+    return true;
+  }
+  Message &msg = *lease;
+  const bool traced =
+      read_ns != 0 && isMetered(msg.header.type) && tracer_.sampled(seq);
+  const uint64_t decrypt_ns = traced ? Utils::getEpochNanos() : 0;
+
+  // Expired frames are shed on the clear header alone.
+  if (msg.header.expires_at != 0 &&
+      Utils::getEpochMillis() > msg.header.expires_at) {
+    expired_count_.fetch_add(1);
+    discardFrame_(msg, sender, file_path, lane, seq);
+    return true;
+  }
+
+  const auto decrypt_start = std::chrono::steady_clock::now();
+  if (msg.header.flags & FLAG_SESSION_KEY) {
+    switch (openSessionFrame_(msg, sender)) {
+    case SessionOpen::Opened:
+      break;
+    case SessionOpen::Pending:
+      return false;
+    case SessionOpen::Unreadable:
+      discardFrame_(msg, sender, file_path, lane, seq,
+                    "no session key opens it");
+      return true;
+    }
+  } else if (!EncryptionManager::TryDecrypt(msg, session_key_)) {
+    discardFrame_(msg, sender, file_path, lane, seq, "decryption failed");
+    return true;
+  }
+  metrics_.record(Metrics::Histogram::Decrypt,
+                  std::chrono::steady_clock::now() - decrypt_start);
+  if (traced) {
+    // recorded once the frame is open, so a frame waiting on a handshake
+    // is not traced twice
+    TraceFound &trace_found = traceFound_();
+    const auto found = trace_found.find({sender, lane, seq});
+    if (found != trace_found.end())
+      tracer_.record(TraceStage::Queued, sender, lane, seq, found->second,
+                     read_ns);
+    tracer_.record(TraceStage::Read, sender, lane, seq, read_ns, decrypt_ns);
+    tracer_.record(TraceStage::Decrypt, sender, lane, seq, decrypt_ns,
+                   Utils::getEpochNanos());
+  }
+  if (msg.header.flags & FLAG_ACK_REQUESTED)
+    markDue(ack_due_, sender);
+  if (isMetered(msg.header.type))
+    recordConsumed_(sender, msg.payload.size());
+  if (!Message::validate_message_recieved(msg, self_proc_name_) ||
+      msg.header.sender != peers_.name(sender)) {
+    quarantine_(file_path, sender, "invalid header");
+    return true;
+  }
+  Metrics::Counters &counters = metrics_.peer(sender);
+  counters.received.fetch_add(1, std::memory_order_relaxed);
+  counters.received_bytes.fetch_add(msg.payload.size(),
+                                    std::memory_order_relaxed);
+  traced_frame_ = {traced, sender, lane, seq};
+  try {
+    handleFrame_(msg, sender);
+  } catch (const std::exception &e) {
+    traced_frame_.active = false;
+    quarantine_(file_path, sender,
+                std::string("handler failed: ") + e.what());
+    return true;
+  }
+  traced_frame_.active = false;
+  retireFile_(file_path, sender, lane, seq);
+  return true;
+}
+
+// Records the send-side stages of a sampled frame. The send began when the
+// message was constructed; a zero `rename_ns` means the frame was linked
+// into place rather than renamed.
+void SPEED::traceSend_(const Message &message, PeerId peer, long long seq,
+                       uint64_t encrypt_ns, uint64_t write_ns,
+                       uint64_t rename_ns, uint64_t done_ns) {
+  const size_t lane = static_cast<size_t>(message.header.priority);
+  tracer_.record(TraceStage::Send, peer, lane, seq, message.header.timestamp,
+                 done_ns);
+  tracer_.record(TraceStage::Encrypt, peer, lane, seq, encrypt_ns, write_ns);
+  tracer_.record(TraceStage::Write, peer, lane, seq, write_ns,
+                 rename_ns != 0 ? rename_ns : done_ns);
+  if (rename_ns != 0)
+    tracer_.record(TraceStage::Rename, peer, lane, seq, rename_ns, done_ns);
+}
+
+// Hands delivered_ to the user callback. End-to-end latency runs from the
+// sender's header timestamp, so it includes any clock skew between hosts.
+void SPEED::deliver_() {
+  const uint64_t now = Utils::getEpochNanos();
+  if (now > delivered_.timestamp)
+    metrics_.record(Metrics::Histogram::EndToEnd,
+                    std::chrono::nanoseconds(now - delivered_.timestamp));
+  callback_(delivered_);
+  if (traced_frame_.active)
+    tracer_.record(TraceStage::Callback, traced_frame_.sender,
+                   traced_frame_.lane, traced_frame_.seq, now,
+                   Utils::getEpochNanos());
+}
+
+// Acts on a frame that has been opened and validated.
+void SPEED::handleFrame_(Message &msg, PeerId sender) {
   switch (msg.header.type) {
   case MessageType::MSG: {
-    PMessage mm = Message::destruct_message(msg);
-    callback_(mm);
+    Message::destruct_message(msg, delivered_);
+    deliver_();
     break;
   }
   case MessageType::EXIT_NOTIF: {
@@ -172,8 +1344,9 @@ void SPEED::processFile_(const std::filesystem::path &file_path) {
     access_list_->removeProcessFromConnectedList(msg.header.sender);
     break;
   }
-  case MessageType::CON_REQ: {
-    std::cout << "[INFO]: Recieved CON_REQ from: " << msg.header.sender << "\n";
+  case MessageType::CON_REQ:
+  case MessageType::CON_RES: {
+    handleHandshake_(msg, sender);
     break;
   }
   case MessageType::PING: {
@@ -183,15 +1356,53 @@ void SPEED::processFile_(const std::filesystem::path &file_path) {
     break;
   }
   case MessageType::PONG: {
-    PMessage mm = Message::destruct_message(msg);
-    callback_(mm);
+    Message::destruct_message(msg, delivered_);
+    deliver_();
     break;
   }
+  case MessageType::PUBLISH: {
+    Message::destruct_PUBLISH(msg, delivered_);
+    // a late frame for a topic we already left is dropped quietly
+    if (topic_registry_->getSubscriptions().count(delivered_.topic))
+      deliver_();
+    break;
   }
-  std::filesystem::remove(file_path, ec);
-  {
-    std::lock_guard<std::mutex> lock(seen_mutex_);
-    seen_.erase(file_path.filename().string());
+  case MessageType::ACK: {
+    if (msg.payload.size() == kPriorityLanes * sizeof(uint64_t)) {
+      std::lock_guard<std::mutex> write_lock(write_mutex_);
+      LaneSeqs &acked = acked_seq_[sender];
+      for (size_t lane = 0; lane < kPriorityLanes; ++lane) {
+        const long long upto = static_cast<long long>(
+            from_big_endian<uint64_t>(msg.payload.data() + 8 * lane));
+        acked[lane] = std::max(acked[lane], upto);
+      }
+    }
+    flow_cv_.notify_all();
+    break;
+  }
+  case MessageType::CREDIT: {
+    handleCredit_(msg, sender);
+    break;
+  }
+  case MessageType::INVOKE_METHOD: {
+    handleInvokeBatch_(msg);
+    break;
+  }
+  case MessageType::INVOKE_RESULT: {
+    std::vector<InvokeResult> results;
+    try {
+      results = RemoteInvocation::decodeResults(msg.payload);
+    } catch (const std::exception &e) {
+      std::cerr << "[ERROR]: Malformed INVOKE_RESULT from "
+                << msg.header.sender << ": " << e.what() << "\n";
+      break;
+    }
+    if (invoke_result_callback_)
+      invoke_result_callback_(msg.header.sender, results);
+    break;
+  }
+  default:
+    break;
   }
 }
 void SPEED::watcherSingleThread_() {
@@ -202,100 +1413,444 @@ void SPEED::watcherMultiThread_() {
   runWatcherLoop_(); // Non-blocking because start() already spawns thread
 }
 
-std::optional<SPEED::ParsedFileInfo>
-SPEED::extractFileInfoFromFilename_(const std::filesystem::path &path) const {
-  static const std::regex re(
-      R"((\d+)_([A-Za-z0-9_]+)_(\d+)_([A-Za-z0-9-]+)\.ospeed)");
-  std::smatch m;
-  std::string filename = path.filename().string();
-  if (std::regex_match(filename, m, re)) {
-    try {
-      return ParsedFileInfo{m[2].str(),             // proc_name
-                            std::stoll(m[3].str()), // seq
-                            path};
-    } catch (...) {
-      return std::nullopt;
+// Processes ready frames of one lane, taking one frame per sender in turn so
+// a single busy sender cannot starve the others. Stops after `budget` frames
+// and returns how many were processed. Caller holds fifo_mutex_.
+size_t SPEED::drainLane_(size_t lane, size_t budget) {
+  size_t processed = 0;
+  bool progress = true;
+  while (progress && processed < budget) {
+    progress = false;
+    for (PeerId sender = 0; sender < sender_buffers_.size(); ++sender) {
+      ReorderBuffer &buffer = sender_buffers_[sender][lane];
+      const std::string *file = buffer.front();
+      if (file == nullptr)
+        continue;
+      const long long seq = buffer.next();
+      // a frame waiting on a handshake holds back the rest of its lane
+      if (!processFile_(BinaryManager::shardPath(speed_dir_, self_proc_name_,
+                                                 peers_.name(sender)) /
+                            *file,
+                        sender, lane, seq))
+        continue;
+      buffer.pop();
+      if (TraceFound &trace_found = traceFound_(); !trace_found.empty())
+        trace_found.erase({sender, lane, seq});
+      progress = true;
+      if (++processed >= budget)
+        break;
     }
   }
-  return std::nullopt;
+  return processed;
 }
-void SPEED::runWatcherLoop_() {
-  while (!watcher_should_exit_.load()) {
-    // Scan all new files
-    for (auto &entry : std::filesystem::directory_iterator(self_speed_dir_)) {
-      if (!entry.is_regular_file())
-        continue;
 
-      auto info = extractFileInfoFromFilename_(entry.path());
-      if (!info.has_value())
-        continue;
+// Buffers the frame `name` for its lane. A frame below the lane's
+// watermark that is still on disk was left over from a crash before it was
+// removed, or carries a seq reused by a sender that crashed, unless its
+// sender lost its state and started again at seq 0; settleConsumed_()
+// tells these apart. Caller holds fifo_mutex_.
+ReorderBuffer::InsertResult SPEED::indexFrame_(const FrameName &frame,
+                                              std::string_view name) {
+  const PeerId sender = peers_.intern(frame.sender);
+  const ReorderBuffer::InsertResult result =
+      sender_buffers_[sender][frame.lane].insert(frame.seq, name);
+  if (result == ReorderBuffer::InsertResult::Consumed)
+    consumed_found_.push_back(
+        {sender, frame.lane, frame.seq, std::string(name)});
+  if (result == ReorderBuffer::InsertResult::Buffered &&
+      tracer_.sampled(frame.seq))
+    traceFound_().emplace(std::make_tuple(sender, frame.lane, frame.seq),
+                          Utils::getEpochNanos());
+  return result;
+}
+
+// Deletes the frames the last scan found below their lane's watermark. A
+// handshake among them may come from a peer that lost its state, restarted
+// its seqs at 0 and sent it first; it is replayed before the rest are
+// judged, so that peer's frames are buffered under its new numbering
+// rather than deleted. Runs after the Control lane was drained, which
+// handles such a handshake if it was not below the watermark. Caller holds
+// fifo_mutex_.
+void SPEED::settleConsumed_() {
+  if (consumed_found_.empty())
+    return;
+  for (const ConsumedFrame &frame : consumed_found_) {
+    if (frame.lane == static_cast<size_t>(Priority::Control))
+      replayHandshake_(frame.sender, frame.seq, frame.name);
+  }
+  for (const ConsumedFrame &frame : consumed_found_) {
+    const std::string &shard = peers_.name(frame.sender);
+    if (sender_buffers_[frame.sender][frame.lane].insert(
+            frame.seq, frame.name) == ReorderBuffer::InsertResult::Consumed) {
+      std::error_code ec;
+      std::filesystem::remove(self_speed_dir_ / shard / frame.name, ec);
+    } else {
+      inbox_->touch(shard); // counted as pending again
+    }
+  }
+  consumed_found_.clear();
+}
 
-      const std::string fname = entry.path().filename().string();
+// Handles the handshake `name` that arrived below the Control lane's
+// watermark if it carries a new epoch for its sender, which then resumes
+// the lane after it. Any other frame is left for settleConsumed_() to
+// delete. Caller holds fifo_mutex_.
+void SPEED::replayHandshake_(PeerId sender, long long seq,
+                             const std::string &name) {
+  const std::filesystem::path file =
+      self_speed_dir_ / peers_.name(sender) / name;
+  MessagePool::Lease lease;
+  try {
+    lease = BinaryManager::readBinary(file, rx_pool_);
+  } catch (const std::exception &) {
+    return;
+  }
+  Message &msg = *lease;
+  if ((msg.header.type != MessageType::CON_REQ &&
+       msg.header.type != MessageType::CON_RES) ||
+      (msg.header.flags & FLAG_SESSION_KEY) ||
+      !EncryptionManager::TryDecrypt(msg, session_key_) ||
+      !Message::validate_message_recieved(msg, self_proc_name_) ||
+      msg.header.sender != peers_.name(sender) ||
+      msg.payload.size() != crypto_kx_PUBLICKEYBYTES + sizeof(uint64_t))
+    return;
+  const uint64_t epoch = from_big_endian<uint64_t>(msg.payload.data() +
+                                                   crypto_kx_PUBLICKEYBYTES);
+  {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    const uint64_t known = peer_epoch_[sender];
+    if (known == 0 || epoch == known)
+      return;
+  }
+  handleHandshake_(msg, sender);
+  ReorderBuffer &control =
+      sender_buffers_[sender][static_cast<size_t>(Priority::Control)];
+  if (control.next() == seq) { // the channel restarted at it
+    control.pop();
+    retireFile_(file, sender, static_cast<size_t>(Priority::Control), seq);
+  }
+}
 
-      {
-        std::lock_guard<std::mutex> seen_lock(seen_mutex_);
-        if (seen_.count(fname))
-          continue;
-        seen_.insert(fname);
+// Publishes how many frames the reorder buffers hold, and counts each lane
+// that holds frames but is missing the one due next. A lane is counted once
+// per missing seq, however many passes it stays stalled on it. Caller holds
+// fifo_mutex_.
+void SPEED::sampleReorder_() {
+  uint64_t depth = 0;
+  for (PeerId sender = 0; sender < sender_buffers_.size(); ++sender) {
+    LaneBuffers &buffers = sender_buffers_[sender];
+    for (size_t lane = 0; lane < kPriorityLanes; ++lane) {
+      const ReorderBuffer &buffer = buffers[lane];
+      depth += buffer.size();
+      if (buffer.size() == 0 || buffer.front() != nullptr)
+        continue;
+      long long &counted = gap_counted_[sender][lane];
+      if (counted != buffer.next() + 1) {
+        counted = buffer.next() + 1;
+        metrics_.peer(sender).gaps.fetch_add(1, std::memory_order_relaxed);
       }
+    }
+  }
+  metrics_.setReorderDepth(depth);
+}
 
-      std::lock_guard<std::mutex> fifo_lock(fifo_mutex_);
-      sender_buffers_[info->proc_name][info->seq] = entry.path();
-      if (!next_expected_seq_.count(info->proc_name))
-        next_expected_seq_[info->proc_name] = 0;
+// Writes the metrics snapshot to <speed_dir>/metrics/<name>.json when a dump
+// is due. The file is replaced by a rename, so readers never see half of
+// it. Watcher only.
+void SPEED::dumpMetrics_() {
+  const long long interval = metrics_dump_s_.load();
+  const auto now = std::chrono::steady_clock::now();
+  if (interval == 0 ||
+      now - last_metrics_dump_ < std::chrono::seconds(interval))
+    return;
+  last_metrics_dump_ = now;
+
+  const std::filesystem::path dir = speed_dir_ / "metrics";
+  const std::filesystem::path file = dir / (self_proc_name_ + ".json");
+  const std::filesystem::path tmp = dir / (self_proc_name_ + ".json.tmp");
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    out << getMetrics().toJson() << "\n";
+    if (!out) {
+      std::cout << "[WARN]: Unable to write metrics to " << tmp << "\n";
+      return;
     }
+  }
+  std::filesystem::rename(tmp, file, ec);
+  if (ec)
+    std::cout << "[WARN]: Unable to publish metrics: " << ec.message()
+              << "\n";
+}
+
+// True if `file` was last written more than `age` ago.
+static bool olderThan(const std::filesystem::path &file,
+                      std::chrono::seconds age) {
+  std::error_code ec;
+  const auto mtime = std::filesystem::last_write_time(file, ec);
+  return !ec && std::filesystem::file_time_type::clock::now() - mtime > age;
+}
+
+// Deletes the .ispeed files in `dir` older than `age`. Returns how many
+// were removed.
+static size_t removeOrphans(const std::filesystem::path &dir,
+                            std::chrono::seconds age) {
+  size_t removed = 0;
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+    if (entry.path().extension() == ".ispeed" &&
+        olderThan(entry.path(), age) &&
+        std::filesystem::remove(entry.path(), ec))
+      ++removed;
+  }
+  return removed;
+}
+
+// Runs once, before the watcher starts. The backlog an earlier instance left
+// in the inbox is listed on several threads at once and buffered, so the
+// first watcher pass can deliver it straight away. Files that writers
+// abandoned half-written are deleted: in the inbox, in the shared .outbox
+// and in the work queues.
+void SPEED::recover_() {
+  if (recovered_)
+    return;
+  recovered_ = true;
+  const auto started = std::chrono::steady_clock::now();
+
+  std::atomic<size_t> frames{0};
+  std::atomic<size_t> orphans{0};
+  std::vector<std::string> deferred;
+  const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  const size_t shards = inbox_->scanParallel(
+      [&](std::string_view shard, std::string_view name) {
+        if (name.ends_with(".ispeed")) {
+          const std::filesystem::path file =
+              self_speed_dir_ / std::string(shard) / std::string(name);
+          std::error_code ec;
+          if (olderThan(file, kOrphanAge) &&
+              std::filesystem::remove(file, ec))
+            ++orphans;
+          return false;
+        }
+        // parsed on the listing thread; only the insert is serialised
+        const std::optional<FrameName> frame = parseFrameName(name);
+        if (!frame.has_value() || frame->sender != shard)
+          return false;
+        std::lock_guard<std::mutex> fifo_lock(fifo_mutex_);
+        const ReorderBuffer::InsertResult result = indexFrame_(*frame, name);
+        if (result == ReorderBuffer::InsertResult::Buffered)
+          ++frames;
+        if (result == ReorderBuffer::InsertResult::OutOfWindow)
+          deferred.emplace_back(shard);
+        return result != ReorderBuffer::InsertResult::Consumed;
+      },
+      threads);
+  // frames beyond a reorder window are picked up once the window moves
+  for (const std::string &shard : deferred)
+    inbox_->touch(shard);
+  inbox_depth_.store(inbox_->pending());
+
+  orphans += removeOrphans(speed_dir_ / ".outbox", kOrphanAge);
+  std::error_code ec;
+  for (const auto &queue :
+       std::filesystem::directory_iterator(speed_dir_ / "queues", ec)) {
+    if (queue.is_directory(ec))
+      orphans += removeOrphans(queue.path(), kOrphanAge);
+  }
+
+  recovery_stats_.shards = shards;
+  recovery_stats_.frames = frames.load();
+  recovery_stats_.orphans = orphans.load();
+  recovery_stats_.elapsed =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - started);
+  std::cout << "[INFO]: Recovered " << recovery_stats_.frames
+            << " frames from " << shards << " shards and removed "
+            << recovery_stats_.orphans << " orphaned files in "
+            << recovery_stats_.elapsed.count() / 1000.0 << " ms\n";
+}
 
-    // Try to process one file per sender if ready
+void SPEED::runWatcherLoop_() {
+  t_watcher_of = this;
+  while (!watcher_should_exit_.load()) {
+    // Scan the shards that changed. `pending` counts frames on disk that are
+    // not yet consumed, including those beyond a reorder window. Frames below
+    // a lane's watermark were already handled and frames already buffered
+    // are rejected by the buffer itself, so no set of seen names is needed.
+    size_t pending = 0;
+    bool deferred = false;
     {
       std::lock_guard<std::mutex> fifo_lock(fifo_mutex_);
-      for (auto &[sender, buffer] : sender_buffers_) {
-        auto expected_seq = next_expected_seq_[sender];
-        auto it = buffer.find(expected_seq);
-        if (it != buffer.end()) {
-          processFile_(it->second);
-          buffer.erase(it);
-          next_expected_seq_[sender] = expected_seq + 1;
+      const auto scan_start = std::chrono::steady_clock::now();
+      inbox_->scan([&](std::string_view shard, std::string_view name) {
+        const std::optional<FrameName> frame = parseFrameName(name);
+        if (!frame.has_value() || frame->sender != shard)
+          return false;
+        const ReorderBuffer::InsertResult result = indexFrame_(*frame, name);
+        if (result == ReorderBuffer::InsertResult::OutOfWindow) {
+          deferred = true;
+          inbox_->touch(shard);
         }
+        return result != ReorderBuffer::InsertResult::Consumed;
+      });
+      pending = inbox_->pending();
+      metrics_.record(Metrics::Histogram::Scan,
+                      std::chrono::steady_clock::now() - scan_start);
+    }
+
+    // Drain lanes highest first. Control is always emptied; the data lanes
+    // share a budget and the loop comes straight back for a rescan when it
+    // runs out, so a PING never waits behind more than one budget of data.
+    bool budget_exhausted = false;
+    size_t processed = 0;
+    {
+      std::lock_guard<std::mutex> fifo_lock(fifo_mutex_);
+      processed = drainLane_(static_cast<size_t>(Priority::Control), SIZE_MAX);
+      settleConsumed_();
+      size_t budget = kLaneDrainBudget;
+      for (size_t lane = static_cast<size_t>(Priority::Control) + 1;
+           lane < kPriorityLanes && budget > 0; ++lane) {
+        const size_t drained = drainLane_(lane, budget);
+        budget -= drained;
+        processed += drained;
       }
+      budget_exhausted = budget == 0;
+      sampleReorder_();
     }
+    inbox_depth_.store(pending - std::min(pending, processed));
+    if (!ack_due_.empty() || !credit_due_.empty())
+      sendPendingControl_();
+    dumpMetrics_();
+
+    // pick up membership and subscriber changes off the send path
+    access_list_->refresh();
+    for (const std::string &name : access_list_->evictDeadPeers())
+      forgetPeer_(name);
+    collectDeadInboxes_();
+    topic_registry_->refresh();
+
+    // keep draining work queues without sleeping while jobs are flowing
+    // frames left out of a full reorder window can be buffered now that the
+    // window has moved
+    if (serveQueues_() > 0 || budget_exhausted || (deferred && processed > 0))
+      continue;
 
     std::this_thread::sleep_for(std::chrono::milliseconds(200));
   }
+  t_watcher_of = nullptr;
 }
 
 void SPEED::ping(const std::string &reciever_name) { ping_(reciever_name); }
 void SPEED::pong(const std::string &reciever_name) { pong_(reciever_name); }
 void SPEED::ping_(const std::string &reciever_name) {
   Message ping_message = Message::construct_PING(reciever_name);
-  ping_message.header.seq_num = seq_number_;
-  ping_message.header.sender = self_proc_name_;
-  std::vector<uint64_t> k(key_.begin(), key_.end());
-  EncryptionManager::Encrypt(ping_message, k);
-  BinaryManager::writeBinary(ping_message, speed_dir_, seq_number_,
-                             reciever_name);
-  seq_number_.fetch_add(1, std::memory_order_relaxed);
+  dispatch_(ping_message, peers_.intern(reciever_name));
 }
 void SPEED::pong_(const std::string &reciever_name) {
   Message pong_message = Message::construct_PONG(reciever_name);
-  pong_message.header.seq_num = seq_number_;
-  pong_message.header.sender = self_proc_name_;
   std::cout << "\n[INFO]: Sending a PONG to: " << reciever_name << "\n";
-  std::vector<uint64_t> k(key_.begin(), key_.end());
-  EncryptionManager::Encrypt(pong_message, k);
-  BinaryManager::writeBinary(pong_message, speed_dir_, seq_number_,
-                             reciever_name);
-  seq_number_.fetch_add(1, std::memory_order_relaxed);
+  dispatch_(pong_message, peers_.intern(reciever_name));
 }
 void SPEED::registerMethod(const std::string &name, RemoteFunction func) {
+  std::unique_lock<std::shared_mutex> lock(rfi_mutex_);
   function_registry_[name] = std::move(func);
 }
 void SPEED::invokeMethod(const std::string &name,
                          const std::vector<std::string> &args) {
-  if (function_registry_.count(name)) {
-    function_registry_[name](args);
-  } else {
+  InvokeResult res = runRegisteredMethod_({name, args});
+  if (res.status == InvokeStatus::NOT_FOUND) {
     std::cerr << "[ERROR] Method '" << name << "' not found.\n";
   }
 }
+void SPEED::invokeMethod(const std::string &name,
+                         const std::string &reciever_name,
+                         const std::vector<std::string> &args) {
+  invokeBatch(reciever_name, {InvokeCall{name, args}});
+}
+void SPEED::invokeBatch(const std::string &reciever_name,
+                        const std::vector<InvokeCall> &calls) {
+  if (calls.empty())
+    return;
+  if (!access_list_->checkAccess(reciever_name)) {
+    std::cout << "[WARN] Process: " << reciever_name << " not in access list"
+              << "\n";
+  }
+  Message message = Message::construct_INVOKE_METHOD("", reciever_name);
+  message.payload = RemoteInvocation::encodeBatch(calls);
+  dispatch_(message, peers_.intern(reciever_name));
+}
+void SPEED::setRFIWorkers(size_t workers) {
+  std::lock_guard<std::mutex> lock(rfi_pool_mutex_);
+  rfi_workers_ = std::max<size_t>(1, workers);
+  // the next batch lazily rebuilds the pool with the new size
+  rfi_pool_.reset();
+}
+void SPEED::setInvokeResultCallback(InvokeResultCallback cb) {
+  std::lock_guard<std::mutex> lock(callback_mutex_);
+  invoke_result_callback_ = std::move(cb);
+}
+
+// Looks the method up under a shared lock and runs it outside the lock, so
+// registerMethod() is never blocked behind a long-running remote call.
+InvokeResult SPEED::runRegisteredMethod_(const InvokeCall &call) {
+  RemoteFunction fn;
+  {
+    std::shared_lock<std::shared_mutex> lock(rfi_mutex_);
+    auto it = function_registry_.find(call.method);
+    if (it == function_registry_.end())
+      return {call.method, InvokeStatus::NOT_FOUND, "method not registered"};
+    fn = it->second;
+  }
+  try {
+    fn(call.args);
+  } catch (const std::exception &e) {
+    return {call.method, InvokeStatus::FAILED, e.what()};
+  } catch (...) {
+    return {call.method, InvokeStatus::FAILED, "unknown exception"};
+  }
+  return {call.method, InvokeStatus::OK, ""};
+}
+
+// Hands the calls of a batch to the RFI pool and returns, so a long call
+// never holds up the watcher. The worker that finishes the last call sends
+// the INVOKE_RESULT. The batch is shared by its tasks and owns the calls.
+void SPEED::handleInvokeBatch_(const Message &msg) {
+  struct Batch {
+    std::string sender;
+    std::vector<InvokeCall> calls;
+    std::vector<InvokeResult> results;
+    std::atomic<size_t> remaining{0};
+  };
+  auto batch = std::make_shared<Batch>();
+  try {
+    batch->calls = RemoteInvocation::decodeBatch(msg.payload);
+  } catch (const std::exception &e) {
+    std::cerr << "[ERROR]: Malformed INVOKE_METHOD from " << msg.header.sender
+              << ": " << e.what() << "\n";
+    return;
+  }
+  if (batch->calls.empty())
+    return;
+  batch->sender = msg.header.sender;
+  batch->results.resize(batch->calls.size());
+  batch->remaining.store(batch->calls.size());
+
+  std::lock_guard<std::mutex> lock(rfi_pool_mutex_);
+  if (!rfi_pool_)
+    rfi_pool_ = std::make_unique<ThreadPool>(rfi_workers_);
+  for (size_t i = 0; i < batch->calls.size(); ++i) {
+    rfi_pool_->submit([this, batch, i]() {
+      t_watcher_of = this;
+      batch->results[i] = runRegisteredMethod_(batch->calls[i]);
+      if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        Message response = Message::construct_INVOKE_RESULT(batch->sender);
+        response.payload = RemoteInvocation::encodeResults(batch->results);
+        dispatch_(response, peers_.intern(batch->sender));
+      }
+      t_watcher_of = nullptr;
+    });
+  }
+}
 
 } // namespace SPEED
@@ -0,0 +1,114 @@
+#include "../include/SeqState.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sodium.h>
+#include <stdexcept>
+#include <string>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace SPEED {
+
+namespace {
+constexpr uint64_t kStateMagic = 0x5350454544535131ull; // "SPEEDSQ1"
+}
+
+std::filesystem::path SeqState::pathFor(const std::filesystem::path &speed_dir,
+                                        std::string_view proc) {
+  return speed_dir / "seqstate" / (std::string(proc) + ".seqstate");
+}
+
+uint64_t SeqState::newEpoch() {
+  uint64_t epoch = 0;
+  while (epoch == 0)
+    randombytes_buf(&epoch, sizeof(epoch));
+  return epoch;
+}
+
+SeqState::SeqState(const std::filesystem::path &path) {
+#if defined(__unix__) || defined(__APPLE__)
+  map_size_ = sizeof(Header) + kSlots * sizeof(Slot);
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0)
+    throw std::runtime_error("Unable to open sequence state: " +
+                             std::string(std::strerror(errno)));
+  // a fresh file is zero-filled, and zero is a state with no peers
+  if (::lseek(fd, 0, SEEK_END) < static_cast<off_t>(map_size_) &&
+      ::ftruncate(fd, static_cast<off_t>(map_size_)) != 0) {
+    const int err = errno;
+    ::close(fd);
+    throw std::runtime_error("Unable to size sequence state: " +
+                             std::string(std::strerror(err)));
+  }
+  map_ = ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    throw std::runtime_error("Unable to map sequence state: " +
+                             std::string(std::strerror(errno)));
+  }
+  header_ = static_cast<Header *>(map_);
+  slots_ = reinterpret_cast<Slot *>(static_cast<char *>(map_) + sizeof(Header));
+
+  if (header_->magic == 0)
+    header_->magic = kStateMagic;
+  if (header_->magic != kStateMagic || header_->used > kSlots) {
+    ::munmap(map_, map_size_);
+    map_ = nullptr;
+    throw std::runtime_error("Sequence state has an incompatible layout");
+  }
+  if (header_->epoch == 0)
+    header_->epoch = newEpoch();
+#else
+  (void)path;
+  throw std::runtime_error("Sequence state needs mmap");
+#endif
+}
+
+SeqState::~SeqState() {
+#if defined(__unix__) || defined(__APPLE__)
+  if (map_)
+    ::munmap(map_, map_size_);
+#endif
+}
+
+PeerSeqs *SeqState::get(std::string_view peer) {
+  if (peer.empty() || peer.size() > kMaxNameLength)
+    return nullptr;
+  std::lock_guard<std::mutex> lock(mtx_);
+  const size_t used = static_cast<size_t>(header_->used);
+  for (size_t i = 0; i < used; ++i) {
+    if (peer == slots_[i].name)
+      return &slots_[i].seqs;
+  }
+  if (used == kSlots) {
+    std::cout << "[ERROR]: Sequence state is full, " << peer
+              << " will restart from seq 0\n";
+    return nullptr;
+  }
+  // `used` moves last, so a crash part-way through leaves the slot free
+  Slot &slot = slots_[used];
+  slot.seqs = PeerSeqs{};
+  std::memcpy(slot.name, peer.data(), peer.size());
+  slot.name[peer.size()] = '\0';
+  header_->used = used + 1;
+  return &slot.seqs;
+}
+
+void SeqState::forEach(
+    const std::function<void(std::string_view, const PeerSeqs &)> &visit)
+    const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  const size_t used = static_cast<size_t>(header_->used);
+  for (size_t i = 0; i < used; ++i) {
+    const char *name = slots_[i].name;
+    visit(std::string_view(name, strnlen(name, kMaxNameLength + 1)),
+          slots_[i].seqs);
+  }
+}
+
+} // namespace SPEED
@@ -0,0 +1,44 @@
+#include "../include/ThreadPool.hpp"
+
+namespace SPEED {
+
+ThreadPool::ThreadPool(size_t workers) {
+  if (workers == 0)
+    workers = 1;
+  workers_.reserve(workers);
+  for (size_t i = 0; i < workers; ++i) {
+    workers_.emplace_back([this]() { workerLoop_(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (auto &t : workers_) {
+    if (t.joinable())
+      t.join();
+  }
+}
+
+size_t ThreadPool::size() const { return workers_.size(); }
+
+void ThreadPool::workerLoop_() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      // drain remaining work before exiting so no future is left dangling
+      if (stopping_ && tasks_.empty())
+        return;
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+    task();
+  }
+}
+
+} // namespace SPEED
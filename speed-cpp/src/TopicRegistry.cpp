@@ -0,0 +1,151 @@
+#include "../include/TopicRegistry.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace SPEED {
+
+TopicRegistry::TopicRegistry(const std::filesystem::path &topics_path,
+                             const std::string &proc_name)
+    : topics_path_(topics_path), proc_name_(proc_name) {
+  if (!Utils::directoryExists(topics_path_)) {
+    Utils::createDefaultDir(topics_path_);
+  }
+}
+
+bool TopicRegistry::validateTopicName(const std::string &topic) {
+  return Utils::validateName(topic);
+}
+
+bool TopicRegistry::subscribe(const std::string &topic) {
+  if (!validateTopicName(topic)) {
+    std::cout << "[ERROR]: Invalid topic name: " << topic << "\n";
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mtx_);
+  const std::filesystem::path topic_dir = topics_path_ / topic;
+  std::error_code ec;
+  std::filesystem::create_directories(topic_dir, ec);
+
+  const std::filesystem::path before_path = topic_dir / (proc_name_ + ".isub");
+  const std::filesystem::path after_path = topic_dir / (proc_name_ + ".osub");
+  std::ofstream outstream(before_path);
+  if (!outstream) {
+    std::cout << "[ERROR]: Unable to subscribe to topic: " << topic << "\n";
+    return false;
+  }
+  outstream << proc_name_ << "\n";
+  outstream.close();
+  std::rename(before_path.c_str(), after_path.c_str());
+  subscriptions_.insert(topic);
+  return true;
+}
+
+bool TopicRegistry::unsubscribe(const std::string &topic) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (subscriptions_.erase(topic) == 0) {
+    std::cout << "[WARN]: Not subscribed to topic: " << topic << "\n";
+    return false;
+  }
+  std::error_code ec;
+  std::filesystem::remove(topics_path_ / topic / (proc_name_ + ".osub"), ec);
+  return true;
+}
+
+void TopicRegistry::removeAllSubscriptions() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  std::error_code ec;
+  for (const std::string &topic : subscriptions_) {
+    std::filesystem::remove(topics_path_ / topic / (proc_name_ + ".osub"), ec);
+  }
+  subscriptions_.clear();
+}
+
+std::unordered_set<std::string> TopicRegistry::getSubscriptions() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return subscriptions_;
+}
+
+std::vector<std::string>
+TopicRegistry::getSubscribers(const std::string &topic) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = cache_.find(topic);
+  if (it == cache_.end()) {
+    // first publish on this topic: load it once, refresh() keeps it current
+    it = cache_.emplace(topic, TopicCache{}).first;
+    loadTopic_(topic, it->second);
+  }
+  return {it->second.subscribers.begin(), it->second.subscribers.end()};
+}
+
+void TopicRegistry::refresh() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (auto &[topic, cache] : cache_)
+    refreshTopic_(topic, cache);
+}
+
+void TopicRegistry::refresh(const std::string &topic) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  const auto it = cache_.find(topic);
+  if (it != cache_.end())
+    refreshTopic_(topic, it->second);
+}
+
+void TopicRegistry::refreshTopic_(const std::string &topic,
+                                  TopicCache &cache) {
+  std::error_code ec;
+  const auto mtime = std::filesystem::last_write_time(topics_path_ / topic, ec);
+  if (ec) {
+    // topic directory vanished, nobody is listening any more
+    cache.subscribers.clear();
+    return;
+  }
+  if (mtime != cache.mtime)
+    loadTopic_(topic, cache);
+}
+
+void TopicRegistry::loadTopic_(const std::string &topic, TopicCache &cache) {
+  const std::filesystem::path topic_dir = topics_path_ / topic;
+  std::error_code ec;
+  auto mtime = std::filesystem::last_write_time(topic_dir, ec);
+  if (ec) {
+    cache.subscribers.clear();
+    return;
+  }
+
+  std::unordered_set<std::string> current;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(topic_dir, ec)) {
+    if (entry.path().extension() != ".osub")
+      continue;
+    std::string name = entry.path().stem().string();
+    if (name != proc_name_)
+      current.insert(std::move(name));
+  }
+
+  for (const std::string &name : current) {
+    if (cache.subscribers.insert(name).second)
+      std::cout << "[INFO] Subscriber added to " << topic << ": " << name
+                << "\n";
+  }
+  for (auto it = cache.subscribers.begin(); it != cache.subscribers.end();) {
+    if (!current.count(*it)) {
+      std::cout << "[INFO] Subscriber removed from " << topic << ": " << *it
+                << "\n";
+      it = cache.subscribers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Coarse-grained filesystems can hide a second change inside the same
+  // mtime tick; leave a just-modified directory unstamped so the next
+  // refresh() looks again.
+  const auto now = std::filesystem::file_time_type::clock::now();
+  if (now - mtime < std::chrono::seconds(2))
+    mtime = {};
+  cache.mtime = mtime;
+}
+
+} // namespace SPEED
@@ -0,0 +1,164 @@
+#include "../include/Tracer.hpp"
+#include "../include/Utils.hpp"
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace SPEED {
+
+namespace {
+const char *stageName(TraceStage stage) {
+  switch (stage) {
+  case TraceStage::Send:
+    return "send";
+  case TraceStage::Encrypt:
+    return "encrypt";
+  case TraceStage::Write:
+    return "write";
+  case TraceStage::Rename:
+    return "rename";
+  case TraceStage::Queued:
+    return "queued";
+  case TraceStage::Read:
+    return "read";
+  case TraceStage::Decrypt:
+    return "decrypt";
+  case TraceStage::Callback:
+    return "callback";
+  }
+  return "unknown";
+}
+
+bool sendSide(TraceStage stage) { return stage <= TraceStage::Rename; }
+
+// FNV-1a over the frame's identity as both of its ends see it.
+uint64_t flowId(std::string_view sender, std::string_view reciever,
+                size_t lane, long long seq) {
+  uint64_t h = 1469598103934665603ull;
+  auto mix = [&](unsigned char c) {
+    h ^= c;
+    h *= 1099511628211ull;
+  };
+  for (char c : sender)
+    mix(static_cast<unsigned char>(c));
+  mix(0);
+  for (char c : reciever)
+    mix(static_cast<unsigned char>(c));
+  mix(0);
+  mix(static_cast<unsigned char>(lane));
+  for (size_t i = 0; i < sizeof(seq); ++i)
+    mix(static_cast<unsigned char>(static_cast<uint64_t>(seq) >> (8 * i)));
+  return h;
+}
+
+// Chrome trace timestamps are in microseconds.
+void appendMicros(std::ostringstream &out, uint64_t ns) {
+  const uint64_t frac = ns % 1000;
+  out << ns / 1000 << "." << (frac < 100 ? "0" : "") << (frac < 10 ? "0" : "")
+      << frac;
+}
+} // namespace
+
+void Tracer::enable(uint32_t sample_every, size_t capacity) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  sample_every_.store(0);
+  ring_.assign(sample_every == 0 ? 0 : std::max<size_t>(1, capacity), {});
+  ring_.shrink_to_fit();
+  next_ = 0;
+  wrapped_ = false;
+  sample_every_.store(sample_every);
+}
+
+void Tracer::record(TraceStage stage, PeerId peer, size_t lane, long long seq,
+                    uint64_t start_ns, uint64_t end_ns) {
+  thread_local const uint32_t tid = static_cast<uint32_t>(
+      std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (ring_.empty())
+    return; // disabled since the frame was sampled
+  ring_[next_] = {start_ns, std::max(start_ns, end_ns), seq, peer, tid,
+                  static_cast<uint8_t>(lane), stage};
+  if (++next_ == ring_.size()) {
+    next_ = 0;
+    wrapped_ = true;
+  }
+}
+
+std::vector<TraceEvent> Tracer::events() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (!wrapped_)
+    return {ring_.begin(), ring_.begin() + next_};
+  std::vector<TraceEvent> out(ring_.begin() + next_, ring_.end());
+  out.insert(out.end(), ring_.begin(), ring_.begin() + next_);
+  return out;
+}
+
+std::string Tracer::toJson(const PeerTable &names,
+                           std::string_view self) const {
+  const uint64_t pid = Utils::getProcessID();
+  std::ostringstream out;
+  out << "{\"traceEvents\":[{\"name\":\"process_name\",\"ph\":\"M\","
+         "\"pid\":"
+      << pid << ",\"args\":{\"name\":\"" << Utils::jsonEscape(self)
+      << "\"}}";
+  for (const TraceEvent &e : events()) {
+    const std::string &peer = names.name(e.peer);
+    out << ",{\"name\":\"" << stageName(e.stage)
+        << "\",\"cat\":\"speed\",\"ph\":\"X\",\"ts\":";
+    appendMicros(out, e.start_ns);
+    out << ",\"dur\":";
+    appendMicros(out, e.end_ns - e.start_ns);
+    out << ",\"pid\":" << pid << ",\"tid\":" << e.tid << ",\"args\":{\""
+        << (sendSide(e.stage) ? "to" : "from") << "\":\""
+        << Utils::jsonEscape(peer) << "\",\"lane\":" << static_cast<int>(e.lane)
+        << ",\"seq\":" << e.seq << "}}";
+    // an arrow from the send to the watcher that found the frame
+    if (e.stage != TraceStage::Send && e.stage != TraceStage::Queued)
+      continue;
+    const bool send = e.stage == TraceStage::Send;
+    const uint64_t id = send ? flowId(self, peer, e.lane, e.seq)
+                             : flowId(peer, self, e.lane, e.seq);
+    out << ",{\"name\":\"frame\",\"cat\":\"speed\",\"ph\":\""
+        << (send ? "s" : "f") << "\",\"id\":" << id << ",\"ts\":";
+    appendMicros(out, e.start_ns);
+    out << ",\"pid\":" << pid << ",\"tid\":" << e.tid
+        << (send ? "" : ",\"bp\":\"e\"") << "}";
+  }
+  out << "],\"displayTimeUnit\":\"ns\"}";
+  return out.str();
+}
+
+// Relies on the layout toJson() writes: the events are everything between
+// the first '[' and the last ']'.
+bool Tracer::merge(const std::vector<std::filesystem::path> &inputs,
+                   const std::filesystem::path &output) {
+  std::string merged = "{\"traceEvents\":[";
+  bool first = true;
+  for (const std::filesystem::path &input : inputs) {
+    std::ifstream in(input);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string trace = buffer.str();
+    const size_t begin = trace.find('[');
+    const size_t end = trace.rfind(']');
+    if (!in || begin == std::string::npos || end == std::string::npos ||
+        end <= begin) {
+      std::cout << "[ERROR]: Not a SPEED trace: " << input << "\n";
+      return false;
+    }
+    if (end == begin + 1)
+      continue;
+    merged += first ? "" : ",";
+    merged.append(trace, begin + 1, end - begin - 1);
+    first = false;
+  }
+  merged += "],\"displayTimeUnit\":\"ns\"}\n";
+  std::ofstream out(output, std::ios::trunc);
+  out << merged;
+  return static_cast<bool>(out);
+}
+
+} // namespace SPEED
@@ -1,4 +1,14 @@
 #include "../include/Utils.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <signal.h>
+#endif
 
 namespace SPEED {
 namespace Utils {
@@ -39,6 +49,94 @@ uint64_t getProcessID() {
 #error "Unsupported platform"
 #endif
 }
+bool isProcessAlive(uint64_t pid) {
+  if (pid == 0)
+    return false;
+#if defined(_WIN32)
+  HANDLE h = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE,
+                         static_cast<DWORD>(pid));
+  if (h == nullptr)
+    return false;
+  DWORD code = 0;
+  const bool alive = GetExitCodeProcess(h, &code) && code == STILL_ACTIVE;
+  CloseHandle(h);
+  return alive;
+#elif defined(__unix__) || defined(__APPLE__)
+  // signal 0 only probes; EPERM still means the pid exists
+  return ::kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#else
+#error "Unsupported platform"
+#endif
+}
+const std::string &pidSpace() {
+  static const std::string space = [] {
+    std::string id;
+#if defined(__linux__)
+    std::ifstream("/proc/sys/kernel/random/boot_id") >> id;
+    char ns[64];
+    const ssize_t n = ::readlink("/proc/self/ns/pid", ns, sizeof(ns));
+    if (!id.empty() && n > 0)
+      id.append("/").append(ns, static_cast<size_t>(n));
+#elif defined(_WIN32)
+    char host[MAX_COMPUTERNAME_LENGTH + 1];
+    DWORD size = sizeof(host);
+    if (GetComputerNameA(host, &size))
+      id.assign(host, size);
+#else
+    char host[256] = {};
+    if (::gethostname(host, sizeof(host) - 1) == 0)
+      id = host;
+#endif
+    return id;
+  }();
+  return space;
+}
+bool isLocalPidSpace(std::string_view space) {
+  return !space.empty() && space == pidSpace();
+}
+bool isReservedName(std::string_view name) {
+  static constexpr std::string_view kReserved[] = {
+      "access_registry", "claimed", "identities", "metrics",
+      "quarantine",      "queues",  "seqstate"};
+  for (std::string_view reserved : kReserved) {
+    if (name == reserved)
+      return true;
+  }
+  return false;
+}
+std::string jsonEscape(std::string_view text) {
+  std::string out;
+  out.reserve(text.size());
+  for (const char c : text) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[7];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x",
+                      static_cast<unsigned>(c));
+        out += escaped;
+      } else {
+        out += c;
+      }
+    }
+  }
+  return out;
+}
 bool validateKey(const std::string &b64_key) {
   if (b64_key.empty())
     return false;
@@ -53,39 +151,135 @@ bool validateKey(const std::string &b64_key) {
   return true;
 }
 
-std::string getCurrentTimestamp() {
+uint64_t getEpochMillis() {
   using namespace std::chrono;
-  auto now = system_clock::now();
-  auto now_time_t = system_clock::to_time_t(now);
-  auto now_ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
+  return static_cast<uint64_t>(
+      duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+          .count());
+}
 
-  std::ostringstream oss;
-  oss << std::put_time(std::localtime(&now_time_t),
-                       "%Y%m%d%H%M%S") // removed 'T'
-      << std::setw(3) << std::setfill('0') << now_ms.count();
-  return oss.str(); // e.g. "20251001225401123"
+uint64_t getEpochNanos() {
+  using namespace std::chrono;
+  return static_cast<uint64_t>(
+      duration_cast<nanoseconds>(system_clock::now().time_since_epoch())
+          .count());
 }
 
-std::string generateUUID() {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<uint32_t> dist(0, 0xFFFFFFFF);
+// The date/time prefix only changes once a second, so it is cached per thread
+// and only the milliseconds are formatted on every call.
+void formatTimestamp(char (&out)[kTimestampChars + 1]) {
+  using namespace std::chrono;
+  const auto now = system_clock::now();
+  const std::time_t now_time_t = system_clock::to_time_t(now);
+  const auto now_ms =
+      duration_cast<milliseconds>(now.time_since_epoch()).count() % 1000;
+
+  thread_local std::time_t cached_second = -1;
+  thread_local char cached_prefix[kTimestampChars - 3 + 1];
+  if (now_time_t != cached_second) {
+    std::tm local{};
+#if defined(_WIN32)
+    localtime_s(&local, &now_time_t);
+#else
+    localtime_r(&now_time_t, &local);
+#endif
+    std::strftime(cached_prefix, sizeof(cached_prefix), "%Y%m%d%H%M%S",
+                  &local);
+    cached_second = now_time_t;
+  }
+  std::memcpy(out, cached_prefix, kTimestampChars - 3);
+  out[kTimestampChars - 3] = static_cast<char>('0' + now_ms / 100);
+  out[kTimestampChars - 2] = static_cast<char>('0' + now_ms / 10 % 10);
+  out[kTimestampChars - 1] = static_cast<char>('0' + now_ms % 10);
+  out[kTimestampChars] = '\0';
+}
+
+std::string getCurrentTimestamp() {
+  char buf[kTimestampChars + 1];
+  formatTimestamp(buf);
+  return buf; // e.g. "20251001225401123"
+}
 
-  uint32_t data[4];
-  for (auto &d : data)
-    d = dist(gen);
+// UUIDs only need to be unique, not unpredictable, so a per-thread
+// xoshiro256** seeded from the system RNG replaces a std::random_device
+// open per call. A forked child inherits the generator's state, so each
+// generator reseeds once it sees a fork it was not seeded after.
+namespace {
+std::atomic<uint64_t> g_forks{0};
+}
+
+void formatUUID(char (&out)[kUUIDChars + 1]) {
+  struct Xoshiro {
+    uint64_t s[4];
+    uint64_t forks = 0;
+    Xoshiro() { seed(); }
+    void seed() {
+      forks = g_forks.load(std::memory_order_relaxed);
+      do {
+        randombytes_buf(s, sizeof(s));
+      } while ((s[0] | s[1] | s[2] | s[3]) == 0);
+    }
+    static uint64_t rotl(uint64_t x, int k) {
+      return (x << k) | (x >> (64 - k));
+    }
+    uint64_t next() {
+      const uint64_t result = rotl(s[1] * 5, 7) * 9;
+      const uint64_t t = s[1] << 17;
+      s[2] ^= s[0];
+      s[3] ^= s[1];
+      s[1] ^= s[2];
+      s[0] ^= s[3];
+      s[2] ^= t;
+      s[3] = rotl(s[3], 45);
+      return result;
+    }
+  };
+#if defined(__unix__) || defined(__APPLE__)
+  static const bool fork_hook = [] {
+    return ::pthread_atfork(nullptr, nullptr, [] {
+             g_forks.fetch_add(1, std::memory_order_relaxed);
+           }) == 0;
+  }();
+  (void)fork_hook;
+#endif
+  thread_local Xoshiro rng;
+  if (rng.forks != g_forks.load(std::memory_order_relaxed))
+    rng.seed();
+
+  const uint64_t hi = rng.next();
+  const uint64_t lo = rng.next();
+  uint32_t data[4] = {static_cast<uint32_t>(hi >> 32),
+                      static_cast<uint32_t>(hi),
+                      static_cast<uint32_t>(lo >> 32),
+                      static_cast<uint32_t>(lo)};
 
   // Set version and variant bits
   data[1] = (data[1] & 0xFFFF0FFF) | 0x00004000;
   data[2] = (data[2] & 0x3FFFFFFF) | 0x80000000;
 
-  std::ostringstream oss;
-  oss << std::hex << std::setfill('0') << std::setw(8) << data[0] << "-"
-      << std::setw(4) << (data[1] >> 16) << "-" << std::setw(4)
-      << (data[1] & 0xFFFF) << "-" << std::setw(4) << (data[2] >> 16) << "-"
-      << std::setw(4) << (data[2] & 0xFFFF) << std::setw(8) << data[3];
+  static constexpr char kHex[] = "0123456789abcdef";
+  char *p = out;
+  auto put = [&p](uint32_t value, int digits) {
+    for (int shift = 4 * (digits - 1); shift >= 0; shift -= 4)
+      *p++ = kHex[(value >> shift) & 0xF];
+  };
+  put(data[0], 8);
+  *p++ = '-';
+  put(data[1] >> 16, 4);
+  *p++ = '-';
+  put(data[1] & 0xFFFF, 4);
+  *p++ = '-';
+  put(data[2] >> 16, 4);
+  *p++ = '-';
+  put(data[2] & 0xFFFF, 4);
+  put(data[3], 8);
+  *p = '\0';
+}
 
-  return oss.str();
+std::string generateUUID() {
+  char buf[kUUIDChars + 1];
+  formatUUID(buf);
+  return buf;
 }
 
 std::string getTimestampUUID() {
@@ -0,0 +1,152 @@
+#include "../include/WorkQueue.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace SPEED {
+
+WorkQueue::WorkQueue(const std::filesystem::path &speed_dir,
+                     const std::string &proc_name)
+    : speed_dir_(speed_dir), queues_path_(speed_dir / "queues"),
+      claim_path_(speed_dir / proc_name / "claimed"), proc_name_(proc_name) {
+  std::error_code ec;
+  std::filesystem::create_directories(queues_path_, ec);
+  std::filesystem::create_directories(claim_path_, ec);
+  writeOwnerFile_();
+}
+
+bool WorkQueue::validateQueueName(const std::string &queue) {
+  return Utils::validateName(queue);
+}
+
+bool WorkQueue::submit(const Message &msg, const std::string &queue) {
+  if (!validateQueueName(queue)) {
+    std::cout << "[ERROR]: Invalid queue name: " << queue << "\n";
+    return false;
+  }
+  const std::filesystem::path queue_dir = queues_path_ / queue;
+  std::error_code ec;
+  std::filesystem::create_directories(queue_dir, ec);
+
+  const std::string name = Utils::getCurrentTimestamp() + "_" + proc_name_ +
+                           "_" + Utils::generateUUID();
+  return BinaryManager::writeAtomic(msg, queue_dir / (name + ".ispeed"),
+                                    queue_dir / (name + ".ojob"));
+}
+
+std::vector<std::filesystem::path>
+WorkQueue::claim(const std::string &queue, size_t max_jobs) {
+  std::vector<std::filesystem::path> claimed;
+  const std::filesystem::path queue_dir = queues_path_ / queue;
+  std::error_code ec;
+  if (!Utils::directoryExists(queue_dir))
+    return claimed;
+
+  // Look at a few more candidates than we want and try them in random
+  // order, so concurrent workers mostly go after different files instead of
+  // all racing for the first entries of the listing.
+  std::vector<std::filesystem::path> candidates;
+  const size_t scan_limit = max_jobs * 4;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(queue_dir, ec)) {
+    if (entry.path().extension() != ".ojob")
+      continue;
+    candidates.push_back(entry.path());
+    if (candidates.size() >= scan_limit)
+      break;
+  }
+  if (candidates.empty())
+    return claimed;
+
+  static thread_local std::mt19937 rng(
+      static_cast<uint32_t>(Utils::getProcessID()) ^ std::random_device{}());
+  std::shuffle(candidates.begin(), candidates.end(), rng);
+
+  const std::filesystem::path claim_dir = claim_path_ / queue;
+  std::filesystem::create_directories(claim_dir, ec);
+  for (const auto &candidate : candidates) {
+    const std::filesystem::path target = claim_dir / candidate.filename();
+    std::filesystem::rename(candidate, target, ec);
+    if (ec) // another worker won this one
+      continue;
+    claimed.push_back(target);
+    if (claimed.size() >= max_jobs)
+      break;
+  }
+  return claimed;
+}
+
+void WorkQueue::complete(const std::filesystem::path &claimed) {
+  std::error_code ec;
+  std::filesystem::remove(claimed, ec);
+}
+
+// Claims left behind by a previous incarnation of this process.
+size_t WorkQueue::requeueOwnClaims() { return requeueClaimDir_(claim_path_); }
+
+size_t WorkQueue::reclaimDeadClaims() {
+  size_t requeued = 0;
+  std::error_code ec;
+  for (const auto &proc_dir :
+       std::filesystem::directory_iterator(speed_dir_, ec)) {
+    if (!proc_dir.is_directory(ec))
+      continue;
+    const std::filesystem::path claim_dir = proc_dir.path() / "claimed";
+    if (claim_dir == claim_path_)
+      continue;
+    const std::filesystem::path owner_file = claim_dir / ".owner";
+    if (!Utils::fileExists(owner_file))
+      continue;
+
+    // only an owner of this pid space can be seen dead; one elsewhere may
+    // well be working on its claims
+    uint64_t pid = 0;
+    std::string space;
+    std::ifstream in(owner_file);
+    in >> pid >> space;
+    if (!Utils::isLocalPidSpace(space) || Utils::isProcessAlive(pid))
+      continue;
+
+    const size_t n = requeueClaimDir_(claim_dir);
+    if (n > 0) {
+      std::cout << "[INFO]: Requeued " << n << " job(s) claimed by dead "
+                << "worker " << proc_dir.path().filename().string() << "\n";
+    }
+    requeued += n;
+  }
+  return requeued;
+}
+
+size_t WorkQueue::requeueClaimDir_(const std::filesystem::path &claim_dir) {
+  size_t requeued = 0;
+  std::error_code ec;
+  for (const auto &queue_dir :
+       std::filesystem::directory_iterator(claim_dir, ec)) {
+    if (!queue_dir.is_directory(ec))
+      continue;
+    const std::filesystem::path target_dir =
+        queues_path_ / queue_dir.path().filename();
+    std::filesystem::create_directories(target_dir, ec);
+    for (const auto &job :
+         std::filesystem::directory_iterator(queue_dir.path(), ec)) {
+      std::error_code rec;
+      std::filesystem::rename(job.path(), target_dir / job.path().filename(),
+                              rec);
+      if (!rec)
+        ++requeued;
+    }
+  }
+  return requeued;
+}
+
+void WorkQueue::writeOwnerFile_() {
+  const std::filesystem::path tmp = claim_path_ / ".owner.tmp";
+  std::ofstream out(tmp);
+  out << Utils::getProcessID() << "\n" << Utils::pidSpace() << "\n";
+  out.close();
+  std::error_code ec;
+  std::filesystem::rename(tmp, claim_path_ / ".owner", ec);
+}
+
+} // namespace SPEED
@@ -1,9 +1,13 @@
 #include "../include/AccessRegistry.hpp"
 #include "../include/Utils.hpp"
+#include "TestSupport.hpp"
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
 #include <thread>
+#include <unistd.h>
 
 using namespace SPEED;
 
@@ -122,3 +126,160 @@ TEST_F(AccessRegistryTest, ThreadSafetyForAddAndRemove) {
   // Registry should be in a consistent state (either contains or not)
   EXPECT_NO_FATAL_FAILURE();
 }
+
+TEST_F(AccessRegistryTest, GlobalRegistryIgnoresNonRegistryEntries) {
+  std::ofstream(tempDir / "Alpha.oregistry") << "Alpha";
+  std::ofstream(tempDir / "Partial.iregistry") << "Partial";
+  fs::create_directories(tempDir / "topics" / "news");
+  std::ofstream(tempDir / "topics" / "news" / "Alpha.osub") << "Alpha";
+
+  AccessRegistry reg(tempDir, procName);
+
+  EXPECT_TRUE(reg.checkGlobalRegistry("Alpha"));
+  EXPECT_FALSE(reg.checkGlobalRegistry("Partial"));
+  EXPECT_FALSE(reg.checkGlobalRegistry("topics"));
+  EXPECT_FALSE(reg.checkGlobalRegistry("news"));
+}
+
+TEST_F(AccessRegistryTest, GenerationMovesOnlyOnChange) {
+  AccessRegistry reg(tempDir, procName);
+  const uint64_t g0 = reg.getGeneration();
+
+  reg.addProcessToList("Peer");
+  const uint64_t g1 = reg.getGeneration();
+  EXPECT_GT(g1, g0);
+
+  reg.addProcessToList("Peer"); // already present
+  reg.checkAccess("Peer");
+  EXPECT_EQ(reg.getGeneration(), g1);
+
+  reg.removeProcessFromAccessList("Peer");
+  EXPECT_GT(reg.getGeneration(), g1);
+}
+
+TEST_F(AccessRegistryTest, SyncDropsAccessForDepartedProcesses) {
+  std::ofstream(tempDir / "Alpha.oregistry") << "Alpha";
+  AccessRegistry reg(tempDir, procName);
+  reg.addProcessToList("Alpha");
+  reg.addProcessToList("Gone");
+
+  const uint64_t before = reg.getGeneration();
+  reg.syncAccessRegistry();
+  EXPECT_TRUE(reg.checkAccess("Alpha"));
+  EXPECT_FALSE(reg.checkAccess("Gone"));
+  const uint64_t after = reg.getGeneration();
+  EXPECT_GT(after, before);
+
+  // nothing left to drop
+  reg.syncAccessRegistry();
+  EXPECT_EQ(reg.getGeneration(), after);
+}
+
+TEST_F(AccessRegistryTest, RefreshAppliesArrivalsAndDepartures) {
+  std::ofstream(tempDir / "Alpha.oregistry") << "Alpha";
+  AccessRegistry reg(tempDir, procName);
+  ASSERT_TRUE(reg.checkGlobalRegistry("Alpha"));
+
+  std::ofstream(tempDir / "Gamma.iregistry") << "Gamma";
+  fs::rename(tempDir / "Gamma.iregistry", tempDir / "Gamma.oregistry");
+  fs::remove(tempDir / "Alpha.oregistry");
+  reg.refresh();
+
+  EXPECT_TRUE(reg.checkGlobalRegistry("Gamma"));
+  EXPECT_FALSE(reg.checkGlobalRegistry("Alpha"));
+  EXPECT_FALSE(reg.checkGlobalRegistry(procName));
+}
+
+TEST_F(AccessRegistryTest, ResolveCachesMisses) {
+  AccessRegistry reg(tempDir, procName);
+  EXPECT_FALSE(reg.resolve("Late"));
+
+  // within the TTL the miss is answered from the cache
+  std::ofstream(tempDir / "Late.oregistry") << "Late";
+  EXPECT_FALSE(reg.resolve("Late"));
+
+  // an applied arrival clears the cached miss
+  reg.refresh();
+  EXPECT_TRUE(reg.resolve("Late"));
+}
+
+TEST_F(AccessRegistryTest, EvictsPeersWhoseProcessDied) {
+  // a pid that is certainly gone: a child that has exited and been reaped
+  const pid_t child = deadPid();
+  const std::string &space = Utils::pidSpace();
+  std::ofstream(tempDir / "Ghost.oregistry")
+      << "Ghost\n" << child << "\n" << space << "\n";
+  std::ofstream(tempDir / "Alive.oregistry")
+      << "Alive\n" << getpid() << "\n" << space << "\n";
+  // the same pid means nothing in another pid namespace or on another host
+  std::ofstream(tempDir / "Remote.oregistry")
+      << "Remote\n" << child << "\n" << "elsewhere\n";
+  // no pid: judged by the heartbeat, which stopped long ago
+  std::ofstream(tempDir / "Silent.oregistry") << "Silent\n";
+  fs::last_write_time(tempDir / "Silent.oregistry",
+                      fs::file_time_type::clock::now() -
+                          AccessRegistry::kPeerTimeout -
+                          std::chrono::seconds(1));
+
+  AccessRegistry reg(tempDir, procName);
+  auto dead = reg.evictDeadPeers();
+  std::sort(dead.begin(), dead.end());
+  EXPECT_EQ(dead, (std::vector<std::string>{"Ghost", "Silent"}));
+  EXPECT_FALSE(reg.checkGlobalRegistry("Ghost"));
+  EXPECT_TRUE(reg.checkGlobalRegistry("Alive"));
+  EXPECT_TRUE(reg.checkGlobalRegistry("Remote"));
+  EXPECT_FALSE(fileExists(tempDir / "Ghost.oregistry"));
+  // only judged by its heartbeat, so others decide for themselves
+  EXPECT_TRUE(fileExists(tempDir / "Silent.oregistry"));
+  EXPECT_TRUE(fileExists(tempDir / (procName + ".oregistry")));
+}
+
+TEST_F(AccessRegistryTest, ViewsAreImmutableSnapshots) {
+  AccessRegistry reg(tempDir, procName);
+  reg.addProcessToList("Peer");
+  const AccessRegistry::ListView before = reg.getAccessList();
+  const uint64_t generation = reg.snapshot()->generation;
+
+  reg.removeProcessFromAccessList("Peer");
+  // the view taken earlier still shows the list as it was
+  EXPECT_EQ(before->count("Peer"), 1u);
+  EXPECT_EQ(reg.getAccessList()->count("Peer"), 0u);
+  EXPECT_GT(reg.snapshot()->generation, generation);
+}
+
+TEST_F(AccessRegistryTest, ChecksSeeEveryPublish) {
+  AccessRegistry a(tempDir, "A");
+  AccessRegistry b(tempDir, "B");
+  // each thread caches one snapshot; switching registries must not mix them
+  a.addProcessToList("Peer");
+  EXPECT_TRUE(a.checkAccess("Peer"));
+  EXPECT_FALSE(b.checkAccess("Peer"));
+  EXPECT_TRUE(a.checkAccess("Peer"));
+
+  // a publish from another thread is seen on the next check
+  std::thread([&]() { a.removeProcessFromAccessList("Peer"); }).join();
+  EXPECT_FALSE(a.checkAccess("Peer"));
+  EXPECT_EQ(a.snapshot()->generation, a.getGeneration());
+}
+
+TEST_F(AccessRegistryTest, ChecksRunConcurrentlyWithWriters) {
+  AccessRegistry reg(tempDir, procName);
+  std::atomic<bool> done{false};
+  std::atomic<size_t> inconsistent{0};
+  std::thread reader([&]() {
+    while (!done.load()) {
+      // addProcessToList adds to both lists in one version
+      const auto acl = reg.snapshot();
+      if (acl->access_list.count("Peer") && !acl->connected_list.count("Peer"))
+        ++inconsistent;
+      reg.checkAccess("Peer");
+    }
+  });
+  for (int i = 0; i < 2000; ++i) {
+    reg.addProcessToList("Peer");
+    reg.removeProcessFromAccessList("Peer");
+  }
+  done.store(true);
+  reader.join();
+  EXPECT_EQ(inconsistent.load(), 0u);
+}
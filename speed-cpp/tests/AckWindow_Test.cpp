@@ -0,0 +1,104 @@
+#include "../include/SPEED.hpp"
+#include "TestSupport.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+class AckWindowTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "speed_ack_window_test";
+    fs::remove_all(tempDir);
+    fs::create_directories(tempDir);
+  }
+  void TearDown() override { fs::remove_all(tempDir); }
+};
+
+// --- Tests ---
+
+TEST_F(AckWindowTest, AcksReturnAndFlushSettles) {
+  ::SPEED::SPEED reciever("AB", ThreadMode::Single, tempDir);
+  std::atomic<int> delivered{0};
+  reciever.setCallback([&](const PMessage &) { ++delivered; });
+  ::SPEED::SPEED sender("AA", ThreadMode::Single, tempDir);
+  sender.setAckWindow(8);
+  for (int i = 0; i < 3; ++i)
+    ASSERT_TRUE(sender.sendMessage("m" + std::to_string(i), "AB"));
+  // nothing consumed yet
+  EXPECT_FALSE(sender.flush("AB", std::chrono::milliseconds(100)));
+  EXPECT_EQ(sender.getAckedCount("AB"), 0);
+
+  Running run_sender(sender);
+  Running run_reciever(reciever);
+  EXPECT_TRUE(sender.flush("AB", std::chrono::seconds(10)));
+  EXPECT_EQ(delivered.load(), 3);
+  EXPECT_EQ(sender.getAckedCount("AB"), 3);
+}
+
+TEST_F(AckWindowTest, FullWindowBlocksUntilAcked) {
+  ::SPEED::SPEED reciever("AB", ThreadMode::Single, tempDir);
+  std::atomic<int> delivered{0};
+  reciever.setCallback([&](const PMessage &) { ++delivered; });
+  ::SPEED::SPEED sender("AA", ThreadMode::Single, tempDir);
+  sender.setAckWindow(2);
+  ASSERT_TRUE(sender.sendMessage("m0", "AB"));
+  ASSERT_TRUE(sender.sendMessage("m1", "AB"));
+
+  Running run_sender(sender);
+  std::atomic<bool> sent{false};
+  std::thread third([&]() {
+    EXPECT_TRUE(sender.sendMessage("m2", "AB"));
+    sent = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  EXPECT_FALSE(sent.load());
+
+  {
+    Running run_reciever(reciever);
+    EXPECT_TRUE(waitFor([&]() { return sent.load(); }));
+    third.join();
+    EXPECT_TRUE(sender.flush("AB", std::chrono::seconds(10)));
+  }
+  EXPECT_EQ(delivered.load(), 3);
+}
+
+// A callback runs on the watcher, which is what processes the ACKs a full
+// window waits for; blocking there would stall until the ACK timeout.
+TEST_F(AckWindowTest, CallbackSendFailsFastOnAFullWindow) {
+  { ::SPEED::SPEED first("AA", ThreadMode::Single, tempDir); }
+  ::SPEED::SPEED reciever("AB", ThreadMode::Single, tempDir);
+  reciever.setAckWindow(1);
+  std::vector<bool> replies;
+  bool flushed = true;
+  std::chrono::steady_clock::duration took{};
+  std::atomic<bool> done{false};
+  reciever.setCallback([&](const PMessage &) {
+    const auto start = std::chrono::steady_clock::now();
+    replies.push_back(reciever.sendMessage("r0", "AA"));
+    replies.push_back(reciever.sendMessage("r1", "AA"));
+    flushed = reciever.flush("AA");
+    took = std::chrono::steady_clock::now() - start;
+    done = true;
+  });
+  {
+    ::SPEED::SPEED sender("AA", ThreadMode::Single, tempDir);
+    ASSERT_TRUE(sender.sendMessage("m", "AB"));
+  }
+
+  {
+    Running run_reciever(reciever);
+    ASSERT_TRUE(waitFor([&]() { return done.load(); }));
+  }
+  EXPECT_EQ(replies, (std::vector<bool>{true, false}));
+  EXPECT_FALSE(flushed);
+  EXPECT_LT(took, std::chrono::seconds(1));
+}
@@ -32,6 +32,7 @@ protected:
     Message msg;
     msg.header.version = 1;
     msg.header.type = MessageType::MSG;
+    msg.header.flags = FLAG_ACK_REQUESTED;
     msg.header.sender_pid = 1234;
     msg.header.timestamp = 5678;
     msg.header.seq_num = seqNumber.load();
@@ -53,7 +54,7 @@ TEST_F(BinaryManagerTest, WriteAndReadBinaryBasic) {
 
   // Find the written file (".ospeed")
   fs::path writtenFile;
-  for (auto &entry : fs::directory_iterator(tempDir / procName)) {
+  for (auto &entry : fs::directory_iterator(tempDir / procName / procName)) {
     if (entry.path().extension() == ".ospeed") {
       writtenFile = entry.path();
       break;
@@ -65,6 +66,7 @@ TEST_F(BinaryManagerTest, WriteAndReadBinaryBasic) {
 
   EXPECT_EQ(readMsg.header.version, msg.header.version);
   EXPECT_EQ(readMsg.header.type, msg.header.type);
+  EXPECT_EQ(readMsg.header.flags, msg.header.flags);
   EXPECT_EQ(readMsg.header.sender_pid, msg.header.sender_pid);
   EXPECT_EQ(readMsg.header.timestamp, msg.header.timestamp);
   EXPECT_EQ(readMsg.header.seq_num, msg.header.seq_num);
@@ -82,7 +84,7 @@ TEST_F(BinaryManagerTest, WriteBinaryEmptyPayload) {
   EXPECT_TRUE(success);
 
   fs::path writtenFile;
-  for (auto &entry : fs::directory_iterator(tempDir / procName))
+  for (auto &entry : fs::directory_iterator(tempDir / procName / procName))
     if (entry.path().extension() == ".ospeed")
       writtenFile = entry.path();
 
@@ -139,7 +141,7 @@ TEST_F(BinaryManagerTest, SequenceNumberIncrements) {
   EXPECT_TRUE(s2);
 
   std::vector<std::string> files;
-  for (auto &entry : fs::directory_iterator(tempDir / procName)) {
+  for (auto &entry : fs::directory_iterator(tempDir / procName / procName)) {
     if (entry.path().extension() == ".ospeed")
       files.push_back(entry.path().filename().string());
   }
@@ -168,3 +170,120 @@ TEST_F(BinaryManagerTest, NonexistentDirectoryFailsGracefully) {
       BinaryManager::writeBinary(msg, invalidDir, seqNumber, procName);
   EXPECT_FALSE(success);
 }
+
+TEST_F(BinaryManagerTest, WriteSharedPublishesToEveryInbox) {
+  auto msg = makeSampleMessage();
+  msg.header.reciever = "";
+  fs::create_directory(tempDir / "Bob");
+  fs::create_directory(tempDir / "Carol");
+
+  size_t published = BinaryManager::writeShared(
+      msg, tempDir, "Alice", {{"Bob", 3}, {"Carol", 7}});
+  EXPECT_EQ(published, 2u);
+
+  auto findFrame = [](const fs::path &dir) {
+    fs::path found;
+    for (auto &entry : fs::directory_iterator(dir))
+      if (entry.path().extension() == ".ospeed")
+        found = entry.path();
+    return found;
+  };
+  fs::path bobFile = findFrame(tempDir / "Bob" / "Alice");
+  fs::path carolFile = findFrame(tempDir / "Carol" / "Alice");
+  ASSERT_FALSE(bobFile.empty());
+  ASSERT_FALSE(carolFile.empty());
+
+  // per-reciever sequence, sender name and lane in the filename
+  EXPECT_NE(bobFile.filename().string().find("_Alice_2_3_"),
+            std::string::npos);
+  EXPECT_NE(carolFile.filename().string().find("_Alice_2_7_"),
+            std::string::npos);
+
+  // one payload on disk, shared by both inboxes; staging copy is gone
+  EXPECT_TRUE(fs::equivalent(bobFile, carolFile));
+  EXPECT_TRUE(fs::is_empty(tempDir / ".outbox"));
+
+  auto readMsg = BinaryManager::readBinary(carolFile);
+  EXPECT_EQ(readMsg.payload, msg.payload);
+  EXPECT_TRUE(readMsg.header.reciever.empty());
+}
+
+TEST_F(BinaryManagerTest, WriteSharedSkipsMissingInbox) {
+  auto msg = makeSampleMessage();
+  fs::create_directory(tempDir / "Bob");
+
+  std::vector<bool> reached;
+  size_t published = BinaryManager::writeShared(
+      msg, tempDir, "Alice", {{"Bob", 0}, {"Ghost", 0}}, &reached);
+  EXPECT_EQ(published, 1u);
+  EXPECT_EQ(reached, (std::vector<bool>{true, false}));
+}
+
+TEST_F(BinaryManagerTest, PriorityLaneInHeaderAndFilename) {
+  auto msg = makeSampleMessage();
+  msg.header.priority = Priority::Control;
+  fs::create_directory(tempDir / "Bob");
+  ASSERT_TRUE(BinaryManager::writeBinary(msg, tempDir, "Alice", 5, "Bob"));
+
+  fs::path file;
+  for (auto &entry : fs::directory_iterator(tempDir / "Bob" / "Alice"))
+    file = entry.path();
+  ASSERT_FALSE(file.empty());
+  EXPECT_NE(file.filename().string().find("_Alice_0_5_"), std::string::npos);
+  EXPECT_EQ(BinaryManager::readBinary(file).header.priority,
+            Priority::Control);
+}
+
+TEST_F(BinaryManagerTest, ExpiryRoundTripsInTheClear) {
+  auto msg = makeSampleMessage();
+  msg.header.expires_at = 1700000000123ULL;
+  ASSERT_TRUE(BinaryManager::writeBinary(msg, tempDir, seqNumber, procName));
+
+  fs::path file;
+  for (auto &entry : fs::directory_iterator(tempDir / procName / procName))
+    file = entry.path();
+  ASSERT_FALSE(file.empty());
+  EXPECT_EQ(BinaryManager::readBinary(file).header.expires_at,
+            1700000000123ULL);
+}
+
+TEST_F(BinaryManagerTest, TruncatedHeaderThrows) {
+  auto msg = makeSampleMessage();
+  ASSERT_TRUE(BinaryManager::writeBinary(msg, tempDir, seqNumber, procName));
+
+  fs::path file;
+  for (auto &entry : fs::directory_iterator(tempDir / procName / procName))
+    file = entry.path();
+  ASSERT_FALSE(file.empty());
+  fs::resize_file(file, kHeaderWireSize - 1);
+  EXPECT_THROW(BinaryManager::readBinary(file), std::runtime_error);
+}
+
+TEST(PeerNameTest, RejectsNamesThatDoNotFit) {
+  PeerName name;
+  EXPECT_NO_THROW(name.assign(std::string(kMaxNameLength, 'a')));
+  EXPECT_EQ(name.size(), kMaxNameLength);
+  EXPECT_THROW(name.assign(std::string(kMaxNameLength + 1, 'a')),
+               std::length_error);
+}
+
+TEST_F(BinaryManagerTest, PooledReadMatchesPlainRead) {
+  auto msg = makeSampleMessage();
+  ASSERT_TRUE(BinaryManager::writeBinary(msg, tempDir, seqNumber, procName));
+
+  fs::path file;
+  for (auto &entry : fs::directory_iterator(tempDir / procName / procName))
+    file = entry.path();
+  ASSERT_FALSE(file.empty());
+
+  MessagePool pool;
+  {
+    MessagePool::Lease pooled = BinaryManager::readBinary(file, pool);
+    EXPECT_EQ(pooled->payload, msg.payload);
+    EXPECT_EQ(pooled->header.sender, msg.header.sender);
+    EXPECT_EQ(pool.stats().in_use, 1u);
+  }
+  EXPECT_EQ(pool.stats().in_use, 0u);
+  fs::resize_file(file, kHeaderWireSize + 2);
+  EXPECT_THROW(BinaryManager::readBinary(file, pool), std::runtime_error);
+}
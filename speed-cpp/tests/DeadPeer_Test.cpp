@@ -0,0 +1,91 @@
+#include "../include/SPEED.hpp"
+#include "TestSupport.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+class DeadPeerTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "speed_dead_peer_test";
+    fs::remove_all(tempDir);
+    fs::create_directories(tempDir);
+  }
+  void TearDown() override { fs::remove_all(tempDir); }
+};
+
+// --- Tests ---
+
+TEST_F(DeadPeerTest, DeadPeerIsEvictedAndItsInboxCollected) {
+  { ::SPEED::SPEED peer("DB", ThreadMode::Single, tempDir); }
+  // leave DB registered and owning its inbox, as a crash would
+  const pid_t pid = deadPid();
+  const fs::path registration = tempDir / "access_registry" / "DB.oregistry";
+  const std::string &space = Utils::pidSpace();
+  std::ofstream(registration) << "DB\n" << pid << "\n" << space << "\n";
+  std::ofstream(tempDir / "DB" / "claimed" / ".owner")
+      << pid << "\n" << space << "\n";
+
+  ::SPEED::SPEED sender("DA", ThreadMode::Single, tempDir);
+  sender.setInboxRetention(std::chrono::seconds(1));
+  // DB will never acknowledge this; a live peer's next send would wait
+  sender.setAckWindow(1, std::chrono::seconds(30));
+  ASSERT_TRUE(sender.sendMessage("m0", "DB"));
+
+  std::thread watcher([&]() { sender.start(); });
+  EXPECT_TRUE(waitFor([&]() { return !fs::exists(registration); },
+                      std::chrono::seconds(10)));
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(sender.sendMessage("m1", "DB"));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+  EXPECT_FALSE(sender.flush("DB", std::chrono::seconds(1)));
+
+  // collected once dead for longer than the retention, on a later GC pass
+  EXPECT_TRUE(waitFor([&]() { return !fs::exists(tempDir / "DB"); },
+                      std::chrono::seconds(20)));
+  EXPECT_TRUE(fs::exists(tempDir / "DA"));
+  EXPECT_TRUE(fs::exists(tempDir / "access_registry"));
+
+  // m0 went with the inbox: a new DB gets the next frame as seq 0
+  {
+    ::SPEED::SPEED peer("DB", ThreadMode::Single, tempDir);
+    std::atomic<int> got{0};
+    peer.setCallback([&](const PMessage &) { ++got; });
+    Running run(peer);
+    EXPECT_TRUE(sender.sendMessage("m2", "DB"));
+    EXPECT_TRUE(waitFor([&]() { return got.load() == 1; }));
+  }
+  sender.stop();
+  watcher.join();
+}
+
+TEST_F(DeadPeerTest, PeerInAnotherPidSpaceKeepsItsInbox) {
+  { ::SPEED::SPEED peer("DB", ThreadMode::Single, tempDir); }
+  // DB runs in another container: its pid is not one this host can probe
+  const pid_t pid = deadPid();
+  const fs::path registration = tempDir / "access_registry" / "DB.oregistry";
+  std::ofstream(registration) << "DB\n" << pid << "\nelsewhere\n";
+  std::ofstream(tempDir / "DB" / "claimed" / ".owner")
+      << pid << "\nelsewhere\n";
+
+  ::SPEED::SPEED sender("DA", ThreadMode::Single, tempDir);
+  sender.setInboxRetention(std::chrono::seconds(1));
+  {
+    Running run(sender);
+    // past a liveness check and two GC passes, within DB's heartbeat
+    std::this_thread::sleep_for(ProcessTable::kHeartbeatInterval +
+                                std::chrono::seconds(5));
+    EXPECT_TRUE(sender.sendMessage("m0", "DB"));
+  }
+  EXPECT_TRUE(fs::exists(registration));
+  EXPECT_TRUE(fs::exists(tempDir / "DB" / "claimed" / ".owner"));
+}
@@ -0,0 +1,58 @@
+#include "../include/EncryptionManager.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace SPEED;
+
+namespace {
+Message makeMessage(const std::string &text) {
+  Message msg;
+  msg.header.version = SPEED_VERSION;
+  msg.header.type = MessageType::MSG;
+  msg.header.sender = "Alice";
+  msg.header.reciever = "Bob";
+  msg.payload.assign(text.begin(), text.end());
+  return msg;
+}
+} // namespace
+
+// --- Tests ---
+
+TEST(EncryptionManagerTest, SessionKeysPairUpAcrossRoles) {
+  const auto alice = EncryptionManager::generateKeyPair();
+  const auto bob = EncryptionManager::generateKeyPair();
+  EncryptionManager::SessionKeys a, b;
+  ASSERT_TRUE(
+      EncryptionManager::deriveSessionKeys(alice, bob.public_key, true, a));
+  ASSERT_TRUE(
+      EncryptionManager::deriveSessionKeys(bob, alice.public_key, false, b));
+  EXPECT_EQ(a.tx, b.rx);
+  EXPECT_EQ(a.rx, b.tx);
+  EXPECT_NE(a.tx, a.rx);
+
+  Message msg = makeMessage("hello");
+  EncryptionManager::Encrypt(msg, a.tx);
+  ASSERT_TRUE(EncryptionManager::TryDecrypt(msg, b.rx));
+  EXPECT_EQ(std::string(msg.payload.begin(), msg.payload.end()), "hello");
+}
+
+TEST(EncryptionManagerTest, TryDecryptRejectsTheWrongKey) {
+  const auto key = EncryptionManager::deriveKey({1, 2, 3});
+  const auto other = EncryptionManager::deriveKey({4, 5, 6});
+  Message msg = makeMessage("hello");
+  EncryptionManager::Encrypt(msg, key);
+  const std::vector<uint8_t> sealed = msg.payload;
+
+  EXPECT_FALSE(EncryptionManager::TryDecrypt(msg, other));
+  msg.payload = sealed;
+  EXPECT_THROW(EncryptionManager::Decrypt(msg, other), std::runtime_error);
+
+  // the header is authenticated too
+  msg.payload = sealed;
+  msg.header.seq_num += 1;
+  EXPECT_FALSE(EncryptionManager::TryDecrypt(msg, key));
+  msg.payload = sealed;
+  msg.header.seq_num -= 1;
+  EXPECT_TRUE(EncryptionManager::TryDecrypt(msg, key));
+  EXPECT_EQ(std::string(msg.payload.begin(), msg.payload.end()), "hello");
+}
@@ -0,0 +1,173 @@
+#include "../include/FlowControl.hpp"
+#include "../include/SPEED.hpp"
+#include "TestSupport.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+// any id works; a non-zero one also exercises PeerMap growth
+constexpr PeerId kBob = 3;
+
+namespace {
+class CreditFlowTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "speed_credit_flow_test";
+    fs::remove_all(tempDir);
+    fs::create_directories(tempDir);
+  }
+  void TearDown() override { fs::remove_all(tempDir); }
+};
+} // namespace
+
+// --- Tests ---
+
+TEST(CreditLedgerTest, UnknownPeerIsUnlimited) {
+  CreditLedger ledger;
+  EXPECT_FALSE(ledger.isKnown(kBob));
+  EXPECT_TRUE(ledger.canSend(kBob, 1 << 20));
+}
+
+TEST(CreditLedgerTest, MessageLimitBlocksUntilCreditArrives) {
+  CreditLedger ledger;
+  ledger.setLimits(kBob, 2, 0);
+  EXPECT_TRUE(ledger.canSend(kBob, 10));
+  ledger.onSent(kBob, 10);
+  ledger.onSent(kBob, 10);
+  EXPECT_FALSE(ledger.canSend(kBob, 10));
+
+  ledger.onCredit(kBob, 1, 10, 2, 0);
+  EXPECT_TRUE(ledger.canSend(kBob, 10));
+  auto st = ledger.state(kBob);
+  EXPECT_EQ(st.in_flight_messages, 1u);
+  EXPECT_EQ(st.in_flight_bytes, 10u);
+}
+
+TEST(CreditLedgerTest, ByteLimitAllowsOversizedFrameIntoEmptyInbox) {
+  CreditLedger ledger;
+  ledger.setLimits(kBob, 0, 100);
+  EXPECT_TRUE(ledger.canSend(kBob, 500)); // nothing in flight
+  ledger.onSent(kBob, 500);
+  EXPECT_FALSE(ledger.canSend(kBob, 1));
+  ledger.onCredit(kBob, 1, 500, 0, 100);
+  EXPECT_TRUE(ledger.canSend(kBob, 60));
+  ledger.onSent(kBob, 60);
+  EXPECT_FALSE(ledger.canSend(kBob, 60));
+}
+
+TEST(CreditLedgerTest, StaleOrDuplicateCreditIsIgnored) {
+  CreditLedger ledger;
+  ledger.setLimits(kBob, 10, 0);
+  for (int i = 0; i < 5; ++i)
+    ledger.onSent(kBob, 1);
+  ledger.onCredit(kBob, 4, 4, 10, 0);
+  ledger.onCredit(kBob, 2, 2, 10, 0); // reordered older report
+  EXPECT_EQ(ledger.state(kBob).in_flight_messages, 1u);
+  ledger.onCredit(kBob, 99, 99, 10, 0); // cannot consume more than sent
+  EXPECT_EQ(ledger.state(kBob).in_flight_messages, 0u);
+}
+
+TEST(CreditLedgerTest, CreditFrameUpdatesLimits) {
+  CreditLedger ledger;
+  ledger.setLimits(kBob, 0, 0);
+  ledger.onSent(kBob, 1);
+  ledger.onCredit(kBob, 0, 0, 1, 0);
+  EXPECT_FALSE(ledger.canSend(kBob, 1));
+  EXPECT_EQ(ledger.state(kBob).max_messages, 1u);
+}
+
+TEST(CreditLedgerTest, AdvertisementRoundTrip) {
+  fs::path file = fs::temp_directory_path() / "speed_credit_test.credit";
+  fs::remove(file);
+  uint64_t msgs = 0, bytes = 0;
+  EXPECT_FALSE(CreditLedger::readAdvertisement(file, msgs, bytes));
+
+  ASSERT_TRUE(CreditLedger::writeAdvertisement(file, 1000, 1 << 20));
+  EXPECT_TRUE(CreditLedger::readAdvertisement(file, msgs, bytes));
+  EXPECT_EQ(msgs, 1000u);
+  EXPECT_EQ(bytes, 1u << 20);
+  fs::remove(file);
+}
+
+TEST_F(CreditFlowTest, SenderStopsAtTheLimitAndResumesOnCredit) {
+  ::SPEED::SPEED reciever("CB", ThreadMode::Single, tempDir);
+  reciever.setInboxLimit(3);
+  std::mutex mtx;
+  std::vector<std::string> delivered;
+  reciever.setCallback([&](const PMessage &msg) {
+    std::lock_guard<std::mutex> lock(mtx);
+    delivered.push_back(msg.message);
+  });
+  ::SPEED::SPEED sender("CA", ThreadMode::Single, tempDir);
+  for (int i = 0; i < 3; ++i)
+    ASSERT_TRUE(sender.sendMessage("m" + std::to_string(i), "CB"));
+  EXPECT_EQ(sender.getCreditState("CB").in_flight_messages, 3u);
+
+  std::thread sender_watcher([&]() { sender.start(); });
+  std::atomic<bool> sent{false};
+  std::thread fourth([&]() {
+    EXPECT_TRUE(sender.sendMessage("m3", "CB")); // Block is the default
+    sent = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  EXPECT_FALSE(sent.load());
+
+  std::thread reciever_watcher([&]() { reciever.start(); });
+  EXPECT_TRUE(waitFor([&]() { return sent.load(); }));
+  fourth.join();
+  EXPECT_TRUE(waitFor([&]() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return delivered.size() == 4;
+  }));
+  EXPECT_TRUE(waitFor([&]() {
+    return sender.getCreditState("CB").in_flight_messages == 0;
+  }));
+  reciever.stop();
+  sender.stop();
+  reciever_watcher.join();
+  sender_watcher.join();
+  EXPECT_EQ(delivered, (std::vector<std::string>{"m0", "m1", "m2", "m3"}));
+}
+
+TEST_F(CreditFlowTest, BufferedMessagesGoOutAsCreditReturns) {
+  ::SPEED::SPEED reciever("CB", ThreadMode::Single, tempDir);
+  reciever.setInboxLimit(2);
+  std::mutex mtx;
+  std::vector<std::string> delivered;
+  reciever.setCallback([&](const PMessage &msg) {
+    std::lock_guard<std::mutex> lock(mtx);
+    delivered.push_back(msg.message);
+  });
+  ::SPEED::SPEED sender("CA", ThreadMode::Single, tempDir);
+  sender.setCreditPolicy(CreditPolicy::Buffer);
+  for (int i = 0; i < 6; ++i)
+    ASSERT_TRUE(sender.sendMessage("m" + std::to_string(i), "CB"));
+  CreditState state = sender.getCreditState("CB");
+  EXPECT_EQ(state.in_flight_messages, 2u);
+  EXPECT_EQ(state.buffered_messages, 4u);
+
+  std::thread sender_watcher([&]() { sender.start(); });
+  std::thread reciever_watcher([&]() { reciever.start(); });
+  EXPECT_TRUE(waitFor([&]() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return delivered.size() == 6;
+  }));
+  reciever.stop();
+  sender.stop();
+  reciever_watcher.join();
+  sender_watcher.join();
+  state = sender.getCreditState("CB");
+  EXPECT_EQ(state.buffered_messages, 0u);
+  EXPECT_EQ(delivered, (std::vector<std::string>{"m0", "m1", "m2", "m3",
+                                                 "m4", "m5"}));
+}
@@ -0,0 +1,196 @@
+#include "../include/InboxScanner.hpp"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <regex>
+#include <set>
+#include <string>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+// --- Tests ---
+
+TEST(InboxScannerTest, ParsesFrameNames) {
+  auto frame = parseFrameName(
+      "20251001225401123_Alice_2_42_0f8c6a1e-1b2c-4d3e-8f90-a1b2c3d4e5f6."
+      "ospeed");
+  ASSERT_TRUE(frame.has_value());
+  EXPECT_EQ(frame->sender, "Alice");
+  EXPECT_EQ(frame->lane, 2u);
+  EXPECT_EQ(frame->seq, 42);
+
+  // underscores inside the sender name are fine
+  frame = parseFrameName("1_Proc_2_0_7_abc.ospeed");
+  ASSERT_TRUE(frame.has_value());
+  EXPECT_EQ(frame->sender, "Proc_2");
+  EXPECT_EQ(frame->lane, 0u);
+  EXPECT_EQ(frame->seq, 7);
+}
+
+TEST(InboxScannerTest, AgreesWithTheRegexItReplaces) {
+  const std::regex re(
+      R"((\d+)_([A-Za-z0-9_]+)_(\d)_(\d+)_([A-Za-z0-9-]+)\.ospeed)");
+  const char *names[] = {
+      "1_A_1_2_u.ospeed",      "1_A_1_2_u.ispeed",   "_A_1_2_u.ospeed",
+      "1__1_2_u.ospeed",       "1_A_12_2_u.ospeed",  "1_A_1__u.ospeed",
+      "1_A_1_2_.ospeed",       "1_A_1_2_u_v.ospeed", "x_A_1_2_u.ospeed",
+      "1_A.B_1_2_u.ospeed",    "1_A_1_2_u.ospeed~",  "1_A_B_C_1_2_u.ospeed",
+      "1_A_1_-2_u.ospeed",     ".ospeed",            "1_A_1_2_u-.ospeed",
+      "1_A_x_2_u.ospeed",      "1_A_1_2x_u.ospeed",  ".credit",
+  };
+  for (const char *name : names) {
+    std::cmatch m;
+    const bool matched = std::regex_match(name, m, re);
+    const auto frame = parseFrameName(name);
+    EXPECT_EQ(frame.has_value(), matched) << name;
+    if (matched && frame.has_value()) {
+      EXPECT_EQ(frame->sender, m[2].str()) << name;
+      EXPECT_EQ(frame->seq, std::stoll(m[4].str())) << name;
+    }
+  }
+}
+
+TEST(InboxScannerTest, RejectsOutOfRangeFields) {
+  EXPECT_FALSE(parseFrameName("1_A_7_2_u.ospeed").has_value()); // lane
+  EXPECT_FALSE(
+      parseFrameName("1_A_1_99999999999999999999_u.ospeed").has_value());
+}
+
+TEST(InboxScannerTest, ScanListsRegularFilesOnEveryPass) {
+  const fs::path dir = fs::temp_directory_path() / "speed_inbox_scanner_test";
+  fs::remove_all(dir);
+  fs::create_directories(dir / "subdir");
+  std::ofstream(dir / "1_A_1_0_u.ospeed");
+  std::ofstream(dir / ".credit");
+
+  InboxScanner scanner(dir);
+  std::set<std::string> seen;
+  auto collect = [&](std::string_view name) { seen.emplace(name); };
+  EXPECT_EQ(scanner.scan(collect), 2u);
+  EXPECT_EQ(seen, (std::set<std::string>{"1_A_1_0_u.ospeed", ".credit"}));
+
+  // the same scanner picks up files created after the first pass
+  std::ofstream(dir / "1_A_1_1_u.ospeed");
+  seen.clear();
+  EXPECT_EQ(scanner.scan(collect), 3u);
+  EXPECT_TRUE(seen.count("1_A_1_1_u.ospeed"));
+  fs::remove_all(dir);
+}
+
+TEST(InboxScannerTest, ShardedInboxListsOnlyChangedShards) {
+  const fs::path dir = fs::temp_directory_path() / "speed_sharded_inbox_test";
+  fs::remove_all(dir);
+  fs::create_directories(dir / "Alice");
+  fs::create_directories(dir / "Bob");
+  std::ofstream(dir / "Alice" / "1_Alice_1_0_u.ospeed");
+  std::ofstream(dir / "Bob" / "1_Bob_1_0_u.ospeed");
+  // age everything past the settle time so unchanged shards can be skipped
+  const auto old = fs::file_time_type::clock::now() - std::chrono::seconds(5);
+  for (const char *name : {"Alice", "Bob"})
+    fs::last_write_time(dir / name, old);
+  fs::last_write_time(dir, old);
+
+  ShardedInbox inbox(dir);
+  std::set<std::string> seen;
+  auto collect = [&](std::string_view shard, std::string_view name) {
+    seen.emplace(std::string(shard) + "/" + std::string(name));
+    return true;
+  };
+  EXPECT_EQ(inbox.scan(collect), 2u);
+  EXPECT_EQ(inbox.pending(), 2u);
+  EXPECT_EQ(inbox.scan(collect), 0u);
+
+  std::ofstream(dir / "Bob" / "1_Bob_1_1_u.ospeed");
+  seen.clear();
+  EXPECT_EQ(inbox.scan(collect), 1u);
+  EXPECT_EQ(seen.count("Bob/1_Bob_1_1_u.ospeed"), 1u);
+  EXPECT_EQ(seen.count("Alice/1_Alice_1_0_u.ospeed"), 0u);
+  EXPECT_EQ(inbox.pending(), 3u);
+
+  inbox.touch("Alice");
+  seen.clear();
+  inbox.scan(collect);
+  EXPECT_EQ(seen.count("Alice/1_Alice_1_0_u.ospeed"), 1u);
+  fs::remove_all(dir);
+}
+
+TEST(InboxScannerTest, ShardSetIsDiffedWhenTheRootChanges) {
+  const fs::path dir = fs::temp_directory_path() / "speed_shard_set_test";
+  fs::remove_all(dir);
+  fs::create_directories(dir / "Alice");
+  fs::create_directories(dir / "claimed");
+  std::ofstream(dir / "Alice" / "1_Alice_1_0_u.ospeed");
+  std::ofstream(dir / "claimed" / "1_Alice_1_1_u.ospeed");
+  const auto old = fs::file_time_type::clock::now() - std::chrono::seconds(5);
+  for (const char *name : {"Alice", "claimed"})
+    fs::last_write_time(dir / name, old);
+  fs::last_write_time(dir, old);
+
+  ShardedInbox inbox(dir);
+  std::set<std::string> seen;
+  auto collect = [&](std::string_view shard, std::string_view name) {
+    seen.emplace(std::string(shard) + "/" + std::string(name));
+    return true;
+  };
+  // work-queue claims are not a sender
+  EXPECT_EQ(inbox.scan(collect), 1u);
+  EXPECT_EQ(seen, std::set<std::string>{"Alice/1_Alice_1_0_u.ospeed"});
+
+  // a new sender is listed without relisting the settled one
+  fs::create_directories(dir / "Bob");
+  std::ofstream(dir / "Bob" / "1_Bob_1_0_u.ospeed");
+  seen.clear();
+  EXPECT_EQ(inbox.scan(collect), 1u);
+  EXPECT_EQ(seen, std::set<std::string>{"Bob/1_Bob_1_0_u.ospeed"});
+  EXPECT_EQ(inbox.pending(), 2u);
+
+  // a shard removed and created again is reopened
+  fs::remove_all(dir / "Alice");
+  fs::create_directories(dir / "Alice");
+  std::ofstream(dir / "Alice" / "1_Alice_1_5_u.ospeed");
+  seen.clear();
+  inbox.scan(collect);
+  EXPECT_EQ(seen.count("Alice/1_Alice_1_5_u.ospeed"), 1u);
+
+  fs::remove_all(dir / "Bob");
+  fs::last_write_time(dir, old);
+  inbox.scan(collect);
+  EXPECT_EQ(inbox.pending(), 1u);
+  fs::remove_all(dir);
+}
+
+TEST(InboxScannerTest, ScanParallelListsEveryShardOnce) {
+  const fs::path dir = fs::temp_directory_path() / "speed_parallel_inbox_test";
+  fs::remove_all(dir);
+  std::set<std::string> expected;
+  for (int s = 0; s < 16; ++s) {
+    const std::string shard = "P" + std::to_string(s);
+    fs::create_directories(dir / shard);
+    for (int i = 0; i < 8; ++i) {
+      const std::string name =
+          "1_" + shard + "_1_" + std::to_string(i) + "_u.ospeed";
+      std::ofstream(dir / shard / name);
+      expected.insert(shard + "/" + name);
+    }
+  }
+
+  ShardedInbox inbox(dir);
+  std::mutex mtx;
+  std::set<std::string> seen;
+  size_t visits = 0;
+  EXPECT_EQ(inbox.scanParallel(
+                [&](std::string_view shard, std::string_view name) {
+                  std::lock_guard<std::mutex> lock(mtx);
+                  ++visits;
+                  seen.emplace(std::string(shard) + "/" + std::string(name));
+                  return true;
+                },
+                4),
+            16u);
+  EXPECT_EQ(visits, expected.size());
+  EXPECT_EQ(seen, expected);
+  EXPECT_EQ(inbox.pending(), expected.size());
+  fs::remove_all(dir);
+}
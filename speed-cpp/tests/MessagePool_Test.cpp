@@ -0,0 +1,60 @@
+#include "../include/MessagePool.hpp"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace SPEED;
+
+// --- Tests ---
+
+TEST(MessagePoolTest, ReleasedMessageIsReused) {
+  MessagePool pool;
+  const Message *first = nullptr;
+  const uint8_t *buffer = nullptr;
+  {
+    MessagePool::Lease msg = pool.acquire(100);
+    msg->payload.resize(100);
+    first = &*msg;
+    buffer = msg->payload.data();
+  }
+  MessagePool::Lease again = pool.acquire(200);
+  EXPECT_EQ(&*again, first);
+  EXPECT_EQ(again->payload.data(), buffer);
+  EXPECT_GE(again->payload.capacity(), 200u);
+
+  MessagePoolStats stats = pool.stats();
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.in_use, 1u);
+}
+
+TEST(MessagePoolTest, SizeClassesAreSeparate) {
+  MessagePool pool;
+  { MessagePool::Lease small = pool.acquire(64); }
+  // a small buffer cannot serve a large frame, so this one allocates
+  MessagePool::Lease large = pool.acquire(64 * 1024);
+  EXPECT_GE(large->payload.capacity(), 64u * 1024u);
+  EXPECT_EQ(pool.stats().misses, 2u);
+  EXPECT_EQ(pool.stats().cached, 1u);
+}
+
+TEST(MessagePoolTest, OversizedPayloadsAreNotKept) {
+  MessagePool pool;
+  { MessagePool::Lease huge = pool.acquire(4u << 20); }
+  EXPECT_EQ(pool.stats().cached, 0u);
+  EXPECT_EQ(pool.stats().in_use, 0u);
+}
+
+TEST(MessagePoolTest, TracksHighWaterMark) {
+  MessagePool pool;
+  {
+    std::vector<MessagePool::Lease> held;
+    for (int i = 0; i < 5; ++i)
+      held.push_back(pool.acquire(512));
+    EXPECT_EQ(pool.stats().in_use, 5u);
+  }
+  MessagePool::Lease one = pool.acquire(512);
+  MessagePoolStats stats = pool.stats();
+  EXPECT_EQ(stats.high_water, 5u);
+  EXPECT_EQ(stats.in_use, 1u);
+  EXPECT_EQ(stats.cached, 4u);
+}
@@ -0,0 +1,58 @@
+#include "../include/SPEED.hpp"
+#include "TestSupport.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+class MessageTTLTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "speed_ttl_test";
+    fs::remove_all(tempDir);
+    fs::create_directories(tempDir);
+  }
+  void TearDown() override { fs::remove_all(tempDir); }
+};
+
+// --- Tests ---
+
+// An expired frame is dropped unread, but still counts as consumed: the
+// sender gets its ACK and its credit back.
+TEST_F(MessageTTLTest, ExpiredFramesAreDroppedButAcknowledged) {
+  ::SPEED::SPEED reciever("TTB", ThreadMode::Single, tempDir);
+  reciever.setInboxLimit(2);
+  std::atomic<int> delivered{0};
+  reciever.setCallback([&](const PMessage &) { ++delivered; });
+
+  ::SPEED::SPEED sender("TTA", ThreadMode::Single, tempDir);
+  sender.setAckWindow(8);
+  sender.setCreditPolicy(CreditPolicy::Fail);
+  sender.setMessageTTL(std::chrono::milliseconds(50));
+  ASSERT_TRUE(sender.sendMessage("stale0", "TTB"));
+  ASSERT_TRUE(sender.sendMessage("stale1", "TTB"));
+  EXPECT_FALSE(sender.sendMessage("refused", "TTB")); // out of credit
+  EXPECT_EQ(sender.getCreditState("TTB").in_flight_messages, 2u);
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  {
+    Running run_sender(sender);
+    Running run_reciever(reciever);
+    ASSERT_TRUE(waitFor([&]() { return reciever.getExpiredCount() == 2; }));
+    EXPECT_TRUE(sender.flush("TTB", std::chrono::seconds(10)));
+    ASSERT_TRUE(waitFor([&]() {
+      return sender.getCreditState("TTB").in_flight_messages == 0;
+    }));
+  }
+  EXPECT_EQ(delivered.load(), 0);
+  EXPECT_EQ(sender.getAckedCount("TTB"), 2);
+  // the credit is usable again
+  sender.setMessageTTL(std::chrono::milliseconds(0));
+  EXPECT_TRUE(sender.sendMessage("fresh", "TTB"));
+}
@@ -0,0 +1,155 @@
+#include "../include/Metrics.hpp"
+#include "../include/SPEED.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+// --- Tests ---
+
+TEST(MetricsTest, BucketsCoverEveryValueWithinASixteenth) {
+  const uint64_t values[] = {0,    1,         15,
+                             16,   17,        1000,
+                             123456789, (uint64_t{1} << 40) + 12345,
+                             UINT64_MAX};
+  for (uint64_t value : values) {
+    const size_t bucket = LatencyHistogram::bucketOf(value);
+    ASSERT_LT(bucket, LatencyHistogram::kBuckets) << value;
+    const uint64_t lower = LatencyHistogram::lowerBound(bucket);
+    EXPECT_LE(lower, value) << value;
+    if (bucket + 1 < LatencyHistogram::kBuckets) {
+      EXPECT_GT(LatencyHistogram::lowerBound(bucket + 1), value) << value;
+    }
+    EXPECT_LE(value - lower, value / 16) << value;
+  }
+  // buckets are ordered and contiguous
+  for (size_t b = 1; b < LatencyHistogram::kBuckets; ++b)
+    ASSERT_EQ(LatencyHistogram::bucketOf(LatencyHistogram::lowerBound(b)), b);
+}
+
+TEST(MetricsTest, PercentilesComeFromTheBuckets) {
+  LatencyHistogram histogram;
+  for (uint64_t us = 1; us <= 1000; ++us)
+    histogram.record(std::chrono::microseconds(us));
+  const HistogramSnapshot snap = histogram.snapshot();
+  EXPECT_EQ(snap.count, 1000u);
+  EXPECT_EQ(snap.min_ns, 1000u);
+  EXPECT_EQ(snap.max_ns, 1000000u);
+  EXPECT_EQ(snap.sum_ns, 500500u * 1000u);
+  auto near = [](uint64_t got, uint64_t want) {
+    return got >= want && got - want <= want / 16;
+  };
+  EXPECT_TRUE(near(snap.p50_ns, 500000)) << snap.p50_ns;
+  EXPECT_TRUE(near(snap.p90_ns, 900000)) << snap.p90_ns;
+  EXPECT_TRUE(near(snap.p99_ns, 990000)) << snap.p99_ns;
+  EXPECT_EQ(snap.p999_ns, 1000000u); // capped at the maximum
+
+  EXPECT_EQ(LatencyHistogram().snapshot().count, 0u);
+}
+
+TEST(MetricsTest, CountersAreKeptPerPeer) {
+  PeerTable names;
+  const PeerId alice = names.intern("Alice");
+  names.intern("Bob"); // no traffic, left out of the snapshot
+  const PeerId carol = names.intern("Carol");
+
+  Metrics metrics;
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 4; ++t) {
+    writers.emplace_back([&]() {
+      for (int i = 0; i < 1000; ++i) {
+        metrics.peer(alice).sent.fetch_add(1);
+        metrics.peer(alice).sent_bytes.fetch_add(10);
+      }
+    });
+  }
+  for (std::thread &writer : writers)
+    writer.join();
+  metrics.peer(carol).drops.fetch_add(2);
+  metrics.record(Metrics::Histogram::Write, std::chrono::microseconds(5));
+
+  const MetricsSnapshot snap = metrics.snapshot(names);
+  ASSERT_EQ(snap.peers.size(), 2u);
+  EXPECT_EQ(snap.peers[0].peer, "Alice");
+  EXPECT_EQ(snap.peers[0].sent, 4000u);
+  EXPECT_EQ(snap.peers[0].sent_bytes, 40000u);
+  EXPECT_EQ(snap.peers[1].peer, "Carol");
+  EXPECT_EQ(snap.peers[1].drops, 2u);
+  EXPECT_EQ(snap.write.count, 1u);
+  EXPECT_EQ(snap.encrypt.count, 0u);
+
+  const std::string json = snap.toJson();
+  EXPECT_NE(json.find("{\"peer\":\"Alice\",\"sent\":4000,"), std::string::npos);
+  EXPECT_NE(json.find("\"write\":{\"count\":1,"), std::string::npos);
+}
+
+TEST(MetricsTest, PeerNamesAreEscapedInJson) {
+  PeerTable names;
+  Metrics metrics;
+  // a send may be addressed to any name, valid or not
+  metrics.peer(names.intern("a\"b\\c\n")).drops.fetch_add(1);
+  const std::string json = metrics.snapshot(names).toJson();
+  EXPECT_NE(json.find("{\"peer\":\"a\\\"b\\\\c\\n\","), std::string::npos);
+}
+
+TEST(MetricsTest, TrafficIsCountedAndDumped) {
+  const fs::path dir = fs::temp_directory_path() / "speed_metrics_test";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  // frames are only written into an existing inbox
+  { ::SPEED::SPEED first("MB", ThreadMode::Single, dir); }
+  {
+    ::SPEED::SPEED sender("MA", ThreadMode::Single, dir);
+    for (int i = 0; i < 5; ++i)
+      ASSERT_TRUE(sender.sendMessage("hello", "MB"));
+    const MetricsSnapshot sent = sender.getMetrics();
+    ASSERT_EQ(sent.peers.size(), 1u);
+    EXPECT_EQ(sent.peers[0].sent, 5u);
+    EXPECT_EQ(sent.peers[0].sent_bytes, 25u);
+    EXPECT_EQ(sent.encrypt.count, 5u);
+    EXPECT_EQ(sent.write.count, 5u);
+  }
+
+  ::SPEED::SPEED reciever("MB", ThreadMode::Single, dir);
+  int delivered = 0;
+  reciever.setCallback([&](const PMessage &) { ++delivered; });
+  reciever.setMetricsDump(std::chrono::seconds(1));
+  std::thread watcher([&]() { reciever.start(); });
+  const fs::path dump = dir / "metrics" / "MB.json";
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while ((reciever.getMetrics().end_to_end.count < 5 || !fs::exists(dump)) &&
+         std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  reciever.stop();
+  watcher.join();
+
+  const MetricsSnapshot snap = reciever.getMetrics();
+  EXPECT_EQ(delivered, 5);
+  EXPECT_EQ(snap.end_to_end.count, 5u);
+  EXPECT_GE(snap.decrypt.count, 5u);
+  EXPECT_GE(snap.scan.count, 1u);
+  EXPECT_EQ(snap.reorder_depth, 0u);
+  bool found = false;
+  for (const PeerMetrics &peer : snap.peers) {
+    if (peer.peer != "MA")
+      continue;
+    found = true;
+    EXPECT_EQ(peer.received, 5u);
+    EXPECT_EQ(peer.gaps, 0u);
+    EXPECT_EQ(peer.drops, 0u);
+  }
+  EXPECT_TRUE(found);
+
+  std::ifstream in(dump);
+  std::stringstream json;
+  json << in.rdbuf();
+  EXPECT_EQ(json.str().rfind("{\"peers\":[", 0), 0u);
+  fs::remove_all(dir);
+}
@@ -0,0 +1,61 @@
+#include "../include/PeerTable.hpp"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace SPEED;
+
+// --- Tests ---
+
+TEST(PeerTableTest, InternAssignsDenseStableIds) {
+  PeerTable peers;
+  PeerId a = peers.intern("Alice");
+  PeerId b = peers.intern("Bob");
+  EXPECT_EQ(a, 0u);
+  EXPECT_EQ(b, 1u);
+  EXPECT_EQ(peers.intern("Alice"), a);
+  EXPECT_EQ(peers.size(), 2u);
+
+  const std::string &alice = peers.name(a);
+  for (int i = 0; i < 1000; ++i)
+    peers.intern("P" + std::to_string(i));
+  // growing the table does not move existing names
+  EXPECT_EQ(&peers.name(a), &alice);
+  EXPECT_EQ(alice, "Alice");
+}
+
+TEST(PeerTableTest, FindDoesNotIntern) {
+  PeerTable peers;
+  EXPECT_FALSE(peers.find("Ghost").has_value());
+  EXPECT_EQ(peers.size(), 0u);
+  PeerId id = peers.intern("Ghost");
+  EXPECT_EQ(peers.find("Ghost"), id);
+  EXPECT_THROW(peers.name(id + 1), std::out_of_range);
+}
+
+TEST(PeerTableTest, ConcurrentInternAgreesOnIds) {
+  PeerTable peers;
+  std::vector<std::thread> threads;
+  std::vector<std::vector<PeerId>> seen(4);
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 200; ++i)
+        seen[t].push_back(peers.intern("P" + std::to_string(i)));
+    });
+  }
+  for (auto &th : threads)
+    th.join();
+  EXPECT_EQ(peers.size(), 200u);
+  for (int t = 1; t < 4; ++t)
+    EXPECT_EQ(seen[t], seen[0]);
+}
+
+TEST(PeerMapTest, GrowsOnTouchAndDefaultsUntouchedSlots) {
+  PeerMap<long long> m;
+  EXPECT_EQ(m.find(5), nullptr);
+  m[5] = 42;
+  EXPECT_EQ(m.size(), 6u);
+  ASSERT_NE(m.find(2), nullptr);
+  EXPECT_EQ(*m.find(2), 0);
+  EXPECT_EQ(*m.find(5), 42);
+}
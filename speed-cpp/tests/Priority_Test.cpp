@@ -0,0 +1,86 @@
+#include "../include/SPEED.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+class PriorityTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "speed_priority_test";
+    fs::remove_all(tempDir);
+    fs::create_directories(tempDir);
+  }
+  void TearDown() override { fs::remove_all(tempDir); }
+
+  // PONGs PB has answered so far; PA does not run, so they stay put.
+  size_t pongs() {
+    std::error_code ec;
+    size_t count = 0;
+    for (const auto &entry :
+         fs::directory_iterator(tempDir / "PA" / "PB", ec)) {
+      (void)entry;
+      ++count;
+    }
+    return count;
+  }
+};
+
+// --- Tests ---
+
+// With every lane backed up, Control is handled first and the data lanes
+// go highest first. The data lanes share a budget per watcher pass, so a
+// PING that arrives behind a long Low backlog is answered within one
+// budget instead of after the whole backlog.
+TEST_F(PriorityTest, LanesDrainHighestFirstWithinABudget) {
+  constexpr int kLow = 3 * 1024;
+  ::SPEED::SPEED reciever("PB", ThreadMode::Single, tempDir);
+  ::SPEED::SPEED sender("PA", ThreadMode::Single, tempDir);
+  for (int i = 0; i < kLow; ++i)
+    ASSERT_TRUE(sender.sendMessage("low", "PB", Priority::Low));
+  for (int i = 0; i < 2; ++i)
+    ASSERT_TRUE(sender.sendMessage("normal", "PB", Priority::Normal));
+  for (int i = 0; i < 2; ++i)
+    ASSERT_TRUE(sender.sendMessage("high", "PB", Priority::High));
+  sender.ping("PB");
+
+  std::vector<std::string> order;
+  size_t pongs_at_first = 0;
+  int second_pong_at = -1;
+  std::atomic<bool> done{false};
+  reciever.setCallback([&](const PMessage &msg) {
+    if (order.empty())
+      pongs_at_first = pongs();
+    order.push_back(msg.message);
+    if (order.size() == 10)
+      sender.ping("PB"); // lands behind the rest of the Low backlog
+    if (second_pong_at < 0 && pongs() == 2)
+      second_pong_at = static_cast<int>(order.size());
+    if (order.size() == kLow + 4)
+      done = true;
+  });
+  std::thread watcher([&]() { reciever.start(); });
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(20);
+  while (!done && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  reciever.stop();
+  watcher.join();
+
+  ASSERT_EQ(order.size(), static_cast<size_t>(kLow + 4));
+  EXPECT_EQ(pongs_at_first, 1u); // the PING went before any data
+  EXPECT_EQ(std::vector<std::string>(order.begin(), order.begin() + 4),
+            (std::vector<std::string>{"high", "high", "normal", "normal"}));
+  EXPECT_EQ(std::count(order.begin(), order.end(), "low"), kLow);
+  ASSERT_GT(second_pong_at, 0);
+  EXPECT_LE(second_pong_at, 1024 + 1);
+}
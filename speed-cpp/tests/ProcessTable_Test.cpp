@@ -0,0 +1,182 @@
+#include "../include/AccessRegistry.hpp"
+#include "../include/ProcessTable.hpp"
+#include "TestSupport.hpp"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+#include <unistd.h>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+class ProcessTableTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "speed_process_table_test";
+    fs::remove_all(tempDir);
+    fs::create_directories(tempDir / "access_registry");
+  }
+  void TearDown() override { fs::remove_all(tempDir); }
+
+  // Rewrites the owner word and claim stamp of the slot holding `name`, as
+  // a process caught halfway through a claim would have left them. The
+  // owner keeps this process' pid space tag unless it is `foreign`. Slots
+  // are 128 bytes after a 64 byte header; the name sits at offset 32, the
+  // heartbeat at 24 and the claim stamp at 96.
+  void forgeSlot(const std::string &name, uint32_t pid, uint32_t state,
+                 uint64_t claimed_ms, bool foreign = false) {
+    std::fstream file(tempDir / ".process_table",
+                      std::ios::in | std::ios::out | std::ios::binary);
+    const std::streamoff slot = find(file, name);
+    ASSERT_GE(slot, 0) << name << " is not in the table";
+    uint64_t owner = 0;
+    file.seekg(slot);
+    file.read(reinterpret_cast<char *>(&owner), sizeof(owner));
+    const uint64_t space = foreign ? 0 : owner & 0xFFFFFFFCull;
+    owner = static_cast<uint64_t>(pid) << 32 | space | state;
+    file.seekp(slot);
+    file.write(reinterpret_cast<const char *>(&owner), sizeof(owner));
+    file.seekp(slot + 96);
+    file.write(reinterpret_cast<const char *>(&claimed_ms),
+               sizeof(claimed_ms));
+  }
+
+  void forgeHeartbeat(const std::string &name, uint64_t heartbeat_ms) {
+    std::fstream file(tempDir / ".process_table",
+                      std::ios::in | std::ios::out | std::ios::binary);
+    const std::streamoff slot = find(file, name);
+    ASSERT_GE(slot, 0) << name << " is not in the table";
+    file.seekp(slot + 24);
+    file.write(reinterpret_cast<const char *>(&heartbeat_ms),
+               sizeof(heartbeat_ms));
+  }
+
+  static std::streamoff find(std::fstream &file, const std::string &name) {
+    for (size_t i = 0; i < ProcessTable::kSlots; ++i) {
+      const std::streamoff slot = 64 + static_cast<std::streamoff>(i) * 128;
+      char stored[64] = {};
+      file.seekg(slot + 32);
+      file.read(stored, sizeof(stored));
+      if (name == stored)
+        return slot;
+    }
+    return -1;
+  }
+};
+
+// --- Tests ---
+
+TEST_F(ProcessTableTest, ClaimsAreVisibleThroughEveryMapping) {
+  ProcessTable a(tempDir / ".process_table");
+  ProcessTable b(tempDir / ".process_table");
+  const uint64_t g0 = b.generation();
+
+  ASSERT_TRUE(a.claim("Alice", 5));
+  EXPECT_GT(b.generation(), g0);
+  auto alice = b.find("Alice");
+  ASSERT_TRUE(alice.has_value());
+  EXPECT_EQ(alice->capabilities, 5u);
+  EXPECT_GT(alice->heartbeat_ms, 0u);
+  EXPECT_FALSE(b.find("Bob").has_value());
+
+  ASSERT_TRUE(b.claim("Bob", 5));
+  std::set<std::string> names;
+  a.forEach([&](const ProcessInfo &info) { names.insert(info.name); });
+  EXPECT_EQ(names, (std::set<std::string>{"Alice", "Bob"}));
+
+  a.release();
+  EXPECT_FALSE(b.find("Alice").has_value());
+}
+
+TEST_F(ProcessTableTest, ReclaimingANameTakesOverItsSlot) {
+  ProcessTable crashed(tempDir / ".process_table");
+  ProcessTable restarted(tempDir / ".process_table");
+  ASSERT_TRUE(crashed.claim("Alice", 1));
+  ASSERT_TRUE(restarted.claim("Alice", 2));
+
+  size_t entries = 0;
+  restarted.forEach([&](const ProcessInfo &) { ++entries; });
+  EXPECT_EQ(entries, 1u);
+
+  // the stale owner letting go must not evict the new one
+  crashed.release();
+  auto alice = restarted.find("Alice");
+  ASSERT_TRUE(alice.has_value());
+  EXPECT_EQ(alice->capabilities, 2u);
+}
+
+TEST_F(ProcessTableTest, RegistryTracksTableMembership) {
+  AccessRegistry alice(tempDir / "access_registry", "Alice");
+  AccessRegistry bob(tempDir / "access_registry", "Bob");
+  ASSERT_TRUE(alice.useProcessTable(tempDir / ".process_table", 5));
+  EXPECT_FALSE(alice.checkGlobalRegistry("Bob")); // Bob is not in the table
+
+  ASSERT_TRUE(bob.useProcessTable(tempDir / ".process_table", 5));
+  alice.refresh();
+  EXPECT_TRUE(alice.checkGlobalRegistry("Bob"));
+
+  bob.removeAccessFile();
+  alice.refresh();
+  EXPECT_FALSE(alice.checkGlobalRegistry("Bob"));
+}
+
+TEST_F(ProcessTableTest, AbandonedClaimIsReclaimed) {
+  constexpr uint32_t kClaiming = 1;
+  ProcessTable table(tempDir / ".process_table");
+  ASSERT_TRUE(table.claim("Alice", 1));
+  table.release();
+
+  // the claimer died between taking the slot and publishing it
+  forgeSlot("Alice", deadPid(), kClaiming, 0);
+  ASSERT_FALSE(table.find("Alice").has_value());
+  ASSERT_TRUE(table.claim("Alice", 2));
+  EXPECT_EQ(table.find("Alice")->capabilities, 2u);
+  table.release();
+
+  // a live claimer that has been at it for far too long is passed over too
+  forgeSlot("Alice", static_cast<uint32_t>(::getppid()), kClaiming,
+            Utils::getEpochMillis() - 60'000);
+  ASSERT_TRUE(table.claim("Alice", 3));
+
+  size_t entries = 0;
+  table.forEach([&](const ProcessInfo &) { ++entries; });
+  EXPECT_EQ(entries, 1u);
+}
+
+TEST_F(ProcessTableTest, LiveOwnerKeepsItsName) {
+  constexpr uint32_t kLive = 2;
+  ProcessTable table(tempDir / ".process_table");
+  ProcessTable other(tempDir / ".process_table");
+  ASSERT_TRUE(table.claim("Alice", 1));
+
+  // another process that is still running holds the name
+  forgeSlot("Alice", static_cast<uint32_t>(::getppid()), kLive, 0);
+  EXPECT_FALSE(other.claim("Alice", 2));
+  EXPECT_EQ(table.find("Alice")->capabilities, 1u);
+
+  // once it is gone the name is free to take over
+  forgeSlot("Alice", deadPid(), kLive, 0);
+  ASSERT_TRUE(other.claim("Alice", 2));
+  EXPECT_EQ(table.find("Alice")->capabilities, 2u);
+}
+
+TEST_F(ProcessTableTest, ForeignHolderIsJudgedByItsHeartbeat) {
+  constexpr uint32_t kLive = 2;
+  ProcessTable table(tempDir / ".process_table");
+  ProcessTable other(tempDir / ".process_table");
+  ASSERT_TRUE(table.claim("Alice", 1));
+
+  // a pid from another pid space means nothing here, dead or not
+  forgeSlot("Alice", deadPid(), kLive, 0, true);
+  EXPECT_FALSE(table.find("Alice")->local);
+  EXPECT_FALSE(other.claim("Alice", 2));
+
+  // its heartbeat stopped long ago
+  forgeHeartbeat("Alice", Utils::getEpochMillis() - 60'000);
+  ASSERT_TRUE(other.claim("Alice", 2));
+  EXPECT_TRUE(table.find("Alice")->local);
+}
@@ -0,0 +1,86 @@
+#include "../include/SPEED.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+class QuarantineTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "speed_quarantine_test";
+    fs::remove_all(tempDir);
+    fs::create_directories(tempDir);
+  }
+  void TearDown() override { fs::remove_all(tempDir); }
+
+  // The Normal-lane frame `seq` that QA left in QB's inbox.
+  fs::path frame(long long seq) {
+    for (const auto &entry : fs::directory_iterator(tempDir / "QB" / "QA")) {
+      const std::string name = entry.path().filename().string();
+      const auto parsed = parseFrameName(name);
+      if (parsed && parsed->seq == seq &&
+          parsed->lane == static_cast<size_t>(Priority::Normal))
+        return entry.path();
+    }
+    return {};
+  }
+};
+
+// --- Tests ---
+
+TEST_F(QuarantineTest, PoisonFramesAreSetAsideAndDeliveryContinues) {
+  // frames are only written into an existing inbox
+  { ::SPEED::SPEED first("QB", ThreadMode::Single, tempDir); }
+  {
+    ::SPEED::SPEED sender("QA", ThreadMode::Single, tempDir);
+    for (int i = 0; i < 4; ++i)
+      ASSERT_TRUE(sender.sendMessage("m" + std::to_string(i), "QB"));
+  }
+  std::ofstream(frame(1), std::ios::trunc) << "garbage";
+  {
+    // flip the last byte of the authentication tag
+    std::fstream tampered(frame(2),
+                          std::ios::in | std::ios::out | std::ios::binary);
+    tampered.seekg(-1, std::ios::end);
+    const char last = static_cast<char>(tampered.get());
+    tampered.seekp(-1, std::ios::end);
+    tampered.put(static_cast<char>(last ^ 0x01));
+  }
+
+  std::vector<std::string> delivered;
+  std::vector<QuarantinedFrame> poisoned;
+  ::SPEED::SPEED reciever("QB", ThreadMode::Single, tempDir);
+  reciever.setCallback(
+      [&](const PMessage &msg) { delivered.push_back(msg.message); });
+  reciever.setErrorCallback(
+      [&](const QuarantinedFrame &frame) { poisoned.push_back(frame); });
+  std::thread watcher([&]() { reciever.start(); });
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (reciever.getQuarantinedCount() < 2 &&
+         std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  reciever.stop();
+  watcher.join();
+
+  EXPECT_EQ(delivered, (std::vector<std::string>{"m0", "m3"}));
+  EXPECT_EQ(reciever.getQuarantinedCount(), 2u);
+  ASSERT_EQ(poisoned.size(), 2u);
+  EXPECT_EQ(poisoned[0].sender, "QA");
+  EXPECT_EQ(poisoned[0].reason, "Malformed frame header");
+  EXPECT_EQ(poisoned[1].reason, "decryption failed");
+  for (const QuarantinedFrame &frame : poisoned) {
+    EXPECT_EQ(frame.file.parent_path(), tempDir / "quarantine" / "QB");
+    EXPECT_TRUE(fs::exists(frame.file));
+    EXPECT_TRUE(fs::exists(frame.file.string() + ".reason"));
+  }
+}
@@ -0,0 +1,68 @@
+#include "../include/SPEED.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+class RecoveryTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "speed_recovery_test";
+    fs::remove_all(tempDir);
+    fs::create_directories(tempDir);
+  }
+  void TearDown() override { fs::remove_all(tempDir); }
+
+  // A file abandoned by a writer `age` ago.
+  fs::path plant(const fs::path &file, std::chrono::seconds age) {
+    fs::create_directories(file.parent_path());
+    std::ofstream(file) << "partial";
+    fs::last_write_time(file, fs::file_time_type::clock::now() - age);
+    return file;
+  }
+};
+
+// --- Tests ---
+
+TEST_F(RecoveryTest, StartIndexesBacklogAndRemovesOrphans) {
+  // frames are only written into an existing inbox
+  { ::SPEED::SPEED first("RecB", ThreadMode::Single, tempDir); }
+  {
+    ::SPEED::SPEED sender("RecA", ThreadMode::Single, tempDir);
+    sender.addProcess("RecB");
+    for (int i = 0; i < 5; ++i)
+      ASSERT_TRUE(sender.sendMessage("m", "RecB"));
+  }
+  const fs::path shard = tempDir / "RecB" / "RecA";
+  const auto old = std::chrono::minutes(5);
+  const fs::path stale = plant(shard / "1_RecA_1_9_u.ispeed", old);
+  const fs::path fresh = plant(shard / "1_RecA_1_8_u.ispeed", {});
+  const fs::path staged = plant(tempDir / ".outbox" / "u.ispeed", old);
+
+  std::atomic<int> got{0};
+  ::SPEED::SPEED reciever("RecB", ThreadMode::Single, tempDir);
+  reciever.setCallback([&](const PMessage &) { ++got; });
+  std::thread watcher([&]() { reciever.start(); });
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (got.load() < 5 && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  reciever.stop();
+  watcher.join();
+
+  EXPECT_EQ(got.load(), 5);
+  const RecoveryStats stats = reciever.getRecoveryStats();
+  // plus the sender's CON_REQ and EXIT_NOTIF
+  EXPECT_EQ(stats.frames, 5u + 2u);
+  EXPECT_EQ(stats.orphans, 2u);
+  EXPECT_FALSE(fs::exists(stale));
+  EXPECT_FALSE(fs::exists(staged));
+  EXPECT_TRUE(fs::exists(fresh)); // its writer may still be running
+}
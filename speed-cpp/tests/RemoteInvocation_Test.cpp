@@ -0,0 +1,159 @@
+#include "../include/RemoteInvocation.hpp"
+#include "../include/SPEED.hpp"
+#include "../include/ThreadPool.hpp"
+#include "TestSupport.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+class RemoteInvocationE2ETest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "speed_rfi_test";
+    fs::remove_all(tempDir);
+    fs::create_directories(tempDir);
+  }
+  void TearDown() override { fs::remove_all(tempDir); }
+};
+
+// --- Tests ---
+
+TEST(RemoteInvocationTest, BatchRoundTrip) {
+  std::vector<InvokeCall> calls = {{"add", {"10", "20"}},
+                                   {"noop", {}},
+                                   {"echo", {"", "with space", "x"}}};
+
+  auto bytes = RemoteInvocation::encodeBatch(calls);
+  auto decoded = RemoteInvocation::decodeBatch(bytes);
+
+  ASSERT_EQ(decoded.size(), calls.size());
+  for (size_t i = 0; i < calls.size(); ++i) {
+    EXPECT_EQ(decoded[i].method, calls[i].method);
+    EXPECT_EQ(decoded[i].args, calls[i].args);
+  }
+}
+
+TEST(RemoteInvocationTest, ResultsRoundTrip) {
+  std::vector<InvokeResult> results = {
+      {"add", InvokeStatus::OK, ""},
+      {"missing", InvokeStatus::NOT_FOUND, "method not registered"},
+      {"boom", InvokeStatus::FAILED, "stoi"}};
+
+  auto decoded =
+      RemoteInvocation::decodeResults(RemoteInvocation::encodeResults(results));
+
+  ASSERT_EQ(decoded.size(), results.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_EQ(decoded[i].method, results[i].method);
+    EXPECT_EQ(decoded[i].status, results[i].status);
+    EXPECT_EQ(decoded[i].error, results[i].error);
+  }
+}
+
+TEST(RemoteInvocationTest, TruncatedBatchThrows) {
+  auto bytes = RemoteInvocation::encodeBatch({{"add", {"1", "2"}}});
+  bytes.resize(bytes.size() - 1);
+  EXPECT_THROW(RemoteInvocation::decodeBatch(bytes), std::runtime_error);
+}
+
+TEST(RemoteInvocationTest, OversizedCountThrowsWithoutAllocating) {
+  // count = 0xFFFFFFFF with no body behind it
+  std::vector<uint8_t> bytes = {0xFF, 0xFF, 0xFF, 0xFF};
+  EXPECT_THROW(RemoteInvocation::decodeBatch(bytes), std::runtime_error);
+  EXPECT_THROW(RemoteInvocation::decodeResults(bytes), std::runtime_error);
+}
+
+TEST(ThreadPoolTest, RunsAllSubmittedTasks) {
+  ThreadPool pool(4);
+  std::atomic<int> counter{0};
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 100; ++i) {
+    results.push_back(pool.submit([&counter, i]() {
+      counter.fetch_add(1);
+      return i * 2;
+    }));
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(results[i].get(), i * 2);
+  }
+  EXPECT_EQ(counter.load(), 100);
+  EXPECT_EQ(pool.size(), 4u);
+}
+
+TEST(ThreadPoolTest, ExceptionPropagatesThroughFuture) {
+  ThreadPool pool(1);
+  auto f = pool.submit([]() -> int { throw std::runtime_error("fail"); });
+  EXPECT_THROW(f.get(), std::runtime_error);
+}
+
+TEST_F(RemoteInvocationE2ETest, BatchAnswersWithoutHoldingUpTheWatcher) {
+  ::SPEED::SPEED callee("RB", ThreadMode::Single, tempDir);
+  callee.setRFIWorkers(2);
+  std::atomic<bool> release{false};
+  std::atomic<int> added{0};
+  callee.registerMethod("slow", [&](const std::vector<std::string> &) {
+    while (!release.load())
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  });
+  callee.registerMethod("add", [&](const std::vector<std::string> &args) {
+    added += std::stoi(args.at(0)) + std::stoi(args.at(1));
+  });
+  callee.registerMethod("boom", [](const std::vector<std::string> &) {
+    throw std::runtime_error("boom failed");
+  });
+  std::atomic<int> delivered{0};
+  callee.setCallback([&](const PMessage &) { ++delivered; });
+
+  ::SPEED::SPEED caller("RA", ThreadMode::Single, tempDir);
+  std::mutex results_mtx;
+  std::vector<InvokeResult> results;
+  std::string answered_by;
+  caller.setInvokeResultCallback(
+      [&](const std::string &from, const std::vector<InvokeResult> &got) {
+        std::lock_guard<std::mutex> lock(results_mtx);
+        answered_by = from;
+        results = got;
+      });
+
+  Running run_callee(callee);
+  Running run_caller(caller);
+  caller.invokeBatch("RB", {{"slow", {}},
+                            {"add", {"1", "2"}},
+                            {"boom", {}},
+                            {"missing", {}}});
+  ASSERT_TRUE(caller.sendMessage("behind the batch", "RB"));
+  // the message is delivered while "slow" still occupies a worker
+  ASSERT_TRUE(waitFor([&]() { return delivered.load() == 1; }));
+  {
+    std::lock_guard<std::mutex> lock(results_mtx);
+    EXPECT_TRUE(results.empty());
+  }
+  release.store(true);
+  ASSERT_TRUE(waitFor([&]() {
+    std::lock_guard<std::mutex> lock(results_mtx);
+    return !results.empty();
+  }));
+
+  std::lock_guard<std::mutex> lock(results_mtx);
+  EXPECT_EQ(answered_by, "RB");
+  EXPECT_EQ(added.load(), 3);
+  ASSERT_EQ(results.size(), 4u);
+  EXPECT_EQ(results[0].method, "slow");
+  EXPECT_EQ(results[0].status, InvokeStatus::OK);
+  EXPECT_EQ(results[1].status, InvokeStatus::OK);
+  EXPECT_EQ(results[2].status, InvokeStatus::FAILED);
+  EXPECT_EQ(results[2].error, "boom failed");
+  EXPECT_EQ(results[3].method, "missing");
+  EXPECT_EQ(results[3].status, InvokeStatus::NOT_FOUND);
+}
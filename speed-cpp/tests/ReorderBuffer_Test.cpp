@@ -0,0 +1,56 @@
+#include "../include/ReorderBuffer.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace SPEED;
+using Result = ReorderBuffer::InsertResult;
+
+// --- Tests ---
+
+TEST(ReorderBufferTest, ReleasesFramesInSeqOrder) {
+  ReorderBuffer buffer;
+  EXPECT_EQ(buffer.insert(2, "c"), Result::Buffered);
+  EXPECT_EQ(buffer.insert(0, "a"), Result::Buffered);
+  EXPECT_EQ(buffer.size(), 2u);
+
+  ASSERT_NE(buffer.front(), nullptr);
+  EXPECT_EQ(*buffer.front(), "a");
+  buffer.pop();
+  // seq 1 is missing, so seq 2 must wait
+  EXPECT_EQ(buffer.front(), nullptr);
+
+  EXPECT_EQ(buffer.insert(1, "b"), Result::Buffered);
+  EXPECT_EQ(*buffer.front(), "b");
+  buffer.pop();
+  EXPECT_EQ(*buffer.front(), "c");
+  buffer.pop();
+  EXPECT_EQ(buffer.next(), 3);
+  EXPECT_EQ(buffer.size(), 0u);
+}
+
+TEST(ReorderBufferTest, WatermarkAndSlotsDeduplicate) {
+  ReorderBuffer buffer;
+  EXPECT_EQ(buffer.insert(0, "a"), Result::Buffered);
+  EXPECT_EQ(buffer.insert(0, "a"), Result::Duplicate);
+  buffer.pop();
+  // a rescan that still sees the consumed file ignores it by seq alone
+  EXPECT_EQ(buffer.insert(0, "a"), Result::Consumed);
+  EXPECT_EQ(buffer.size(), 0u);
+}
+
+TEST(ReorderBufferTest, GrowsWithinTheWindowAndDefersBeyondIt) {
+  ReorderBuffer buffer(64);
+  for (long long seq = 63; seq >= 1; --seq)
+    ASSERT_EQ(buffer.insert(seq, "f" + std::to_string(seq)), Result::Buffered);
+  EXPECT_EQ(buffer.insert(64, "f64"), Result::OutOfWindow);
+
+  ASSERT_EQ(buffer.insert(0, "f0"), Result::Buffered);
+  for (long long seq = 0; seq < 64; ++seq) {
+    ASSERT_NE(buffer.front(), nullptr);
+    EXPECT_EQ(*buffer.front(), "f" + std::to_string(seq));
+    buffer.pop();
+  }
+  // the window moved, so the deferred frame now fits
+  EXPECT_EQ(buffer.insert(64, "f64"), Result::Buffered);
+  EXPECT_EQ(*buffer.front(), "f64");
+}
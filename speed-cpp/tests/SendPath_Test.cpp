@@ -0,0 +1,137 @@
+#include "../include/SPEED.hpp"
+#include "TestSupport.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Replaces the global allocator for the whole test binary; only allocations
+// made on a thread that has switched counting on are tallied.
+namespace {
+thread_local bool counting = false;
+thread_local size_t allocations = 0;
+} // namespace
+
+void *operator new(std::size_t size) {
+  if (counting)
+    ++allocations;
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+// A plain file where the sender's shard should be: every write into that
+// inbox fails, whoever the test runs as.
+void blockShard(const fs::path &speed_dir, const std::string &reciever,
+                const std::string &sender) {
+  std::ofstream(speed_dir / reciever / sender) << "blocked";
+}
+} // namespace
+
+class SendPathTest : public ::testing::Test {
+protected:
+  fs::path speedDir;
+
+  void SetUp() override {
+    speedDir = fs::temp_directory_path() / "speed_send_path_test";
+    fs::remove_all(speedDir);
+  }
+  void TearDown() override { fs::remove_all(speedDir); }
+};
+
+TEST_F(SendPathTest, SteadyStateSendDoesNotAllocate) {
+  SPEED::SPEED sender("SendPathA", SPEED::ThreadMode::Single, speedDir);
+  SPEED::SPEED reciever("SendPathB", SPEED::ThreadMode::Single, speedDir);
+  sender.addProcess("SendPathB");
+  reciever.addProcess("SendPathA");
+  const std::string payload(512, 'x');
+
+  // first sends discover the peer and size the per-thread buffers
+  for (int i = 0; i < 8; ++i)
+    ASSERT_TRUE(sender.sendMessage(payload, "SendPathB"));
+
+  bool all_sent = true;
+  counting = true;
+  for (int i = 0; i < 256; ++i)
+    all_sent &= sender.sendMessage(payload, "SendPathB");
+  counting = false;
+
+  EXPECT_TRUE(all_sent);
+  EXPECT_EQ(allocations, 0u);
+
+  size_t frames = 0;
+  const fs::path shard = speedDir / "SendPathB" / "SendPathA";
+  for (const auto &entry : fs::directory_iterator(shard))
+    frames += entry.path().extension() == ".ospeed";
+  // plus the CON_REQ from addProcess(), never answered without a watcher
+  EXPECT_EQ(frames, 1u + 8u + 256u);
+}
+
+TEST_F(SendPathTest, FailedWriteDoesNotConsumeTheSeq) {
+  SPEED::SPEED sender("FailA", SPEED::ThreadMode::Single, speedDir);
+  SPEED::SPEED b("FailB", SPEED::ThreadMode::Single, speedDir);
+  SPEED::SPEED c("FailC", SPEED::ThreadMode::Single, speedDir);
+  std::mutex mtx;
+  std::vector<std::string> b_got, c_got;
+  b.setCallback([&](const SPEED::PMessage &msg) {
+    std::lock_guard<std::mutex> lock(mtx);
+    b_got.push_back(msg.message);
+  });
+  c.setCallback([&](const SPEED::PMessage &msg) {
+    std::lock_guard<std::mutex> lock(mtx);
+    c_got.push_back(msg.message);
+  });
+
+  blockShard(speedDir, "FailB", "FailA");
+  EXPECT_FALSE(sender.sendMessage("lost", "FailB"));
+  const std::vector<std::string> both = {"FailB", "FailC"};
+  // published to FailC only, so the multicast reports a failure
+  EXPECT_FALSE(sender.sendMessage("shared", both));
+  fs::remove(speedDir / "FailB" / "FailA");
+
+  EXPECT_TRUE(sender.sendMessage("next", "FailB"));
+  EXPECT_TRUE(sender.sendMessage("after", both));
+  Running run_b(b);
+  Running run_c(c);
+  ASSERT_TRUE(waitFor([&]() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return b_got.size() == 2 && c_got.size() == 2;
+  }));
+  std::lock_guard<std::mutex> lock(mtx);
+  EXPECT_EQ(b_got, (std::vector<std::string>{"next", "after"}));
+  EXPECT_EQ(c_got, (std::vector<std::string>{"shared", "after"}));
+}
+
+TEST(UUIDTest, ForkedChildDrawsItsOwnUUIDs) {
+  char uuid[SPEED::Utils::kUUIDChars + 1];
+  SPEED::Utils::formatUUID(uuid); // the generator is seeded before the fork
+
+  int fds[2];
+  ASSERT_EQ(::pipe(fds), 0);
+  const pid_t child = ::fork();
+  if (child == 0) {
+    SPEED::Utils::formatUUID(uuid);
+    const ssize_t written = ::write(fds[1], uuid, sizeof(uuid));
+    ::_exit(written == static_cast<ssize_t>(sizeof(uuid)) ? 0 : 1);
+  }
+  ::close(fds[1]);
+  char from_child[sizeof(uuid)] = {};
+  ASSERT_EQ(::read(fds[0], from_child, sizeof(from_child)),
+            static_cast<ssize_t>(sizeof(from_child)));
+  ::close(fds[0]);
+  ::waitpid(child, nullptr, 0);
+
+  SPEED::Utils::formatUUID(uuid);
+  EXPECT_STRNE(uuid, from_child);
+}
@@ -0,0 +1,144 @@
+#include "../include/SPEED.hpp"
+#include "../include/SeqState.hpp"
+#include "TestSupport.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+class SeqStateTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "speed_seq_state_test";
+    fs::remove_all(tempDir);
+    fs::create_directories(tempDir);
+  }
+  void TearDown() override { fs::remove_all(tempDir); }
+
+  // Runs one instance of "SeqB" until it has delivered `total` messages
+  // overall, then lingers briefly to catch any redelivery.
+  void runReciever(std::atomic<int> &got, int total) {
+    ::SPEED::SPEED reciever("SeqB", ThreadMode::Single, tempDir);
+    reciever.setCallback([&](const PMessage &) { ++got; });
+    std::thread watcher([&]() { reciever.start(); });
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (got.load() < total && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    reciever.stop();
+    watcher.join();
+  }
+};
+
+// --- Tests ---
+
+TEST_F(SeqStateTest, SlotsSurviveRemapping) {
+  uint64_t epoch = 0;
+  {
+    SeqState state(tempDir / ".seqstate");
+    epoch = state.epoch();
+    EXPECT_NE(epoch, 0u);
+    PeerSeqs *bob = state.get("Bob");
+    ASSERT_NE(bob, nullptr);
+    EXPECT_EQ(bob->send[1], 0);
+    bob->send[1] = 5;
+    bob->recv[2] = 7;
+    EXPECT_EQ(state.get("Bob"), bob);
+  }
+  SeqState state(tempDir / ".seqstate");
+  EXPECT_EQ(state.epoch(), epoch);
+  size_t peers = 0;
+  state.forEach([&](std::string_view name, const PeerSeqs &seqs) {
+    ++peers;
+    EXPECT_EQ(name, "Bob");
+    EXPECT_EQ(seqs.send[1], 5);
+    EXPECT_EQ(seqs.recv[2], 7);
+  });
+  EXPECT_EQ(peers, 1u);
+}
+
+TEST_F(SeqStateTest, RestartsResumeWithoutStallsOrRedelivery) {
+  std::atomic<int> got{0};
+  runReciever(got, 0); // frames are only written into an existing inbox
+  auto sender =
+      std::make_unique<::SPEED::SPEED>("SeqA", ThreadMode::Single, tempDir);
+  sender->addProcess("SeqB");
+  for (int i = 0; i < 3; ++i)
+    ASSERT_TRUE(sender->sendMessage("m", "SeqB"));
+  runReciever(got, 3);
+  EXPECT_EQ(got.load(), 3);
+
+  // a restarted reciever resumes at its watermarks
+  ASSERT_TRUE(sender->sendMessage("m", "SeqB"));
+  runReciever(got, 4);
+  EXPECT_EQ(got.load(), 4);
+
+  // a restarted sender resumes its seqs
+  sender.reset();
+  sender =
+      std::make_unique<::SPEED::SPEED>("SeqA", ThreadMode::Single, tempDir);
+  sender->addProcess("SeqB");
+  ASSERT_TRUE(sender->sendMessage("m", "SeqB"));
+  runReciever(got, 5);
+  EXPECT_EQ(got.load(), 5);
+}
+
+TEST_F(SeqStateTest, SharedFramesAdvanceTheSavedWatermark) {
+  std::atomic<int> got{0};
+  runReciever(got, 0);
+  { ::SPEED::SPEED other("SeqC", ThreadMode::Single, tempDir); }
+  ::SPEED::SPEED sender("SeqA", ThreadMode::Single, tempDir);
+  // a multicast frame's header carries no per-reciever seq
+  const std::vector<std::string> both = {"SeqB", "SeqC"};
+  ASSERT_TRUE(sender.sendMessage("m", both));
+  ASSERT_TRUE(sender.sendMessage("m", both));
+  runReciever(got, 2);
+  EXPECT_EQ(got.load(), 2);
+
+  // the restarted reciever resumes after them, not back at seq 0
+  ASSERT_TRUE(sender.sendMessage("m", "SeqB"));
+  runReciever(got, 3);
+  EXPECT_EQ(got.load(), 3);
+  SeqState state(SeqState::pathFor(tempDir, "SeqB"));
+  EXPECT_EQ(state.get("SeqA")->recv[static_cast<size_t>(Priority::Normal)], 3);
+}
+
+TEST_F(SeqStateTest, PeerThatLostItsStateRestartsTheChannel) {
+  ::SPEED::SPEED a("SeqA", ThreadMode::Single, tempDir);
+  std::atomic<int> a_got{0};
+  a.setCallback([&](const PMessage &) { ++a_got; });
+  Running run_a(a);
+  std::atomic<int> b_got{0};
+  {
+    ::SPEED::SPEED b("SeqB", ThreadMode::Single, tempDir);
+    b.setCallback([&](const PMessage &) { ++b_got; });
+    b.addProcess("SeqA");
+    Running run_b(b);
+    ASSERT_TRUE(b.sendMessage("m0", "SeqA"));
+    ASSERT_TRUE(b.sendMessage("m1", "SeqA"));
+    ASSERT_TRUE(waitFor([&]() { return a_got.load() == 2; }));
+    // behind SeqA's CON_RES, so SeqB has pinned SeqA once it has this
+    ASSERT_TRUE(a.sendMessage("r0", "SeqB"));
+    ASSERT_TRUE(waitFor([&]() { return b_got.load() == 1; }));
+  }
+  // SeqA still expects seq 2 from SeqB, which starts again at 0
+  fs::remove(SeqState::pathFor(tempDir, "SeqB"));
+  ::SPEED::SPEED b("SeqB", ThreadMode::Single, tempDir);
+  b.setCallback([&](const PMessage &) { ++b_got; });
+  Running run_b(b);
+  ASSERT_TRUE(b.sendMessage("m2", "SeqA"));
+  EXPECT_TRUE(waitFor([&]() { return a_got.load() == 3; }));
+  // and SeqA's frames to it start again at 0 too
+  ASSERT_TRUE(a.sendMessage("r1", "SeqB"));
+  EXPECT_TRUE(waitFor([&]() { return b_got.load() == 2; }));
+}
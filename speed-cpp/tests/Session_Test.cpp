@@ -0,0 +1,224 @@
+#include "../include/BinaryManager.hpp"
+#include "../include/IdentityStore.hpp"
+#include "../include/SPEED.hpp"
+#include "../include/SeqState.hpp"
+#include "TestSupport.hpp"
+#include <chrono>
+#include <filesystem>
+#include <atomic>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+namespace {
+uint64_t recievedFrom(const ::SPEED::SPEED &ipc, const std::string &peer) {
+  for (const PeerMetrics &metrics : ipc.getMetrics().peers) {
+    if (metrics.peer == peer)
+      return metrics.received;
+  }
+  return 0;
+}
+} // namespace
+
+class SessionTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "speed_session_test";
+    fs::remove_all(tempDir);
+    fs::create_directories(tempDir);
+  }
+  void TearDown() override { fs::remove_all(tempDir); }
+
+  // SB offers SA a session and both ends pin each other's key.
+  void establish() {
+    ::SPEED::SPEED a("SA", ThreadMode::Single, tempDir);
+    ::SPEED::SPEED b("SB", ThreadMode::Single, tempDir);
+    b.addProcess("SA");
+    Running run_a(a);
+    Running run_b(b);
+    ASSERT_TRUE(waitFor([&]() {
+      return recievedFrom(a, "SB") >= 1 && recievedFrom(b, "SA") >= 1;
+    }));
+  }
+
+  EncryptionManager::PublicKey publicKeyOf(const std::string &name) {
+    return IdentityStore(tempDir / "identities" / (name + ".id"))
+        .keyPair()
+        .public_key;
+  }
+};
+
+// --- Tests ---
+
+TEST_F(SessionTest, IdentityIsPrivateAndKeepsItsPins) {
+  const fs::path path = tempDir / "identities" / "ID.id";
+  fs::create_directories(path.parent_path());
+  EncryptionManager::PublicKey key;
+  key.fill(7);
+  EncryptionManager::PublicKey own;
+  {
+    IdentityStore identity(path);
+    own = identity.keyPair().public_key;
+    EXPECT_FALSE(identity.pinned("Peer", key));
+    ASSERT_TRUE(identity.pin("Peer", key));
+    ASSERT_TRUE(identity.pin("Other", key));
+    ASSERT_TRUE(identity.unpin("Other"));
+  }
+  EXPECT_EQ(fs::status(path).permissions() & fs::perms::all,
+            fs::perms::owner_read | fs::perms::owner_write);
+
+  IdentityStore reloaded(path);
+  EXPECT_EQ(reloaded.keyPair().public_key, own);
+  EncryptionManager::PublicKey found{};
+  ASSERT_TRUE(reloaded.pinned("Peer", found));
+  EXPECT_EQ(found, key);
+  EXPECT_FALSE(reloaded.pinned("Other", found));
+}
+
+TEST_F(SessionTest, SessionSurvivesARestartOfBothEnds) {
+  establish();
+  {
+    ::SPEED::SPEED a("SA", ThreadMode::Single, tempDir);
+    ASSERT_TRUE(a.sendMessage("m0", "SB"));
+    ASSERT_TRUE(a.sendMessage("m1", "SB"));
+  }
+  size_t sealed = 0;
+  for (const auto &entry : fs::directory_iterator(tempDir / "SB" / "SA")) {
+    const Message msg = BinaryManager::readBinary(entry.path());
+    if (msg.header.type == MessageType::MSG) {
+      EXPECT_TRUE(msg.header.flags & FLAG_SESSION_KEY);
+      ++sealed;
+    }
+  }
+  ASSERT_EQ(sealed, 2u);
+
+  // the restarted reciever opens its backlog without a new handshake
+  ::SPEED::SPEED b("SB", ThreadMode::Single, tempDir);
+  std::vector<std::string> delivered;
+  b.setCallback([&](const PMessage &msg) { delivered.push_back(msg.message); });
+  {
+    Running run_b(b);
+    waitFor([&]() {
+      return b.getQuarantinedCount() > 0 || delivered.size() == 2;
+    });
+  }
+  EXPECT_EQ(delivered, (std::vector<std::string>{"m0", "m1"}));
+  EXPECT_EQ(b.getQuarantinedCount(), 0u);
+}
+
+TEST_F(SessionTest, HandshakeWithAnotherKeyIsRefused) {
+  establish();
+  // anyone holding the shared key can seal a CON_REQ in SA's name
+  const EncryptionManager::KeyPair forged =
+      EncryptionManager::generateKeyPair();
+  Message req = Message::construct_CON_REQ(
+      "SB",
+      std::vector<uint8_t>(forged.public_key.begin(), forged.public_key.end()),
+      SeqState::newEpoch());
+  long long seq = 0;
+  {
+    SeqState state(SeqState::pathFor(tempDir, "SA"));
+    seq = state.get("SB")->send[static_cast<size_t>(Priority::Control)]++;
+  }
+  req.header.seq_num = seq;
+  req.header.sender = "SA";
+  EncryptionManager::Encrypt(req, EncryptionManager::deriveKey({}));
+  ASSERT_TRUE(BinaryManager::writeBinary(req, tempDir, "SA", seq, "SB"));
+
+  {
+    ::SPEED::SPEED b("SB", ThreadMode::Single, tempDir);
+    Running run_b(b);
+    ASSERT_TRUE(waitFor([&]() { return recievedFrom(b, "SA") >= 1; }));
+    ASSERT_TRUE(b.sendMessage("reply", "SA"));
+  }
+  EncryptionManager::PublicKey pinned{};
+  {
+    IdentityStore identity(tempDir / "identities" / "SB.id");
+    ASSERT_TRUE(identity.pinned("SA", pinned));
+  }
+  EXPECT_EQ(pinned, publicKeyOf("SA"));
+
+  // the reply is still sealed under the genuine session
+  ::SPEED::SPEED a("SA", ThreadMode::Single, tempDir);
+  std::vector<std::string> delivered;
+  a.setCallback([&](const PMessage &msg) { delivered.push_back(msg.message); });
+  {
+    Running run_a(a);
+    waitFor([&]() {
+      return a.getQuarantinedCount() > 0 || !delivered.empty();
+    });
+  }
+  EXPECT_EQ(delivered, (std::vector<std::string>{"reply"}));
+  EXPECT_EQ(a.getQuarantinedCount(), 0u);
+}
+
+TEST_F(SessionTest, ForgottenKeyIsReplacedByARekey) {
+  establish();
+  {
+    ::SPEED::SPEED b("SB", ThreadMode::Single, tempDir);
+    ASSERT_TRUE(b.sendMessage("old", "SA"));
+  }
+  // SB loses its identity and comes back with a new key pair
+  const EncryptionManager::PublicKey old_key = publicKeyOf("SB");
+  fs::remove(tempDir / "identities" / "SB.id");
+
+  ::SPEED::SPEED a("SA", ThreadMode::Single, tempDir);
+  std::vector<std::string> a_got;
+  a.setCallback([&](const PMessage &msg) { a_got.push_back(msg.message); });
+  a.forgetPeerKey("SB");
+  ASSERT_TRUE(a.sendMessage("lost", "SB")); // sealed for the old SB
+
+  ::SPEED::SPEED b("SB", ThreadMode::Single, tempDir);
+  std::vector<std::string> b_got;
+  b.setCallback([&](const PMessage &msg) { b_got.push_back(msg.message); });
+  b.addProcess("SA");
+  {
+    Running run_a(a);
+    Running run_b(b);
+    // "lost" waits for the handshake, and no key opens it after that
+    ASSERT_TRUE(waitFor([&]() { return b.getQuarantinedCount() == 1; }));
+    ASSERT_TRUE(a.sendMessage("m2", "SB"));
+    ASSERT_TRUE(b.sendMessage("new", "SA"));
+    waitFor([&]() { return a_got.size() == 2 && b_got.size() == 1; });
+  }
+  // "old" opens with the previous keys, "new" with the new ones
+  EXPECT_EQ(a_got, (std::vector<std::string>{"old", "new"}));
+  EXPECT_EQ(b_got, (std::vector<std::string>{"m2"}));
+  EXPECT_EQ(a.getQuarantinedCount(), 0u);
+  EXPECT_EQ(b.getQuarantinedCount(), 1u);
+  EXPECT_NE(publicKeyOf("SB"), old_key);
+}
+
+TEST_F(SessionTest, FramesOpenWhileSendsAddPeers) {
+  establish();
+  constexpr size_t kFrames = 200;
+  {
+    ::SPEED::SPEED a("SA", ThreadMode::Single, tempDir);
+    for (size_t i = 0; i < kFrames; ++i)
+      ASSERT_TRUE(a.sendMessage("m" + std::to_string(i), "SB"));
+  }
+
+  ::SPEED::SPEED b("SB", ThreadMode::Single, tempDir);
+  std::atomic<size_t> delivered{0};
+  b.setCallback([&](const PMessage &) { ++delivered; });
+  {
+    Running run_b(b);
+    // every new reciever grows the per-peer tables the watcher reads from
+    std::thread sender([&]() {
+      for (int i = 0; i < 1000; ++i)
+        b.sendMessage("x", "New" + std::to_string(i));
+    });
+    waitFor([&]() {
+      return b.getQuarantinedCount() > 0 || delivered == kFrames;
+    });
+    sender.join();
+  }
+  EXPECT_EQ(delivered, kFrames);
+  EXPECT_EQ(b.getQuarantinedCount(), 0u);
+}
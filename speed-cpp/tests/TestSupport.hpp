@@ -0,0 +1,46 @@
+#pragma once
+#include "../include/SPEED.hpp"
+#include <chrono>
+#include <functional>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+// Helpers shared by the tests that run SPEED instances against each other.
+
+// Runs the watcher of a Single-mode instance until the end of the scope.
+class Running {
+public:
+  explicit Running(::SPEED::SPEED &ipc)
+      : ipc_(ipc), watcher_([this]() { ipc_.start(); }) {}
+  ~Running() {
+    ipc_.stop();
+    watcher_.join();
+  }
+
+private:
+  ::SPEED::SPEED &ipc_;
+  std::thread watcher_;
+};
+
+// Polls `done` until it holds or `limit` has passed.
+inline bool waitFor(const std::function<bool()> &done,
+                    std::chrono::seconds limit = std::chrono::seconds(10)) {
+  const auto deadline = std::chrono::steady_clock::now() + limit;
+  while (!done()) {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  return true;
+}
+
+// The pid of a process that has already exited and been reaped.
+inline pid_t deadPid() {
+  const pid_t child = ::fork();
+  if (child == 0)
+    ::_exit(0);
+  ::waitpid(child, nullptr, 0);
+  return child;
+}
@@ -0,0 +1,127 @@
+#include "../include/SPEED.hpp"
+#include "../include/TopicRegistry.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <gtest/gtest.h>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+class TopicRegistryTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "topic_registry_test_dir";
+    if (fs::exists(tempDir))
+      fs::remove_all(tempDir);
+    fs::create_directory(tempDir);
+  }
+
+  void TearDown() override {
+    if (fs::exists(tempDir))
+      fs::remove_all(tempDir);
+  }
+};
+
+// --- Tests ---
+
+TEST_F(TopicRegistryTest, SubscribeCreatesMarkerFile) {
+  TopicRegistry reg(tempDir, "Alpha");
+  EXPECT_TRUE(reg.subscribe("prices"));
+  EXPECT_TRUE(fs::exists(tempDir / "prices" / "Alpha.osub"));
+  EXPECT_FALSE(fs::exists(tempDir / "prices" / "Alpha.isub"));
+  EXPECT_EQ(reg.getSubscriptions().count("prices"), 1u);
+}
+
+TEST_F(TopicRegistryTest, InvalidTopicNamesRejected) {
+  TopicRegistry reg(tempDir, "Alpha");
+  EXPECT_FALSE(reg.subscribe(""));
+  EXPECT_FALSE(reg.subscribe("../escape"));
+  EXPECT_FALSE(reg.subscribe("a/b"));
+  EXPECT_TRUE(TopicRegistry::validateTopicName("market_data_1"));
+}
+
+TEST_F(TopicRegistryTest, PublisherSeesOtherSubscribersButNotSelf) {
+  TopicRegistry alpha(tempDir, "Alpha");
+  TopicRegistry beta(tempDir, "Beta");
+  TopicRegistry gamma(tempDir, "Gamma");
+  alpha.subscribe("news");
+  beta.subscribe("news");
+  gamma.subscribe("news");
+
+  auto subs = alpha.getSubscribers("news");
+  std::sort(subs.begin(), subs.end());
+  EXPECT_EQ(subs, (std::vector<std::string>{"Beta", "Gamma"}));
+}
+
+TEST_F(TopicRegistryTest, RefreshAppliesAddsAndRemoves) {
+  TopicRegistry pub(tempDir, "Pub");
+  TopicRegistry beta(tempDir, "Beta");
+  beta.subscribe("news");
+  EXPECT_EQ(pub.getSubscribers("news").size(), 1u);
+
+  TopicRegistry gamma(tempDir, "Gamma");
+  gamma.subscribe("news");
+  beta.unsubscribe("news");
+
+  // cached until refreshed
+  EXPECT_EQ(pub.getSubscribers("news"), (std::vector<std::string>{"Beta"}));
+  pub.refresh();
+  EXPECT_EQ(pub.getSubscribers("news"), (std::vector<std::string>{"Gamma"}));
+}
+
+TEST_F(TopicRegistryTest, RefreshOfOneTopicLeavesTheOthersCached) {
+  TopicRegistry pub(tempDir, "Pub");
+  TopicRegistry beta(tempDir, "Beta");
+  beta.subscribe("news");
+  beta.subscribe("sports");
+  EXPECT_EQ(pub.getSubscribers("news").size(), 1u);
+  EXPECT_EQ(pub.getSubscribers("sports").size(), 1u);
+
+  beta.unsubscribe("news");
+  beta.unsubscribe("sports");
+  pub.refresh("news");
+  EXPECT_TRUE(pub.getSubscribers("news").empty());
+  EXPECT_EQ(pub.getSubscribers("sports"),
+            (std::vector<std::string>{"Beta"}));
+}
+
+TEST_F(TopicRegistryTest, UnknownTopicHasNoSubscribers) {
+  TopicRegistry reg(tempDir, "Alpha");
+  EXPECT_TRUE(reg.getSubscribers("nobody_here").empty());
+  EXPECT_FALSE(reg.unsubscribe("nobody_here"));
+}
+
+TEST_F(TopicRegistryTest, RemoveAllSubscriptionsDeletesMarkers) {
+  TopicRegistry reg(tempDir, "Alpha");
+  reg.subscribe("a");
+  reg.subscribe("b");
+  reg.removeAllSubscriptions();
+  EXPECT_FALSE(fs::exists(tempDir / "a" / "Alpha.osub"));
+  EXPECT_FALSE(fs::exists(tempDir / "b" / "Alpha.osub"));
+  EXPECT_TRUE(reg.getSubscriptions().empty());
+}
+
+// A process that only publishes never runs the watcher, so the publish
+// itself has to notice new subscribers.
+TEST_F(TopicRegistryTest, PublishWithoutStartReachesNewSubscribers) {
+  ::SPEED::SPEED beta("Beta", ThreadMode::Single, tempDir);
+  beta.subscribe("news");
+  ::SPEED::SPEED pub("Pub", ThreadMode::Single, tempDir);
+  ASSERT_TRUE(pub.publish("news", "first"));
+
+  ::SPEED::SPEED gamma("Gamma", ThreadMode::Single, tempDir);
+  gamma.subscribe("news");
+  ASSERT_TRUE(pub.publish("news", "second"));
+  auto frames = [&](const std::string &subscriber) {
+    std::error_code ec;
+    size_t count = 0;
+    for (const auto &entry :
+         fs::directory_iterator(tempDir / subscriber / "Pub", ec))
+      count += entry.path().extension() == ".ospeed";
+    return count;
+  };
+  EXPECT_EQ(frames("Beta"), 2u);
+  EXPECT_EQ(frames("Gamma"), 1u);
+}
@@ -0,0 +1,171 @@
+#include "../include/SPEED.hpp"
+#include "../include/Tracer.hpp"
+#include "TestSupport.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+namespace {
+std::string readFile(const fs::path &path) {
+  std::ifstream in(path);
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  return buffer.str();
+}
+} // namespace
+
+// --- Tests ---
+
+TEST(TracerTest, SamplesBySeqAndKeepsTheNewestEvents) {
+  Tracer tracer;
+  EXPECT_FALSE(tracer.sampled(0)); // off by default
+  tracer.enable(4, 3);
+  EXPECT_TRUE(tracer.sampled(0));
+  EXPECT_FALSE(tracer.sampled(3));
+  EXPECT_TRUE(tracer.sampled(8));
+
+  for (long long seq = 0; seq < 5; ++seq)
+    tracer.record(TraceStage::Write, 0, 2, seq, 100 + seq, 200 + seq);
+  const std::vector<TraceEvent> events = tracer.events();
+  ASSERT_EQ(events.size(), 3u);
+  EXPECT_EQ(events[0].seq, 2);
+  EXPECT_EQ(events[2].seq, 4);
+  EXPECT_EQ(events[2].start_ns, 104u);
+
+  tracer.enable(0);
+  EXPECT_FALSE(tracer.enabled());
+  EXPECT_TRUE(tracer.events().empty());
+}
+
+TEST(TracerTest, ExportsChromeTraceJson) {
+  PeerTable names;
+  const PeerId bob = names.intern("Bob");
+  Tracer tracer;
+  tracer.enable(1);
+  tracer.record(TraceStage::Send, bob, 2, 7, 1500, 4750);
+  const std::string json = tracer.toJson(names, "Alice");
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0u);
+  EXPECT_NE(json.find("\"args\":{\"name\":\"Alice\"}"), std::string::npos);
+  EXPECT_NE(json.find("{\"name\":\"send\",\"cat\":\"speed\",\"ph\":\"X\","
+                      "\"ts\":1.500,\"dur\":3.250,"),
+            std::string::npos);
+  EXPECT_NE(json.find("\"args\":{\"to\":\"Bob\",\"lane\":2,\"seq\":7}"),
+            std::string::npos);
+  EXPECT_NE(json.find("\"ph\":\"s\""), std::string::npos);
+}
+
+TEST(TracerTest, TracesBothSidesOfSampledMessages) {
+  const fs::path dir = fs::temp_directory_path() / "speed_tracer_test";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  ::SPEED::SPEED reciever("TB", ThreadMode::Single, dir);
+  reciever.setTracing(2);
+  reciever.subscribe("news");
+  int delivered = 0;
+  reciever.setCallback([&](const PMessage &) { ++delivered; });
+  {
+    ::SPEED::SPEED sender("TA", ThreadMode::Single, dir);
+    sender.setTracing(2);
+    for (int i = 0; i < 4; ++i)
+      ASSERT_TRUE(sender.sendMessage("m" + std::to_string(i), "TB"));
+    // shared frames, whose header carries no per-reciever seq: 4 and 5
+    for (int i = 0; i < 2; ++i)
+      ASSERT_TRUE(sender.publish("news", "p" + std::to_string(i)));
+    ASSERT_TRUE(sender.exportTrace(dir / "TA.json"));
+  }
+
+  std::thread watcher([&]() { reciever.start(); });
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (delivered < 6 && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  reciever.stop();
+  watcher.join();
+  ASSERT_EQ(delivered, 6);
+  ASSERT_TRUE(reciever.exportTrace(dir / "TB.json"));
+
+  // seqs 0, 2 and 4 of the Normal lane, on both sides; the published frame
+  // is linked into place rather than renamed
+  auto stages = [](const std::string &json) {
+    std::multiset<std::string> found;
+    for (const char *stage : {"send", "encrypt", "write", "rename", "queued",
+                              "read", "decrypt", "callback"}) {
+      const std::string key = "{\"name\":\"" + std::string(stage) + "\"";
+      for (size_t at = json.find(key); at != std::string::npos;
+           at = json.find(key, at + 1))
+        found.insert(stage);
+    }
+    return found;
+  };
+  const std::string sent_json = readFile(dir / "TA.json");
+  EXPECT_EQ(stages(sent_json),
+            (std::multiset<std::string>{"send", "send", "send", "encrypt",
+                                        "encrypt", "encrypt", "write", "write",
+                                        "write", "rename", "rename"}));
+  const std::string recieved_json = readFile(dir / "TB.json");
+  EXPECT_EQ(stages(recieved_json),
+            (std::multiset<std::string>{"queued", "queued", "queued", "read",
+                                        "read", "read", "decrypt", "decrypt",
+                                        "decrypt", "callback", "callback",
+                                        "callback"}));
+  const std::string published = "\"lane\":2,\"seq\":4}";
+  EXPECT_NE(sent_json.find(published), std::string::npos);
+  EXPECT_NE(recieved_json.find(published), std::string::npos);
+
+  ASSERT_TRUE(Tracer::merge({dir / "TA.json", dir / "TB.json"},
+                            dir / "merged.json"));
+  const std::string merged = readFile(dir / "merged.json");
+  EXPECT_EQ(stages(merged).size(), 23u);
+  EXPECT_NE(merged.find("{\"name\":\"TA\"}"), std::string::npos);
+  EXPECT_NE(merged.find("{\"name\":\"TB\"}"), std::string::npos);
+  // each sampled message has a flow arrow with one id on both sides
+  auto flowIds = [&](const char *phase) {
+    std::multiset<std::string> ids;
+    const std::string key = std::string("\"ph\":\"") + phase + "\",\"id\":";
+    for (size_t at = merged.find(key); at != std::string::npos;
+         at = merged.find(key, at + 1)) {
+      const size_t begin = at + key.size();
+      ids.insert(merged.substr(begin, merged.find(',', begin) - begin));
+    }
+    return ids;
+  };
+  EXPECT_EQ(flowIds("s").size(), 3u);
+  EXPECT_EQ(flowIds("s"), flowIds("f"));
+  fs::remove_all(dir);
+}
+
+TEST(TracerTest, TracingCanBeSetFromACallback) {
+  const fs::path dir = fs::temp_directory_path() / "speed_tracer_cb_test";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  ::SPEED::SPEED reciever("TD", ThreadMode::Single, dir);
+  std::atomic<int> delivered{0};
+  // callbacks run on the watcher, in the middle of draining a lane
+  reciever.setCallback([&](const PMessage &) {
+    reciever.setTracing(1);
+    ++delivered;
+  });
+  {
+    ::SPEED::SPEED sender("TC", ThreadMode::Single, dir);
+    for (int i = 0; i < 3; ++i)
+      ASSERT_TRUE(sender.sendMessage("m" + std::to_string(i), "TD"));
+  }
+  {
+    Running run(reciever);
+    EXPECT_TRUE(waitFor([&]() { return delivered.load() == 3; }));
+  }
+  ASSERT_TRUE(reciever.exportTrace(dir / "TD.json"));
+  EXPECT_NE(readFile(dir / "TD.json").find("{\"name\":\"callback\""),
+            std::string::npos);
+  fs::remove_all(dir);
+}
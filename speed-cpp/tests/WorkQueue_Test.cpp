@@ -0,0 +1,178 @@
+#include "../include/SPEED.hpp"
+#include "../include/WorkQueue.hpp"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <set>
+#include <thread>
+
+using namespace SPEED;
+namespace fs = std::filesystem;
+
+class WorkQueueTest : public ::testing::Test {
+protected:
+  fs::path tempDir;
+
+  void SetUp() override {
+    tempDir = fs::temp_directory_path() / "work_queue_test_dir";
+    if (fs::exists(tempDir))
+      fs::remove_all(tempDir);
+    fs::create_directory(tempDir);
+  }
+
+  void TearDown() override {
+    if (fs::exists(tempDir))
+      fs::remove_all(tempDir);
+  }
+
+  Message makeJob() {
+    Message msg;
+    msg.header.version = 1;
+    msg.header.type = MessageType::JOB;
+    msg.header.sender_pid = 1234;
+    msg.header.timestamp = 5678;
+    msg.header.seq_num = 0;
+    msg.header.sender = "Producer";
+    msg.header.reciever = "";
+    std::fill(msg.header.nonce.begin(), msg.header.nonce.end(), 0xAA);
+    msg.payload = {'j', 'o', 'b'};
+    return msg;
+  }
+
+  size_t pendingJobs(const std::string &queue) {
+    size_t n = 0;
+    for (auto &entry : fs::directory_iterator(tempDir / "queues" / queue))
+      if (entry.path().extension() == ".ojob")
+        ++n;
+    return n;
+  }
+};
+
+// --- Tests ---
+
+TEST_F(WorkQueueTest, SubmitThenClaimMovesJobIntoWorkerDir) {
+  WorkQueue producer(tempDir, "Producer");
+  WorkQueue worker(tempDir, "Worker");
+  ASSERT_TRUE(producer.submit(makeJob(), "jobs"));
+  EXPECT_EQ(pendingJobs("jobs"), 1u);
+
+  auto claimed = worker.claim("jobs", 8);
+  ASSERT_EQ(claimed.size(), 1u);
+  EXPECT_EQ(claimed[0].parent_path(), tempDir / "Worker" / "claimed" / "jobs");
+  EXPECT_EQ(pendingJobs("jobs"), 0u);
+  EXPECT_EQ(BinaryManager::readBinary(claimed[0]).payload, makeJob().payload);
+
+  worker.complete(claimed[0]);
+  EXPECT_FALSE(fs::exists(claimed[0]));
+}
+
+TEST_F(WorkQueueTest, InvalidQueueNameRejected) {
+  WorkQueue producer(tempDir, "Producer");
+  EXPECT_FALSE(producer.submit(makeJob(), "../oops"));
+}
+
+TEST_F(WorkQueueTest, ConcurrentWorkersClaimEachJobExactlyOnce) {
+  const int JOBS = 200;
+  WorkQueue producer(tempDir, "Producer");
+  for (int i = 0; i < JOBS; ++i)
+    ASSERT_TRUE(producer.submit(makeJob(), "jobs"));
+
+  const int WORKERS = 4;
+  std::vector<std::vector<fs::path>> claimed(WORKERS);
+  std::vector<std::thread> threads;
+  for (int w = 0; w < WORKERS; ++w) {
+    threads.emplace_back([&, w]() {
+      WorkQueue worker(tempDir, "Worker" + std::to_string(w));
+      while (true) {
+        auto batch = worker.claim("jobs", 16);
+        if (batch.empty())
+          break;
+        claimed[w].insert(claimed[w].end(), batch.begin(), batch.end());
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+
+  std::set<std::string> names;
+  size_t total = 0;
+  for (auto &list : claimed) {
+    total += list.size();
+    for (auto &p : list)
+      names.insert(p.filename().string());
+  }
+  EXPECT_EQ(total, static_cast<size_t>(JOBS));
+  EXPECT_EQ(names.size(), static_cast<size_t>(JOBS));
+}
+
+TEST_F(WorkQueueTest, ClaimsOfDeadWorkerAreRequeued) {
+  WorkQueue producer(tempDir, "Producer");
+  producer.submit(makeJob(), "jobs");
+  producer.submit(makeJob(), "jobs");
+  {
+    WorkQueue doomed(tempDir, "Doomed");
+    EXPECT_EQ(doomed.claim("jobs", 8).size(), 2u);
+  }
+  // pretend the owner crashed: point its .owner at a pid that cannot exist
+  std::ofstream(tempDir / "Doomed" / "claimed" / ".owner")
+      << 0 << "\n" << Utils::pidSpace() << "\n";
+
+  WorkQueue survivor(tempDir, "Survivor");
+  EXPECT_EQ(survivor.reclaimDeadClaims(), 2u);
+  EXPECT_EQ(pendingJobs("jobs"), 2u);
+}
+
+TEST_F(WorkQueueTest, ClaimsOfAWorkerElsewhereAreLeftAlone) {
+  WorkQueue producer(tempDir, "Producer");
+  producer.submit(makeJob(), "jobs");
+  {
+    WorkQueue remote(tempDir, "Remote");
+    EXPECT_EQ(remote.claim("jobs", 8).size(), 1u);
+  }
+  // a pid of another host or pid namespace cannot be probed from here
+  std::ofstream(tempDir / "Remote" / "claimed" / ".owner")
+      << 0 << "\n" << "elsewhere\n";
+
+  WorkQueue local(tempDir, "Local");
+  EXPECT_EQ(local.reclaimDeadClaims(), 0u);
+  EXPECT_EQ(pendingJobs("jobs"), 0u);
+}
+
+TEST_F(WorkQueueTest, LiveWorkerClaimsAreLeftAlone) {
+  WorkQueue producer(tempDir, "Producer");
+  producer.submit(makeJob(), "jobs");
+  WorkQueue busy(tempDir, "Busy"); // .owner holds this (live) pid
+  EXPECT_EQ(busy.claim("jobs", 8).size(), 1u);
+
+  WorkQueue other(tempDir, "Other");
+  EXPECT_EQ(other.reclaimDeadClaims(), 0u);
+  EXPECT_EQ(pendingJobs("jobs"), 0u);
+}
+
+TEST_F(WorkQueueTest, RestartRequeuesOwnLeftoverClaims) {
+  WorkQueue producer(tempDir, "Producer");
+  producer.submit(makeJob(), "jobs");
+  {
+    WorkQueue first(tempDir, "Worker");
+    EXPECT_EQ(first.claim("jobs", 8).size(), 1u);
+  }
+  WorkQueue restarted(tempDir, "Worker");
+  EXPECT_EQ(restarted.requeueOwnClaims(), 1u);
+  EXPECT_EQ(pendingJobs("jobs"), 1u);
+}
+
+TEST_F(WorkQueueTest, ProcessCannotTakeASharedDirectoryAsItsInbox) {
+  for (const std::string name :
+       {"queues", "quarantine", "metrics", "identities", "access_registry",
+        "claimed", "seqstate", "a/b", "..", "", "has space"}) {
+    EXPECT_THROW(::SPEED::SPEED(name, ThreadMode::Single, tempDir),
+                 std::runtime_error)
+        << name;
+  }
+  EXPECT_FALSE(fs::exists(SeqState::pathFor(tempDir, "queues")));
+
+  ::SPEED::SPEED ipc("Worker_1", ThreadMode::Single, tempDir);
+  EXPECT_FALSE(ipc.addProcess("queues"));
+  EXPECT_FALSE(ipc.addProcess("../Worker_1"));
+  EXPECT_TRUE(ipc.addProcess("Worker_2"));
+}